@@ -83,6 +83,12 @@ namespace nsl {
 	typedef unsigned char byte;
 
 
+	/// Object ids (see ServerObject::getId and ClientObject::getId) consist of slot index in the lower 20 bits
+	/// and slot generation in the upper 12 bits (NSL_SLOT_MAP_INDEX_BITS in configuration.h).
+	/// Generation changes whenever the slot of a destroyed object is reused, so ids are unique among living objects only.
+	/// The same id comes back after 4096 reuses of one slot, ids of destroyed objects must not be kept longer than that.
+
+
 	/// Custom message limitations
 	#define NSL_MAX_CUSTOM_MESSAGE_SIZE 256
 	typedef unsigned char customMessageSizeNumber;	// must be able to contain NSL_MAX_CUSTOM_MESSAGE_SIZE
@@ -106,6 +112,34 @@ namespace nsl {
 	#define NSL_EXCEPTION_USAGE_ERROR 3
 
 
+	/// Counters of updates split into more UDP packets because of MTU (see Server::setMtu)
+	struct FragmentationStats
+	{
+		unsigned int packetCount;				// all updates sent (server) or received (client)
+		unsigned int fragmentedPacketCount;		// updates sent or received in fragments
+		unsigned int fragmentCount;				// fragments sent or received
+		unsigned int droppedPacketCount;		// fragmented updates never completed on client (always 0 on server)
+		FragmentationStats(void) : packetCount(0), fragmentedPacketCount(0), fragmentCount(0), droppedPacketCount(0) {}
+	};
+
+
+	/// Interface of a job system, which the library uses to run independent pieces of work in parallel.
+	/// Implement it to hand library work over to your own job system or thread pool.
+	class Executor
+	{
+	public:
+		/// Job function type, receives the context passed to execute(...) and index of the job
+		typedef void (*jobFunction)(void* context, unsigned int jobIndex);
+
+		virtual ~Executor(void) {}
+
+		/// Call job(context, i) for every i from 0 to jobCount-1 and return after all of the calls have finished.
+		/// Calls can run in any order and on any threads, including the calling one.
+		/// Library jobs never throw exceptions.
+		virtual void execute(jobFunction job, void* context, unsigned int jobCount) = 0;
+	};
+
+
 	/// get endianity, for which the librray was compiled
 	/// return true for little endian, false for big endian
 	NSL_IMPORT_EXPORT
@@ -42,6 +42,7 @@ namespace nsl {
 	{
 	public:
 		/// Get object instance unique (across network) identificator.
+		/// Id of a destroyed object is reused later (see object ids in nsl.h).
 		NSL_IMPORT_EXPORT
 		unsigned int getId(void);
 
@@ -108,6 +109,13 @@ namespace nsl {
 		NSL_IMPORT_EXPORT
 		void close(void);
 
+		/// Resume the session, after updateNetwork() threw NSL_EXCEPTION_DISCONNECTED.
+		/// Received objects are kept, so the server sends only what changed since their last acknowledged state.
+		/// The server keeps the session for a few seconds (NSL_TIMEOUT_SERVER_RESUME) after it lost the client.
+		/// If the session cannot be resumed, an exception is thrown or updateNetwork() throws NSL_EXCEPTION_DISCONNECTED again.
+		NSL_IMPORT_EXPORT
+		void reconnect(void);
+
 		/// Process any data, which were received from network.
 		/// Return current connection state
 		/// Library manages time on its own, hovewer, it is possible to specify the time by application (only positive numbers are accepted).
@@ -144,6 +152,11 @@ namespace nsl {
 		NSL_IMPORT_EXPORT
 		BitStreamWriter* createCustomMessage(bool reliable = true);
 
+		/// Get counters of received updates and fragments since the client was created.
+		/// Fragmented updates with lost fragments are counted as dropped.
+		NSL_IMPORT_EXPORT
+		FragmentationStats getFragmentationStats(void);
+
 	private:
 		client::ClientImpl *i;
 	};
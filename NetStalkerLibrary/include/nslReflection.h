@@ -92,6 +92,14 @@ namespace nsl {
 	};
 
 
+	/// Data structure containing definition of attribute update group
+	struct AttributeGroupDefinition
+	{
+		unsigned int period;
+		double priority;
+	};
+
+
 	/// Class representing type of network object.
 	/// Every class must have at least one attribute.
 	class ObjectClass
@@ -100,13 +108,47 @@ namespace nsl {
 		std::vector<AttributeDefinition> attributes;
 		unsigned int attributeMaxId;
 		unsigned short id;
+		bool columnar;
+		unsigned int positionAttributes[3];
+		unsigned int positionDimensions;
+		std::vector<AttributeGroupDefinition> groups;
+		std::vector<std::pair<unsigned int, unsigned int> > attributeGroups;	// pairs of attrId and groupId
 
 		friend class ObjectClassDefinition;
 	public:
 		/// Create new object class with unique id.
 		NSL_IMPORT_EXPORT 
 		ObjectClass(unsigned short classId) 
-			: id(classId), attributeMaxId(0) {}
+			: id(classId), attributeMaxId(0), columnar(false), positionDimensions(0) {}
+
+		/// Store server history of this class by attributes (every attribute of all objects is contiguous) instead of by objects.
+		/// Pays off for classes with many objects, whose diffs are then computed for the whole class at once.
+		void setColumnar(bool columnar) {this->columnar = columnar;}
+
+		/// Mark attributes holding object position (float32 or double64 each), which lets the library compute scope of peers with a view (see Peer::setView).
+		/// Objects of classes with 2D position lie in the plane z = 0. Objects of classes without position are in scope of every peer with a view.
+		void setPositionAttributes(unsigned int xAttrId, unsigned int yAttrId) 
+			{positionAttributes[0] = xAttrId; positionAttributes[1] = yAttrId; positionDimensions = 2;}
+		void setPositionAttributes(unsigned int xAttrId, unsigned int yAttrId, unsigned int zAttrId) 
+			{positionAttributes[0] = xAttrId; positionAttributes[1] = yAttrId; positionAttributes[2] = zAttrId; positionDimensions = 3;}
+
+		/// Define update group of attributes. Changes of its attributes are sent at most once per period ticks, 
+		/// changes in between are merged (objects are spread over the ticks of the period by their ids).
+		/// Priority weights objects with changes in the group when peer updates do not fit into byte budget (see Peer::setByteBudget).
+		/// Unchanged attributes are never sent, regardless of their group.
+		/// All attributes are in group 0, which is sent every tick with priority 1 unless it is redefined.
+		void defineAttributeGroup(unsigned int groupId, unsigned int period, double priority = 1) {
+			AttributeGroupDefinition defaults = {1, 1};
+			if (groupId >= groups.size()) {
+				groups.resize(groupId + 1, defaults);
+			}
+			groups[groupId].period = period;
+			groups[groupId].priority = priority;
+		}
+
+		/// Move attribute into update group defined by defineAttributeGroup
+		void setAttributeGroup(unsigned int attrId, unsigned int groupId) 
+			{attributeGroups.push_back(std::pair<unsigned int, unsigned int>(attrId, groupId));}
 
 		/// Define attribute with default interpolation
 		template <class T>
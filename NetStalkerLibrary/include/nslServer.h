@@ -24,6 +24,9 @@ namespace nsl {
 		class Peer;
 	}
 
+	/// Identifies flush started by Server::flushNetworkAsync()
+	typedef unsigned int FlushHandle;
+
 	/// class representing connected client
 	class Peer
 	{
@@ -35,6 +38,32 @@ namespace nsl {
 
 		NSL_IMPORT_EXPORT
 		const char* getIp(void);
+
+		/// Let the library compute scope of this peer whenever Server::getScope returns false.
+		/// Peer will receive objects closer than radius to given position (see ObjectClass::setPositionAttributes)
+		/// and all objects of classes without position.
+		NSL_IMPORT_EXPORT
+		void setView(double x, double y, double z, double radius);
+
+		/// Stop computing scope from view, peer will receive all objects again (unless Server::getScope says otherwise).
+		NSL_IMPORT_EXPORT
+		void clearView(void);
+
+		/// Limit size of every update sent to this peer (in bytes, before compression), 0 means unlimited.
+		/// Objects which do not fit are sent in later updates, ordered by their priority multiplied by time since they were sent.
+		/// Part of the budget is reserved for custom messages, which are always sent.
+		NSL_IMPORT_EXPORT
+		void setByteBudget(unsigned int bytes);
+
+		/// Send update to this peer only in every n-th Server::flushNetwork(), 1 (default) means every flush.
+		/// 0 lets the library adapt the interval to the link: it grows when updates are not acknowledged in time and shrinks back when they are.
+		/// Updates of throttled peers contain all changes since the data the peer acknowledged.
+		NSL_IMPORT_EXPORT
+		void setSendInterval(unsigned int flushes);
+
+		/// Number of flushes between updates currently used for this peer.
+		NSL_IMPORT_EXPORT
+		unsigned int getSendInterval(void);
 	private:
 		friend class server::Peer;
 		friend class server::ServerImpl;
@@ -51,6 +80,7 @@ namespace nsl {
 	public:
 
 		/// Get object instance unique (across network) identificator.
+		/// Id of a destroyed object is reused later (see object ids in nsl.h).
 		NSL_IMPORT_EXPORT
 		unsigned int getId(void);
 
@@ -64,6 +94,11 @@ namespace nsl {
 		template<class T>
 		void set(unsigned int attrId, typename T::Type value) {set(attrId, T::getByteSize(), (byte*)&value);}
 
+		/// Set weight of this object when peer updates do not fit into byte budget (see Peer::setByteBudget).
+		/// Default is 1, objects with higher weight are sent more often.
+		NSL_IMPORT_EXPORT
+		void setPriority(double weight);
+
 		/// Delete this object from network space.
 		NSL_IMPORT_EXPORT
 		void destroy(void);
@@ -147,6 +182,24 @@ namespace nsl {
 		NSL_IMPORT_EXPORT
 		virtual bool getScope(Peer* peer);
 				
+		/// Set edge length of spatial grid cells used for scope of peers with a view (see Peer::setView).
+		/// Cells of about view radius size work best. Default is NSL_SCOPE_GRID_CELL_SIZE.
+		NSL_IMPORT_EXPORT
+		void setScopeCellSize(double cellSize);
+
+		/// Update changed objects in peer scopes as often as their relevance for the peer says (disabled by default).
+		/// Relevance 1 means every update of the peer, 1/2 every 2nd, 1/4 every 4th and so on up to NSL_MAX_UPDATE_PERIOD.
+		/// Peers with long send interval get objects sooner, if their data would not last in history until the next update.
+		/// Clients keep data of objects between their updates and interpolate over the gaps.
+		NSL_IMPORT_EXPORT
+		void setUpdateRelevance(bool enabled);
+
+		/// Callback for relevance of object in peer's scope, called in every flush when setUpdateRelevance is enabled
+		/// Default - 1 for peers without view and objects without position, otherwise it falls with distance from the view
+		/// (1 up to NSL_RELEVANCE_FULL_RATE_DISTANCE of view radius, 1/4 at the edge of the view)
+		NSL_IMPORT_EXPORT
+		virtual double getRelevance(Peer* peer, ServerObject* object);
+
 		/// Add object to peer's scope.
 		/// Callable only in body of getScope(...), otherwise exception is thrown.
 		NSL_IMPORT_EXPORT
@@ -156,6 +209,56 @@ namespace nsl {
 		NSL_IMPORT_EXPORT
 		void flushNetwork(void);
 
+		/// Prepare object updates like flushNetwork() and return before they are encoded and sent.
+		/// Scope callbacks are called before this returns, the rest is done by a library owned network thread
+		/// (see setNetworkThread), so it overlaps with simulation of the next tick.
+		/// Objects and peers may be changed meanwhile, the updates are encoded from their state at the time of this call.
+		/// The next flush waits until this one is finished. Errors are thrown by waitForFlush() or by the next flush.
+		NSL_IMPORT_EXPORT
+		FlushHandle flushNetworkAsync(void);
+
+		/// Has the flush sent all its updates?
+		NSL_IMPORT_EXPORT
+		bool isFlushFinished(FlushHandle flush);
+
+		/// Block until the flush sent all its updates.
+		NSL_IMPORT_EXPORT
+		void waitForFlush(FlushHandle flush);
+
+		/// Encode and send peer updates in flushNetwork() in parallel, using given executor.
+		/// Scope callbacks are still called from the thread calling flushNetwork().
+		/// Executor is not owned by the server and must live until it is replaced. NULL means serial flush (default).
+		NSL_IMPORT_EXPORT
+		void setFlushExecutor(Executor* executor);
+
+		/// Encode and send peer updates in flushNetwork() in parallel, using library owned threads.
+		/// Thread calling flushNetwork() counts as one of them, 0 or 1 means serial flush (default).
+		NSL_IMPORT_EXPORT
+		void setFlushThreadCount(unsigned int threadCount);
+
+		/// Encode, compress and send peer updates on a library owned network thread (disabled by default).
+		/// flushNetwork() then only prepares scopes and returns, the updates are sent while the game simulates the next tick.
+		/// Callbacks are still called from the game thread. Errors of the network thread are thrown by the next call of flushNetwork().
+		NSL_IMPORT_EXPORT
+		void setNetworkThread(bool enabled);
+
+		/// Let objects be mutated from more threads at once (disabled by default).
+		/// Between updateNetwork() and flushNetwork(), ServerObject::set() and ServerObject::destroy() are safe from any thread
+		/// as long as every object is used by one thread at a time, and createObject() is safe from any thread.
+		/// Destructions are queued without locks and merged by flushNetwork(), objects sharing a history page wait for each other in set().
+		/// No object may be mutated during updateNetwork() and flushNetwork().
+		NSL_IMPORT_EXPORT
+		void setConcurrentMutation(bool enabled);
+
+		/// Set maximal size of UDP payload sent to clients (default NSL_DEFAULT_MTU, between NSL_MIN_MTU and NSL_MAX_MTU).
+		/// Bigger updates are split into fragments, update is lost if any of its fragments is lost.
+		NSL_IMPORT_EXPORT
+		void setMtu(unsigned int mtu);
+
+		/// Get counters of sent updates and fragments since the server was created.
+		NSL_IMPORT_EXPORT
+		FragmentationStats getFragmentationStats(void);
+
 		/// Process updates from clients
 		/// Library manages time on its own, hovewer, it is possible to specify the time by application (only positive numbers are accepted).
 		/// Library works with seconds (in double format), if you pass time manually in server and client both, you can choose another precission.
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+#include "Thread.h"
+#include <vector>
+#include <algorithm>
+
+namespace nsl {
+
+	/// Lock-free list of values pushed by any number of threads and taken by one consumer.
+	/// The consumer takes all values at once, so nodes are never reused while they are in the list (no ABA problem).
+	template <class T>
+	class ConcurrentStack
+	{
+	private:
+		struct Node
+		{
+			T value;
+			Node* next;
+		};
+
+		Node* volatile head;
+
+		ConcurrentStack(const ConcurrentStack&);
+		ConcurrentStack& operator=(const ConcurrentStack&);
+
+		/// detach the whole list, the newest node goes first
+		Node* takeNodes(void)
+		{
+			Node* node;
+			do {
+				node = (Node*)atomicLoad((void* volatile*)&head);
+			} while (!compareAndSwap((void* volatile*)&head, node, NULL));
+			return node;
+		}
+	public:
+		ConcurrentStack(void) : head(NULL) {}
+
+		~ConcurrentStack(void)
+		{
+			Node* node = takeNodes();
+			while (node != NULL) {
+				Node* next = node->next;
+				delete node;
+				node = next;
+			}
+		}
+
+		/// callable from any thread
+		void push(const T& value)
+		{
+			Node* node = new Node();
+			node->value = value;
+			do {
+				node->next = (Node*)atomicLoad((void* volatile*)&head);
+			} while (!compareAndSwap((void* volatile*)&head, node->next, node));
+		}
+
+		/// append all pushed values to the vector in order of pushing (per thread) and empty the list
+		void popAll(std::vector<T>& values)
+		{
+			unsigned int first = values.size();
+			Node* node = takeNodes();
+			while (node != NULL) {
+				values.push_back(node->value);
+				Node* next = node->next;
+				delete node;
+				node = next;
+			}
+			std::reverse(values.begin() + first, values.end());
+		}
+
+		bool isEmpty(void) {return atomicLoad((void* volatile*)&head) == NULL;}
+	};
+};
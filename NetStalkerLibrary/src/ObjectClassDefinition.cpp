@@ -5,6 +5,7 @@
  */
 
 #include "ObjectClassDefinition.h"
+#include <string.h>
 
 namespace nsl {
 	ObjectClassDefinition::ObjectClassDefinition(ObjectClass& userObject)
@@ -15,6 +16,7 @@ namespace nsl {
 		}
 			
 		id = userObject.id;
+		columnar = userObject.columnar;
 		attributeCount = userObject.attributeMaxId + 1;	// if there are any ids skipped, space will be wasted
 		attributes = new AttributeDefinition*[attributeCount]();
 
@@ -32,6 +34,43 @@ namespace nsl {
 				currentOffset += attributes[i]->size;
 			}
 		}
+
+		// position is read as float or double
+		positionDimensions = userObject.positionDimensions;
+		for (unsigned int i = 0; i < positionDimensions; i++) {
+			positionAttributes[i] = userObject.positionAttributes[i];
+			if (positionAttributes[i] >= attributeCount || attributes[positionAttributes[i]] == NULL) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: position attribute is not defined");
+			}
+			if (attributes[positionAttributes[i]]->size != float32::getByteSize() && attributes[positionAttributes[i]]->size != double64::getByteSize()) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: position attribute must be float32 or double64");
+			}
+		}
+
+		// group 0 is sent every tick, unless the user redefined it
+		AttributeGroupDefinition defaults = {1, 1};
+		groups = userObject.groups;
+		if (groups.empty()) {
+			groups.push_back(defaults);
+		}
+		deferred = false;
+		for (std::vector<AttributeGroupDefinition>::iterator it = groups.begin(); it != groups.end(); it++) {
+			if (it->period == 0) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: update period of attribute group must be at least one tick");
+			}
+			deferred = deferred || it->period > 1;
+		}
+
+		attributeGroups.assign(attributeCount, 0);
+		for (std::vector<std::pair<unsigned int, unsigned int> >::iterator it = userObject.attributeGroups.begin(); it != userObject.attributeGroups.end(); it++) {
+			if (it->first >= attributeCount || attributes[it->first] == NULL) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: attribute of update group is not defined");
+			}
+			if (it->second >= groups.size()) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: update group is not defined");
+			}
+			attributeGroups[it->first] = it->second;
+		}
 	}
 
 	AttributeDefinition* ObjectClassDefinition::getAttributeDefinition(unsigned int attrId)
@@ -65,4 +104,27 @@ namespace nsl {
 	{
 		return id;
 	}
+
+	bool ObjectClassDefinition::isPositionAttribute(unsigned int attrId)
+	{
+		for (unsigned int i = 0; i < positionDimensions; i++) {
+			if (positionAttributes[i] == attrId) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	double ObjectClassDefinition::readCoordinate(unsigned int dimension, byte* attributeData)
+	{
+		if (attributes[positionAttributes[dimension]]->size == float32::getByteSize()) {
+			float value;
+			memcpy(&value, attributeData, sizeof(float));
+			return value;
+		} else {
+			double value;
+			memcpy(&value, attributeData, sizeof(double));
+			return value;
+		}
+	}
 };
\ No newline at end of file
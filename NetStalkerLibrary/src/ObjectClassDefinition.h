@@ -19,6 +19,12 @@ namespace nsl {
 		unsigned int* offsets;	// optimization - specific offset can be otherwise retrieved by iteration trough all previous attributes
 		unsigned int attributeCount;
 		unsigned short id;
+		bool columnar;
+		unsigned int positionAttributes[3];
+		unsigned int positionDimensions;
+		std::vector<unsigned int> attributeGroups;		// update group of every attrId
+		std::vector<AttributeGroupDefinition> groups;
+		bool deferred;									// does any group have period longer than one tick?
 	public:
 		/// Convert user-defined ObjectClass to ObjectClassDefinition.
 		/// At least one attribute must be set, otherwise an exception is returned.
@@ -39,8 +45,38 @@ namespace nsl {
 		/// Get object total byte size
 		unsigned int getByteSize(void);
 
+		/// Get byte size of changed attribute mask (one bit per attrId)
+		unsigned int getAttributeMaskByteSize(void) {return (attributeCount + 7) / 8;}
+
 		/// Get object class unique identifier
 		unsigned short getId(void);
+
+		/// Is server history of this class stored by attributes?
+		bool isColumnar(void) {return columnar;}
+
+		/// Get count of position attributes (0 if the class has no position, 2 or 3 otherwise)
+		unsigned int getPositionDimensions(void) {return positionDimensions;}
+
+		/// Get attrId of position coordinate (0 = x, 1 = y, 2 = z)
+		unsigned int getPositionAttribute(unsigned int dimension) {return positionAttributes[dimension];}
+
+		/// Is given attribute one of position coordinates?
+		bool isPositionAttribute(unsigned int attrId);
+
+		/// Get update group of attribute (see ObjectClass::defineAttributeGroup)
+		unsigned int getAttributeGroup(unsigned int attrId) {return attributeGroups[attrId];}
+
+		/// Get count of update groups, there is always at least group 0
+		unsigned int getGroupCount(void) {return groups.size();}
+
+		/// Get definition of update group
+		AttributeGroupDefinition& getGroup(unsigned int groupId) {return groups[groupId];}
+
+		/// Are changes of some attributes held back for more than one tick?
+		bool hasDeferredGroups(void) {return deferred;}
+
+		/// Convert data of position attribute stored in native format to coordinate value
+		double readCoordinate(unsigned int dimension, byte* attributeData);
 	};
 
 };
\ No newline at end of file
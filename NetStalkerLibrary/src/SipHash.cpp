@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "SipHash.h"
+
+#define NSL_SIPHASH_ROTATE(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+namespace nsl {
+
+	static uint64_t readLittleEndian(const byte* data, unsigned int size)
+	{
+		uint64_t value = 0;
+		for (unsigned int i = 0; i < size; i++) {
+			value |= ((uint64_t)data[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	static void sipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+	{
+		v0 += v1; v1 = NSL_SIPHASH_ROTATE(v1, 13); v1 ^= v0; v0 = NSL_SIPHASH_ROTATE(v0, 32);
+		v2 += v3; v3 = NSL_SIPHASH_ROTATE(v3, 16); v3 ^= v2;
+		v0 += v3; v3 = NSL_SIPHASH_ROTATE(v3, 21); v3 ^= v0;
+		v2 += v1; v1 = NSL_SIPHASH_ROTATE(v1, 17); v1 ^= v2; v2 = NSL_SIPHASH_ROTATE(v2, 32);
+	}
+
+	uint64_t sipHash(const byte* key, const byte* data, unsigned int size)
+	{
+		uint64_t k0 = readLittleEndian(key, 8);
+		uint64_t k1 = readLittleEndian(key + 8, 8);
+		uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+		uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+		uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+		uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+		// whole 8 byte words
+		unsigned int end = size - size % 8;
+		for (unsigned int i = 0; i < end; i += 8) {
+			uint64_t m = readLittleEndian(data + i, 8);
+			v3 ^= m;
+			sipRound(v0, v1, v2, v3);
+			sipRound(v0, v1, v2, v3);
+			v0 ^= m;
+		}
+
+		// remaining bytes with the size in the last byte
+		uint64_t m = readLittleEndian(data + end, size - end) | (((uint64_t)size) << 56);
+		v3 ^= m;
+		sipRound(v0, v1, v2, v3);
+		sipRound(v0, v1, v2, v3);
+		v0 ^= m;
+
+		v2 ^= 0xff;
+		for (int i = 0; i < 4; i++) {
+			sipRound(v0, v1, v2, v3);
+		}
+		return v0 ^ v1 ^ v2 ^ v3;
+	}
+};
@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+
+#define NSL_SIPHASH_KEY_SIZE 16
+
+namespace nsl {
+
+	/// SipHash-2-4 keyed hash of the data, key has NSL_SIPHASH_KEY_SIZE bytes
+	/// output cannot be forged without the key, so it is used to authenticate tokens sent to clients
+	uint64_t sipHash(const byte* key, const byte* data, unsigned int size);
+};
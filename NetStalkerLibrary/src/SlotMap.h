@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+#include <vector>
+
+namespace nsl {
+
+	/// Get slot index part of id created by SlotMap
+	inline unsigned int getSlotMapIndex(unsigned int id) {return id & ((1u << NSL_SLOT_MAP_INDEX_BITS) - 1);}
+
+	/// Table of values by generational ids with O(1) lookup and dense storage of values for fast iteration.
+	/// Id consists of slot index and slot generation, which changes whenever the slot is reused, 
+	/// so stale ids of removed values are never found.
+	/// If a value is inserted into a slot occupied by an older generation (client receiving ids from server), 
+	/// the older value stays in the dense storage, but it cannot be found by id anymore.
+	/// T must be a pointer type, NULL is returned for missing values.
+	template <class T>
+	class SlotMap
+	{
+	private:
+		struct Slot
+		{
+			unsigned int id;			// id of value in slot, or id of the next value if the slot is free
+			unsigned int position;		// position of value in dense storage, NSL_SLOT_MAP_FREE if there is none
+		};
+
+		std::vector<Slot> slots;
+		std::vector<unsigned int> freeSlots;
+		std::vector<T> values;
+		std::vector<unsigned int> valueIds;
+	public:
+		/// get id, which will be used for the next value created by server
+		unsigned int getNextId(void);
+
+		/// store value under given id, which must come from getNextId() or from server
+		void insert(unsigned int id, T value);
+
+		/// if no value is found, NULL is returned
+		T find(unsigned int id);
+
+		/// remove value at given position of dense storage, the last value is moved to its place
+		void eraseAt(unsigned int position);
+
+		/// remove value with given id, if there is any
+		void erase(unsigned int id);
+
+		/// remove all values and forget all slots
+		void clear(void);
+
+		/// dense storage of values, in no particular order
+		unsigned int getSize(void) {return values.size();}
+		T getValue(unsigned int position) {return values[position];}
+		typename std::vector<T>::iterator begin(void) {return values.begin();}
+		typename std::vector<T>::iterator end(void) {return values.end();}
+
+		/// values by slot index, used when iteration in id order is needed
+		unsigned int getSlotCount(void) {return slots.size();}
+		T getBySlot(unsigned int index) {return slots[index].position == NSL_SLOT_MAP_FREE ? NULL : values[slots[index].position];}
+	};
+
+
+	// Slot Map templated methods implementation
+
+	template <class T>
+	unsigned int SlotMap<T>::getNextId(void)
+	{
+		if (!freeSlots.empty()) {
+			return slots[freeSlots.back()].id;
+		}
+		if (slots.size() > getSlotMapIndex(0xFFFFFFFF)) {
+			throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: maximal count of objects exceeded");
+		}
+		return slots.size();
+	}
+
+	template <class T>
+	void SlotMap<T>::insert(unsigned int id, T value)
+	{
+		unsigned int index = getSlotMapIndex(id);
+		while (slots.size() <= index) {
+			Slot slot;
+			slot.id = slots.size();
+			slot.position = NSL_SLOT_MAP_FREE;
+			slots.push_back(slot);
+		}
+		if (!freeSlots.empty() && freeSlots.back() == index) {
+			freeSlots.pop_back();
+		}
+
+		slots[index].id = id;
+		slots[index].position = values.size();
+		values.push_back(value);
+		valueIds.push_back(id);
+	}
+
+	template <class T>
+	T SlotMap<T>::find(unsigned int id)
+	{
+		unsigned int index = getSlotMapIndex(id);
+		if (index >= slots.size() || slots[index].id != id || slots[index].position == NSL_SLOT_MAP_FREE) {
+			return NULL;
+		}
+		return values[slots[index].position];
+	}
+
+	template <class T>
+	void SlotMap<T>::eraseAt(unsigned int position)
+	{
+		unsigned int id = valueIds[position];
+		unsigned int last = values.size() - 1;
+		if (position != last) {
+			values[position] = values[last];
+			valueIds[position] = valueIds[last];
+			Slot& movedSlot = slots[getSlotMapIndex(valueIds[position])];
+			if (movedSlot.id == valueIds[position]) {
+				movedSlot.position = position;
+			}
+		}
+		values.pop_back();
+		valueIds.pop_back();
+
+		// slot could have been taken by a newer generation already
+		unsigned int index = getSlotMapIndex(id);
+		if (slots[index].id == id) {
+			slots[index].id = id + (1u << NSL_SLOT_MAP_INDEX_BITS);
+			slots[index].position = NSL_SLOT_MAP_FREE;
+			freeSlots.push_back(index);
+		}
+	}
+
+	template <class T>
+	void SlotMap<T>::erase(unsigned int id)
+	{
+		unsigned int index = getSlotMapIndex(id);
+		if (index < slots.size() && slots[index].id == id && slots[index].position != NSL_SLOT_MAP_FREE) {
+			eraseAt(slots[index].position);
+		}
+	}
+
+	template <class T>
+	void SlotMap<T>::clear(void)
+	{
+		slots.clear();
+		freeSlots.clear();
+		values.clear();
+		valueIds.clear();
+	}
+};
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "Thread.h"
+
+namespace nsl {
+
+	/* Mutex */
+
+	Mutex::Mutex(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		InitializeCriticalSection(&mutex);
+#else
+		pthread_mutex_init(&mutex, NULL);
+#endif
+	}
+
+	Mutex::~Mutex(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		DeleteCriticalSection(&mutex);
+#else
+		pthread_mutex_destroy(&mutex);
+#endif
+	}
+
+	void Mutex::lock(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		EnterCriticalSection(&mutex);
+#else
+		pthread_mutex_lock(&mutex);
+#endif
+	}
+
+	void Mutex::unlock(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		LeaveCriticalSection(&mutex);
+#else
+		pthread_mutex_unlock(&mutex);
+#endif
+	}
+
+
+	/* Condition */
+
+	Condition::Condition(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		InitializeConditionVariable(&condition);
+#else
+		pthread_cond_init(&condition, NULL);
+#endif
+	}
+
+	Condition::~Condition(void)
+	{
+#ifndef NSL_PLATFORM_WINDOWS
+		pthread_cond_destroy(&condition);
+#endif
+	}
+
+	void Condition::wait(Mutex& mutex)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		SleepConditionVariableCS(&condition, &mutex.mutex, INFINITE);
+#else
+		pthread_cond_wait(&condition, &mutex.mutex);
+#endif
+	}
+
+	void Condition::notifyOne(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		WakeConditionVariable(&condition);
+#else
+		pthread_cond_signal(&condition);
+#endif
+	}
+
+	void Condition::notifyAll(void)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		WakeAllConditionVariable(&condition);
+#else
+		pthread_cond_broadcast(&condition);
+#endif
+	}
+
+
+	/* Thread */
+
+	Thread::Thread(void)
+	{
+		running = false;
+	}
+
+	Thread::~Thread(void)
+	{
+	}
+
+#ifdef NSL_PLATFORM_WINDOWS
+	DWORD WINAPI Thread::entryPoint(LPVOID thread)
+	{
+		((Thread*)thread)->function(((Thread*)thread)->argument);
+		return 0;
+	}
+#else
+	void* Thread::entryPoint(void* thread)
+	{
+		((Thread*)thread)->function(((Thread*)thread)->argument);
+		return NULL;
+	}
+#endif
+
+	void Thread::start(threadFunction function, void* argument)
+	{
+		if (running) {
+			throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: trying to start already running thread");
+		}
+
+		this->function = function;
+		this->argument = argument;
+
+#ifdef NSL_PLATFORM_WINDOWS
+		thread = CreateThread(NULL, 0, &Thread::entryPoint, this, 0, NULL);
+		if (thread == NULL) {
+#else
+		if (pthread_create(&thread, NULL, &Thread::entryPoint, this) != 0) {
+#endif
+			throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: thread cannot be created");
+		}
+		running = true;
+	}
+
+	void Thread::join(void)
+	{
+		if (!running) {
+			return;
+		}
+
+#ifdef NSL_PLATFORM_WINDOWS
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+#else
+		pthread_join(thread, NULL);
+#endif
+		running = false;
+	}
+
+	bool Thread::isRunning(void)
+	{
+		return running;
+	}
+};
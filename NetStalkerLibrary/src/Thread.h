@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+
+#ifndef NSL_PLATFORM_WINDOWS
+	#include <pthread.h>
+#endif
+
+namespace nsl {
+
+	/// Platform independent mutual exclusion lock
+	class Mutex
+	{
+	private:
+		friend class Condition;
+
+#ifdef NSL_PLATFORM_WINDOWS
+		CRITICAL_SECTION mutex;
+#else
+		pthread_mutex_t mutex;
+#endif
+
+		Mutex(const Mutex&);
+		Mutex& operator=(const Mutex&);
+	public:
+		Mutex(void);
+		~Mutex(void);
+		void lock(void);
+		void unlock(void);
+	};
+
+	/// Holds the mutex locked for its whole lifetime
+	class MutexGuard
+	{
+	private:
+		Mutex& mutex;
+
+		MutexGuard(const MutexGuard&);
+		MutexGuard& operator=(const MutexGuard&);
+	public:
+		MutexGuard(Mutex& mutex) : mutex(mutex) {mutex.lock();}
+		~MutexGuard(void) {mutex.unlock();}
+	};
+
+	/// Platform independent condition variable
+	class Condition
+	{
+	private:
+#ifdef NSL_PLATFORM_WINDOWS
+		CONDITION_VARIABLE condition;
+#else
+		pthread_cond_t condition;
+#endif
+
+		Condition(const Condition&);
+		Condition& operator=(const Condition&);
+	public:
+		Condition(void);
+		~Condition(void);
+
+		/// given mutex must be locked by the calling thread, it is unlocked during the wait
+		void wait(Mutex& mutex);
+		void notifyOne(void);
+		void notifyAll(void);
+	};
+
+	/// Replace *target by desired if it equals expected, as one atomic operation with full memory barrier
+	/// return true if it was replaced
+	inline bool compareAndSwap(void* volatile* target, void* expected, void* desired)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		return InterlockedCompareExchangePointer(target, desired, expected) == expected;
+#else
+		return __sync_bool_compare_and_swap(target, expected, desired);
+#endif
+	}
+
+	/// Read *target as one atomic operation with full memory barrier, while other threads may replace it by compareAndSwap
+	inline void* atomicLoad(void* volatile* target)
+	{
+#ifdef NSL_PLATFORM_WINDOWS
+		return InterlockedCompareExchangePointer(target, NULL, NULL);
+#else
+		return __sync_val_compare_and_swap(target, (void*)NULL, (void*)NULL);
+#endif
+	}
+
+	/// Platform independent thread
+	class Thread
+	{
+	public:
+		typedef void (*threadFunction)(void*);
+	private:
+#ifdef NSL_PLATFORM_WINDOWS
+		HANDLE thread;
+#else
+		pthread_t thread;
+#endif
+		threadFunction function;
+		void* argument;
+		bool running;
+
+#ifdef NSL_PLATFORM_WINDOWS
+		static DWORD WINAPI entryPoint(LPVOID thread);
+#else
+		static void* entryPoint(void* thread);
+#endif
+
+		Thread(const Thread&);
+		Thread& operator=(const Thread&);
+	public:
+		Thread(void);
+
+		/// thread must be joined before destruction
+		~Thread(void);
+
+		/// run function(argument) in new thread
+		/// if the thread is already running, exception is thrown
+		void start(threadFunction function, void* argument);
+
+		/// wait until the thread function returns
+		void join(void);
+
+		bool isRunning(void);
+	};
+};
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "ThreadPool.h"
+
+namespace nsl {
+
+	ThreadPool::ThreadPool(unsigned int threadCount)
+	{
+		job = NULL;
+		context = NULL;
+		jobCount = 0;
+		nextJob = 0;
+		finishedJobs = 0;
+		stopping = false;
+
+		for (unsigned int i = 0; i < threadCount; i++) {
+			Thread* thread = new Thread();
+			thread->start(&ThreadPool::workerLoop, this);
+			threads.push_back(thread);
+		}
+	}
+
+	ThreadPool::~ThreadPool(void)
+	{
+		mutex.lock();
+		stopping = true;
+		workAvailable.notifyAll();
+		mutex.unlock();
+
+		for (std::vector<Thread*>::iterator it = threads.begin(); it != threads.end(); it++) {
+			(*it)->join();
+			delete *it;
+		}
+	}
+
+	void ThreadPool::workerLoop(void* pool)
+	{
+		ThreadPool* p = (ThreadPool*)pool;
+		p->mutex.lock();
+		while (!p->stopping) {
+			if (p->nextJob < p->jobCount) {
+				p->runJobs();
+			} else {
+				p->workAvailable.wait(p->mutex);
+			}
+		}
+		p->mutex.unlock();
+	}
+
+	void ThreadPool::runJobs(void)
+	{
+		while (nextJob < jobCount) {
+			unsigned int index = nextJob++;
+			jobFunction currentJob = job;
+			void* currentContext = context;
+
+			mutex.unlock();
+			currentJob(currentContext, index);
+			mutex.lock();
+
+			if (++finishedJobs == jobCount) {
+				workFinished.notifyAll();
+			}
+		}
+	}
+
+	void ThreadPool::execute(jobFunction job, void* context, unsigned int jobCount)
+	{
+		if (jobCount == 0) {
+			return;
+		}
+
+		MutexGuard guard(mutex);
+		this->job = job;
+		this->context = context;
+		this->jobCount = jobCount;
+		nextJob = 0;
+		finishedJobs = 0;
+		workAvailable.notifyAll();
+
+		runJobs();
+		while (finishedJobs < this->jobCount) {
+			workFinished.wait(mutex);
+		}
+
+		this->jobCount = 0;
+		nextJob = 0;
+	}
+};
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+#include "Thread.h"
+#include <vector>
+
+namespace nsl {
+
+	/// Executor running jobs on a fixed set of library owned worker threads.
+	/// The thread calling execute(...) works on the jobs as well.
+	class ThreadPool : public Executor
+	{
+	private:
+		std::vector<Thread*> threads;
+		Mutex mutex;
+		Condition workAvailable;
+		Condition workFinished;
+		jobFunction job;
+		void* context;
+		unsigned int jobCount;
+		unsigned int nextJob;		// first job not taken by any thread yet
+		unsigned int finishedJobs;
+		bool stopping;
+
+		static void workerLoop(void* pool);
+
+		/// take and run jobs until there are none left
+		/// mutex must be locked when called and it is locked again on return
+		void runJobs(void);
+	public:
+		ThreadPool(unsigned int threadCount);
+
+		/// stops and joins all worker threads
+		~ThreadPool(void);
+
+		void execute(jobFunction job, void* context, unsigned int jobCount);
+
+		unsigned int getThreadCount(void) {return threads.size();}
+	};
+};
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "TimerWheel.h"
+#include <math.h>
+
+#define NSL_TIMER_WHEEL_SLOTS (1 << NSL_TIMER_WHEEL_SLOT_BITS)
+#define NSL_TIMER_WHEEL_RANGE (1LL << (NSL_TIMER_WHEEL_SLOT_BITS * NSL_TIMER_WHEEL_LEVELS))
+
+namespace nsl {
+
+	TimerWheel::TimerWheel(double resolution)
+		: resolution(resolution)
+	{
+		for (int level = 0; level < NSL_TIMER_WHEEL_LEVELS; level++) {
+			for (int slot = 0; slot < NSL_TIMER_WHEEL_SLOTS; slot++) {
+				slots[level][slot] = NULL;
+			}
+		}
+		expired = NULL;
+		currentTick = 0;
+		pendingCount = 0;
+	}
+
+	long long TimerWheel::getTick(double time)
+	{
+		return (long long)floor(time / resolution);
+	}
+
+	void TimerWheel::link(Timer** list, Timer* timer)
+	{
+		timer->list = list;
+		timer->previous = NULL;
+		timer->next = *list;
+		if (*list != NULL) {
+			(*list)->previous = timer;
+		}
+		*list = timer;
+	}
+
+	void TimerWheel::unlink(Timer* timer)
+	{
+		if (timer->list != &expired) {
+			pendingCount--;
+		}
+		if (timer->previous != NULL) {
+			timer->previous->next = timer->next;
+		} else {
+			*timer->list = timer->next;
+		}
+		if (timer->next != NULL) {
+			timer->next->previous = timer->previous;
+		}
+		timer->list = NULL;
+		timer->previous = NULL;
+		timer->next = NULL;
+	}
+
+	void TimerWheel::place(Timer* timer)
+	{
+		// timer expires in the first tick starting after its deadline
+		long long tick = getTick(timer->deadline) + 1;
+		if (tick <= currentTick) {
+			link(&expired, timer);
+			return;
+		}
+
+		long long delta = tick - currentTick;
+		int level = 0;
+		while (level < NSL_TIMER_WHEEL_LEVELS - 1 && (delta >> (NSL_TIMER_WHEEL_SLOT_BITS * (level + 1))) != 0) {
+			level++;
+		}
+		if (delta >= NSL_TIMER_WHEEL_RANGE) {
+			// too far, timer waits in the last slot and is placed again when it is cascaded
+			tick = currentTick + NSL_TIMER_WHEEL_RANGE - 1;
+		}
+
+		link(&slots[level][(tick >> (NSL_TIMER_WHEEL_SLOT_BITS * level)) & (NSL_TIMER_WHEEL_SLOTS - 1)], timer);
+		pendingCount++;
+	}
+
+	void TimerWheel::cascade(int level, int slot)
+	{
+		Timer* timer = slots[level][slot];
+		slots[level][slot] = NULL;
+		while (timer != NULL) {
+			Timer* next = timer->next;
+			timer->list = NULL;
+			pendingCount--;
+			place(timer);
+			timer = next;
+		}
+	}
+
+	void TimerWheel::schedule(Timer* timer, double deadline)
+	{
+		if (timer->isScheduled()) {
+			unlink(timer);
+		}
+		timer->deadline = deadline;
+		place(timer);
+	}
+
+	void TimerWheel::cancel(Timer* timer)
+	{
+		if (timer->isScheduled()) {
+			unlink(timer);
+		}
+	}
+
+	void TimerWheel::advance(double time)
+	{
+		long long tick = getTick(time);
+		if (tick <= currentTick) {
+			return;
+		}
+
+		if (tick - currentTick >= NSL_TIMER_WHEEL_RANGE) {
+			// every slot would be passed, so all timers are placed again at once
+			currentTick = tick;
+			for (int level = 0; level < NSL_TIMER_WHEEL_LEVELS; level++) {
+				for (int slot = 0; slot < NSL_TIMER_WHEEL_SLOTS; slot++) {
+					cascade(level, slot);
+				}
+			}
+			return;
+		}
+
+		while (currentTick < tick && pendingCount > 0) {
+			currentTick++;
+			for (int level = NSL_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+				if ((currentTick & ((1LL << (NSL_TIMER_WHEEL_SLOT_BITS * level)) - 1)) == 0) {
+					cascade(level, (int)((currentTick >> (NSL_TIMER_WHEEL_SLOT_BITS * level)) & (NSL_TIMER_WHEEL_SLOTS - 1)));
+				}
+			}
+			// timers of the lowest level slot are due now
+			cascade(0, (int)(currentTick & (NSL_TIMER_WHEEL_SLOTS - 1)));
+		}
+
+		// empty wheel does not need to visit remaining slots
+		currentTick = tick;
+	}
+
+	Timer* TimerWheel::popExpired(void)
+	{
+		Timer* timer = expired;
+		if (timer != NULL) {
+			unlink(timer);
+		}
+		return timer;
+	}
+};
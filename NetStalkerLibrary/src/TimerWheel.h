@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "configuration.h"
+
+namespace nsl {
+
+	/// Timer is a part of its owner, so scheduling does not allocate anything
+	struct Timer
+	{
+		double deadline;
+		void* owner;
+		Timer* previous;
+		Timer* next;
+		Timer** list;		// head of the list holding the timer, NULL if the timer is not scheduled
+		Timer(void* owner = NULL) : deadline(0), owner(owner), previous(NULL), next(NULL), list(NULL) {}
+		bool isScheduled(void) {return list != NULL;}
+	};
+
+	/// Hierarchical timer wheel, scheduling, cancelling and expiring a timer takes constant time regardless of the number of timers.
+	/// Slot of the lowest level covers one tick of given resolution, slot of every higher level covers the whole level below it.
+	/// Timers are moved to lower levels as their deadline approaches.
+	class TimerWheel
+	{
+	private:
+		Timer* slots[NSL_TIMER_WHEEL_LEVELS][1 << NSL_TIMER_WHEEL_SLOT_BITS];
+		Timer* expired;				// timers which deadline has passed, waiting to be popped
+		double resolution;
+		long long currentTick;		// all ticks up to this one have been processed
+		unsigned int pendingCount;	// number of timers in slots, expired ones are not counted
+
+		TimerWheel(const TimerWheel&);
+		TimerWheel& operator=(const TimerWheel&);
+
+		long long getTick(double time);
+		void link(Timer** list, Timer* timer);
+		void unlink(Timer* timer);
+
+		/// put the timer to the slot matching its deadline or to expired timers if the deadline has passed
+		void place(Timer* timer);
+
+		/// take all timers of the slot and place them again (to lower levels or to expired timers)
+		void cascade(int level, int slot);
+	public:
+		TimerWheel(double resolution = NSL_TIMER_WHEEL_RESOLUTION);
+
+		/// timer expires in the first advance(...) past its deadline, already scheduled timer is moved
+		void schedule(Timer* timer, double deadline);
+
+		/// remove the timer from the wheel, nothing happens if it is not scheduled
+		void cancel(Timer* timer);
+
+		/// process time up to the given one, timers which deadline has passed become expired
+		void advance(double time);
+
+		/// take one expired timer, NULL is returned if there is none
+		Timer* popExpired(void);
+	};
+};
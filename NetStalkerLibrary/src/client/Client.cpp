@@ -34,6 +34,11 @@ namespace nsl {
 		i->close();
 	}
 
+	void Client::reconnect(void)
+	{
+		i->reconnect();
+	}
+
 	ClientState Client::updateNetwork(double time)
 	{
 		return i->updateNetwork(time);
@@ -53,4 +58,9 @@ namespace nsl {
 	{
 		i->flushNetwork();
 	}
+
+	FragmentationStats Client::getFragmentationStats(void)
+	{
+		return i->getFragmentationStats();
+	}
 }
\ No newline at end of file
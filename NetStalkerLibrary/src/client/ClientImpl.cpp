@@ -40,6 +40,25 @@ namespace nsl {
 		void ClientImpl::open(const char* address, const char* port, const char* clientPort)
 		{
 			connection.open(address, port, clientPort, getTime());
+
+			// objects kept for resuming the previous session are not valid in the new one
+			objectManager.reset();
+			historyBuffer.reset();
+			customMessageBuffer.reset();
+		}
+
+		void ClientImpl::reconnect(void)
+		{
+			connection.resume(getTime());
+		}
+
+		void ClientImpl::onConnectionClosed(void)
+		{
+			if (connection.isResumable()) {
+				lastConnectionState = CLOSED;
+			} else {
+				close();
+			}
 		}
 
 		void ClientImpl::registerObjectClass(ObjectClassDefinition* objectClass)
@@ -61,7 +80,7 @@ namespace nsl {
 			// check connection status and try to connect / handshake, if neccessary
 			lastConnectionState = connection.update(currentTime);
 			if (lastConnectionState == CLOSED) {
-				close();
+				onConnectionClosed();
 				throw Exception(NSL_EXCEPTION_DISCONNECTED, "NSL: connection closed.");
 			}
 			
@@ -149,7 +168,7 @@ namespace nsl {
 			// disconnect could have occured during proccessing incomming messages
 			lastConnectionState = connection.update(currentTime);
 			if (lastConnectionState == CLOSED) {
-				close();
+				onConnectionClosed();
 				throw Exception(NSL_EXCEPTION_DISCONNECTED, "NSL: not connected.");
 			}
 
@@ -160,7 +179,8 @@ namespace nsl {
 
 		void ClientImpl::flushNetwork(void)
 		{
-			if (!historyBuffer.isEmpty()) {
+			// objects kept for a resumed session are not acknowledged until the session goes on
+			if (!historyBuffer.isEmpty() && lastConnectionState == CONNECTED) {
 				Packet* packet = connection.createPacket();
 				BitStreamWriter* stream = packet->getStream();
 				stream->write<Attribute<seqNumber> >(historyBuffer.indexToSeq(historyBuffer.getLastSeqIndex()));
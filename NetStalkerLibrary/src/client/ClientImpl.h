@@ -39,6 +39,9 @@ namespace nsl {
 			std::vector<std::pair<BitStreamWriter*, bool> > newCustomMessages;	// message stream and reliability are stored
 
 			ProtocolParser protocolParser;
+
+			/// connection was closed by the server, objects are kept only if the session can be resumed
+			void onConnectionClosed(void);
 		public:
 			ClientImpl(Client* userObject, unsigned short applicationId);
 
@@ -50,12 +53,17 @@ namespace nsl {
 
 			void close(void);
 
+			/// continue the session closed by the server, objects and messages are kept
+			void reconnect(void);
+
 			ClientState updateNetwork(double time = 0);
 
 			void flushNetwork(void);
 
 			/// Max size is NSL_MAX_CUSTOM_MESSAGE_SIZE
 			BitStreamWriter* createCustomMessage(bool reliable);
+
+			FragmentationStats getFragmentationStats(void) {return connection.getFragmentationStats();}
 		};
 	};
 };
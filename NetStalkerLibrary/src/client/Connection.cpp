@@ -6,6 +6,8 @@
 
 #include "Connection.h"
 #include "../../include/nslBitStream.h"
+#include "../SipHash.h"
+#include <string.h>
 #if !defined NSL_PLATFORM_WINDOWS
 #include <arpa/inet.h>
 #endif
@@ -44,6 +46,10 @@ namespace nsl {
 		{
 			state = CLOSED;
 			connectionId = 0;
+			cookie = 0;
+			nonce = 0;
+			resumeToken = 0;
+			resuming = false;
 			bufferedMessage = NULL;
 			// create bitStream with statically allocated buffer, so do not bind it
 			bufferStream = new BitStreamReader(buffer, NSL_MAX_UDP_PACKET_SIZE, false);
@@ -58,7 +64,7 @@ namespace nsl {
 		{
 			delete bufferStream;
 #ifdef NSL_COMPRESS
-			delete decompressionBuffer;
+			delete[] decompressionBuffer;
 #endif
 		}
 
@@ -74,6 +80,9 @@ namespace nsl {
 				bufferedMessage = NULL;
 			}
 			connectionId = 0;
+			resuming = false;
+			fragmentBuffer.reset();
+			nonce = createNonce(time);
 
 			// try to estabilish connection
 			socket.open(clientPort);
@@ -88,25 +97,66 @@ namespace nsl {
 			sendConnectionRequest(time);
 		}
 
+		unsigned int Connection::createNonce(double time)
+		{
+			// nonce only tells connections from the same address apart, it does not have to be secret
+			static unsigned int openCount = 0;
+			double seed[3] = {time, getTime(), (double)++openCount};
+			byte key[NSL_SIPHASH_KEY_SIZE];
+			memset(key, 0, NSL_SIPHASH_KEY_SIZE);
+			return (unsigned int)sipHash(key, (byte*)seed, sizeof(seed));
+		}
+
 		void Connection::sendConnectionRequest(double time)
 		{
-			BitStreamWriter stream(6);
+			BitStreamWriter stream(10);
 			stream.write<uint16>(applicationId);
 			stream.write<uint32>(0);
-			socket.send(connectedAddress, stream.buffer, 6);
+			stream.write<uint32>(nonce);
+			socket.send(connectedAddress, stream.buffer, 10);
 			lastRequest = time;
 		}
 
 		void Connection::sendHandshake(double time)
 		{
-			BitStreamWriter stream(7);
+			BitStreamWriter stream(11);
 			stream.write<uint16>(applicationId);
-			stream.write<uint32>(connectionId);
+			stream.write<uint32>(cookie);
 			stream.write<uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
-			socket.send(connectedAddress, stream.buffer, 7);
+			stream.write<uint32>(nonce);
+			socket.send(connectedAddress, stream.buffer, 11);
 			lastRequest = time;
 		}
 
+		void Connection::sendResume(double time)
+		{
+			BitStreamWriter stream(15);
+			stream.write<uint16>(applicationId);
+			stream.write<uint32>(connectionId);
+			stream.write<uint8>(NSL_CONNECTION_FLAG_RESUME);
+			stream.write<uint64>(resumeToken);
+			socket.send(connectedAddress, stream.buffer, 15);
+			lastRequest = time;
+		}
+
+		void Connection::resume(double time)
+		{
+			if (!isResumable()) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: there is no session to resume.");
+			}
+
+			// the rest of interrupted update cannot be used anymore
+			if (bufferedMessage != NULL) {
+				delete bufferedMessage;
+				bufferedMessage = NULL;
+			}
+			fragmentBuffer.reset();
+
+			state = HANDSHAKING;
+			resuming = true;
+			sendResume(time);
+		}
+
 		void Connection::sendDisconnect(void)
 		{
 			BitStreamWriter stream(7);
@@ -125,9 +175,9 @@ namespace nsl {
 
 			switch(state) {
 			case CONNECTING:
-				// accept only connectionResponse (and get its connectionId)
+				// accept only connectionResponse (and get its cookie)
 				while (size = socket.receive(sender,buffer, NSL_MAX_UDP_PACKET_SIZE)) {
-					if (size != 6) {
+					if (size != 11) {
 						continue;
 					}
 
@@ -136,7 +186,11 @@ namespace nsl {
 					if (bufferStream->read<uint16>() != applicationId) {
 						continue;
 					}
-					connectionId = bufferStream->read<int32>();
+					unsigned int offeredCookie = bufferStream->read<uint32>();
+					if (bufferStream->readByte() != NSL_CONNECTION_FLAG_HANDSHAKE || bufferStream->read<uint32>() != nonce) {
+						continue;
+					}
+					cookie = offeredCookie;
 					state = HANDSHAKING;
 					sendHandshake(time);
 					return state;
@@ -158,34 +212,65 @@ namespace nsl {
 					if (bufferStream->read<uint16>() != applicationId) {
 						continue;
 					}
-					if (bufferStream->read<uint32>() != connectionId) {
+					if (bufferStream->read<uint32>() != (resuming ? connectionId : cookie)) {
+						continue;
+					}
+					byte flag = bufferStream->readByte();
+
+					// new session gets its connection id, when the server accepts the handshake
+					if (!resuming) {
+						if (flag == NSL_CONNECTION_FLAG_DISCONNECT) {
+							state = CLOSED;
+							return state;
+						}
+						if (flag == NSL_CONNECTION_FLAG_HANDSHAKE && size == 19) {
+							connectionId = bufferStream->read<uint32>();
+							resumeToken = bufferStream->read<uint64>();
+							state = CONNECTED;
+							return state;
+						}
+
+						// reply to a resent connection request
 						continue;
 					}
 
-					// process handshake response
-					switch (bufferStream->readByte()) {
+					// process resume response, any update means the server accepted it
+					switch (flag) {
 					case NSL_CONNECTION_FLAG_DISCONNECT:
+						// server refused to resume the session
+						connectionId = 0;
 						state = CLOSED;
 						return state;
+					case NSL_CONNECTION_FLAG_HANDSHAKE:
+						// late reply to the handshake of the session
+						continue;
 					case NSL_CONNECTION_FLAG_UPDATE:
-						state = CONNECTED;
-						bufferedMessage = bufferStream->createSubreader(size - 7, true);
-						return state;
 					case NSL_CONNECTION_FLAG_COMPRESSED_UPDATE:
-						state = CONNECTED;
-#ifdef NSL_COMPRESS
-						bufferedMessage = decompressStream(bufferStream);
-#else
-						throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: Compressed update was received from server, but compression is turned of on client");
-#endif
-						return state;
+						fragmentBuffer.countPacket();
+						bufferedMessage = extractUpdate(flag);
+						break;
+					case NSL_CONNECTION_FLAG_FRAGMENT:
+						bufferedMessage = extractFragment(size);
+						break;
 					default:
 						throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: protocol error, received not expected data.");
 					}
+
+					// buffer stream is reused by next receive
+					if (bufferedMessage == bufferStream) {
+						bufferedMessage = bufferStream->createSubreader(bufferStream->getRemainingByteSize(), true);
+					}
+					state = CONNECTED;
+					resuming = false;
+					return state;
 				}
 
 				if (lastRequest + NSL_TIMEOUT_CLIENT_HANDSHAKE < time) {
-					sendHandshake(time);
+					if (resuming) {
+						sendResume(time);
+					} else {
+						sendHandshake(time);
+					}
 				}
 				break;
 			case CLOSED:
@@ -204,6 +289,8 @@ namespace nsl {
 				state = CLOSED;
 				sendDisconnect();
 			}
+			connectionId = 0;
+			resuming = false;
 		}
 
 		Packet* Connection::createPacket(void)
@@ -271,18 +358,29 @@ namespace nsl {
 				}
 
 				// process payoad
-				switch (bufferStream->readByte()) {
+				BitStreamReader* update;
+				byte flag = bufferStream->readByte();
+				switch (flag) {
 				case NSL_CONNECTION_FLAG_DISCONNECT:
 					state = CLOSED;
 					return NULL;
+				case NSL_CONNECTION_FLAG_HANDSHAKE:
+					// late reply to a resent handshake
+					break;
 				case NSL_CONNECTION_FLAG_UPDATE:
-					return bufferStream;//->createSubreader(size - 7, true);
 				case NSL_CONNECTION_FLAG_COMPRESSED_UPDATE:
-#ifdef NSL_COMPRESS
-					return decompressStream(bufferStream);
-#else
-					throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: Compressed update was received from server, but compression is turned of on client");
-#endif
+					fragmentBuffer.countPacket();
+					update = extractUpdate(flag);
+					if (update != NULL) {
+						return update;
+					}
+					break;
+				case NSL_CONNECTION_FLAG_FRAGMENT:
+					update = extractFragment(size);
+					if (update != NULL) {
+						return update;
+					}
+					break;
 				default:
 					throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: protocol error, received not expected data.");
 				}
@@ -291,6 +389,42 @@ namespace nsl {
 			return NULL;
 		}
 
+		BitStreamReader* Connection::extractUpdate(byte flag)
+		{
+			switch (flag) {
+			case NSL_CONNECTION_FLAG_UPDATE:
+				return bufferStream;//->createSubreader(size - 7, true);
+			case NSL_CONNECTION_FLAG_COMPRESSED_UPDATE:
+#ifdef NSL_COMPRESS
+				return decompressStream(bufferStream);
+#else
+				throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: Compressed update was received from server, but compression is turned of on client");
+#endif
+			default:
+				throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: protocol error, received not expected data.");
+			}
+		}
+
+		BitStreamReader* Connection::extractFragment(unsigned int size)
+		{
+			if (size <= NSL_FRAGMENT_HEADER_SIZE) {
+				return NULL;
+			}
+			unsigned short packetId = bufferStream->read<uint16>();
+			unsigned int index = bufferStream->readByte();
+			unsigned int count = bufferStream->readByte();
+			unsigned int packetSize = bufferStream->read<uint16>();
+			if (!fragmentBuffer.addFragment(packetId, index, count, packetSize, bufferStream->currentByte, size - NSL_FRAGMENT_HEADER_SIZE)) {
+				return NULL;
+			}
+
+			// reassembled packet starts by update flag, connection header stays as it is
+			memcpy(buffer + 6, fragmentBuffer.getPacket(), packetSize);
+			bufferStream->resetStream(6 + packetSize);
+			bufferStream->skipBits(6*8);
+			return extractUpdate(bufferStream->readByte());
+		}
+
 #ifdef NSL_COMPRESS
 		BitStreamReader* Connection::decompressStream(BitStreamReader* input)
 		{
@@ -302,8 +436,12 @@ namespace nsl {
 
 			unsigned int decompressedByteSize = decompress(input->currentByte, decompressionBuffer, streamByteSize, decompressionBufferSize);
 			while (decompressedByteSize == 0) {
-				delete decompressionBuffer;
-				decompressionBufferSize *= 2;
+				// corrupted data fail in any buffer
+				if (decompressionBufferSize >= NSL_MAX_DECOMPRESSED_PACKET_SIZE) {
+					return NULL;
+				}
+				delete[] decompressionBuffer;
+				decompressionBufferSize = (decompressionBufferSize * 2 < NSL_MAX_DECOMPRESSED_PACKET_SIZE ? decompressionBufferSize * 2 : NSL_MAX_DECOMPRESSED_PACKET_SIZE);
 				decompressionBuffer = new byte[decompressionBufferSize];
 				decompressedByteSize = decompress(input->currentByte, decompressionBuffer, streamByteSize, decompressionBufferSize);
 			}
@@ -13,6 +13,7 @@ namespace nsl {
 
 #include "../configuration.h"
 #include "../Socket.h"
+#include "FragmentBuffer.h"
 #ifdef NSL_COMPRESS
 #include "../compression/compression.h"
 #endif
@@ -51,6 +52,10 @@ namespace nsl {
 			friend class Packet;
 
 			unsigned int connectionId;
+			unsigned int cookie;			// sent back to the server in handshake, the server allocates connection id then
+			unsigned int nonce;				// sent in connection request, so the server does not take a new connection for a copy of the old one
+			uint64_t resumeToken;			// proves to the server that the session is ours, see resume()
+			bool resuming;					// is the handshake a resume request?
 			unsigned short applicationId;
 			unsigned short clientPort;
 			ConnectionState state;
@@ -64,10 +69,18 @@ namespace nsl {
 #endif
 			BitStreamReader* bufferStream;	// stream over buffer to make reading of it easier
 			BitStreamReader* bufferedMessage;
+			FragmentBuffer fragmentBuffer;
 
 			void send(Packet* packet);
+			/// Add fragment from buffer stream (read behind flag) to fragment buffer
+			/// If the update is complete now, it is copied to buffer and its stream is returned (the same as for unfragmented one)
+			BitStreamReader* extractFragment(unsigned int size);
+			/// Return stream of update, which follows given flag in buffer stream, NULL if the update is malformed
+			BitStreamReader* extractUpdate(byte flag);
+			unsigned int createNonce(double time);
 			void sendConnectionRequest(double time);
 			void sendHandshake(double time);
+			void sendResume(double time);
 			void sendDisconnect(void);
 		public:
 			Connection(unsigned short applicationId);
@@ -75,12 +88,20 @@ namespace nsl {
 			/// clientPort can be null, then it will be chosen automatically
 			void open(const char* address, const char* port, const char* clientPort, double time);
 			ConnectionState update(double time);
+			/// close the connection and forget the session, the server is told about it
 			void close(void);
+			/// can the session closed by the server (or lost in the network) be resumed?
+			bool isResumable(void) {return connectionId != 0;}
+			/// ask the server to continue the session under its connection id, the connection is handshaking again
+			/// if the server does not know the session anymore, the connection gets closed and it is not resumable
+			void resume(double time);
 			Packet* createPacket(void);
 			BitStreamReader* receive(void);
+			FragmentationStats& getFragmentationStats(void) {return fragmentBuffer.getStats();}
 #ifdef NSL_COMPRESS
 			// all remaining data in stream will be decompressed
 			// new reader with new buffer will be created (containing just decompressed data)
+			// NULL is returned for malformed data
 			BitStreamReader* decompressStream(BitStreamReader* stream);
 #endif
 		};
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "FragmentBuffer.h"
+#include <string.h>
+
+namespace nsl {
+	namespace client {
+		FragmentBuffer::FragmentBuffer(void)
+		{
+			reset();
+		}
+
+		FragmentBuffer::~FragmentBuffer(void)
+		{
+		}
+
+		void FragmentBuffer::reset(void)
+		{
+			started = false;
+			complete = false;
+			packetId = 0;
+			fragmentCount = 0;
+			receivedCount = 0;
+			packetSize = 0;
+		}
+
+		bool FragmentBuffer::isNewer(unsigned short id)
+		{
+			return id != packetId && (unsigned short)(id - packetId) < 0x8000;
+		}
+
+		bool FragmentBuffer::addFragment(unsigned short id, unsigned int index, unsigned int count, unsigned int size, const byte* data, unsigned int dataSize)
+		{
+			// packet is split evenly, only the last fragment can be smaller
+			// it is reassembled behind connection header in the receive buffer, so the header must fit there as well
+			if (index >= count || size > NSL_MAX_UDP_PACKET_SIZE - 6 || count > size) {
+				return false;
+			}
+			unsigned int fragmentSize = (size + count - 1) / count;
+			unsigned int offset = index * fragmentSize;
+			if (offset >= size || dataSize != (size - offset < fragmentSize ? size - offset : fragmentSize)) {
+				return false;
+			}
+
+			if (!started || isNewer(id)) {
+				// unfinished older packet will never be used
+				if (started && !complete) {
+					stats.droppedPacketCount++;
+				}
+				started = true;
+				complete = false;
+				packetId = id;
+				fragmentCount = count;
+				receivedCount = 0;
+				packetSize = size;
+				memset(received, 0, sizeof(received));
+			} else if (id != packetId || complete) {
+				// fragment of an older packet or a duplicate of finished one
+				return false;
+			} else if (count != fragmentCount || size != packetSize || received[index]) {
+				return false;
+			}
+
+			received[index] = true;
+			receivedCount++;
+			stats.fragmentCount++;
+			memcpy(buffer + offset, data, dataSize);
+
+			if (receivedCount == fragmentCount) {
+				complete = true;
+				stats.packetCount++;
+				stats.fragmentedPacketCount++;
+				return true;
+			}
+			return false;
+		}
+	};
+};
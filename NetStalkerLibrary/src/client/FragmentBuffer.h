@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "../configuration.h"
+
+namespace nsl {
+	namespace client {
+
+		/// Reassembles updates, which server split into fragments because of MTU
+		/// Only the newest fragmented update is kept, unfinished older one is dropped when fragments of a newer one arrive
+		class FragmentBuffer
+		{
+		private:
+			byte buffer[NSL_MAX_UDP_PACKET_SIZE];
+			bool received[256];
+			bool started;				// is there any packet in the buffer?
+			bool complete;				// was the packet in buffer already finished?
+			unsigned short packetId;
+			unsigned int fragmentCount;
+			unsigned int receivedCount;
+			unsigned int packetSize;
+			FragmentationStats stats;
+
+			/// fragmented packet ids are compared using modulo, like seq numbers
+			bool isNewer(unsigned short id);
+		public:
+			FragmentBuffer(void);
+			~FragmentBuffer(void);
+
+			/// Store fragment data (everything behind fragment header) at its place
+			/// Return true if the packet is complete, it can be read by getPacket() until next fragment is added
+			/// Malformed, duplicate and outdated fragments are ignored
+			bool addFragment(unsigned short packetId, unsigned int index, unsigned int count, unsigned int packetSize, const byte* data, unsigned int dataSize);
+
+			byte* getPacket(void) {return buffer;}
+			unsigned int getPacketSize(void) {return packetSize;}
+
+			/// Count packet, which arrived unfragmented
+			void countPacket(void) {stats.packetCount++;}
+			FragmentationStats& getStats(void) {return stats;}
+
+			/// Forget unfinished packet (on new connection), stats are kept
+			void reset(void);
+		};
+	};
+};
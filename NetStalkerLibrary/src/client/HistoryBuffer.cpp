@@ -19,6 +19,10 @@ namespace nsl {
 			validUpdatesCounter = 0;
 			networkIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			networkAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			pushedAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			rebasedAck = 0;
+			rebasedAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			timeOffset = 0;
 			firstDataIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			applicationIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			neccessaryIndexBeforeNetworkCount = 0;
@@ -35,6 +39,10 @@ namespace nsl {
 			validUpdatesCounter = 0;
 			networkIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			networkAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			pushedAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			rebasedAck = 0;
+			rebasedAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			timeOffset = 0;
 			firstDataIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			applicationIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			neccessaryIndexBeforeNetworkCount = 0;
@@ -91,7 +99,8 @@ namespace nsl {
 		bool HistoryBuffer::pushSeq(seqNumber seq, seqNumber ack, double time, int& firstIndexToClear, int& lastIndexToClear, double applicationTime)
 		{
 			// is ack missing in buffer?
-			if (ack != seq && (!isSeqInBounds(ack) || !isIndexValid(seqToIndex(ack)))) {
+			int ackIndex = (ack == seq ? NSL_UNDEFINED_BUFFER_INDEX : findAckIndex(ack));
+			if (ack != seq && ackIndex == NSL_UNDEFINED_BUFFER_INDEX) {
 				return false;
 			}
 
@@ -126,12 +135,13 @@ namespace nsl {
 				
 				// set new values
 				validData[networkIndex] = true;
-				timeData[networkIndex] = time;
+				timeData[networkIndex] = time - timeOffset;
 				lastSeq = seq;
+				pushedAckIndex = (ackIndex == NSL_UNDEFINED_BUFFER_INDEX ? networkIndex : ackIndex);
 
 				// update ack index - for initial packets with seq=ack set ack only for the first time
-				if (networkAckIndex == NSL_UNDEFINED_BUFFER_INDEX || (seq != ack && isSecondSeqGreater(indexToSeq(networkAckIndex), ack))) {
-					networkAckIndex = seqToIndex(ack);
+				if (networkAckIndex == NSL_UNDEFINED_BUFFER_INDEX || (seq != ack && isSecondSeqGreater(getNetworkAck(), ack))) {
+					setNetworkAckIndex(pushedAckIndex);
 				}
 
 				updateNeccessaryIndexCount();
@@ -146,11 +156,12 @@ namespace nsl {
 					return false;
 				} else {
 					validData[index] = true;
-					timeData[index] = time;
+					timeData[index] = time - timeOffset;
+					pushedAckIndex = (ackIndex == NSL_UNDEFINED_BUFFER_INDEX ? index : ackIndex);
 
 					// update ack index
-					if (seq != ack && isSecondSeqGreater(indexToSeq(networkAckIndex), ack)) {
-						networkAckIndex = seqToIndex(ack);
+					if (seq != ack && isSecondSeqGreater(getNetworkAck(), ack)) {
+						setNetworkAckIndex(ackIndex);
 					}
 
 					firstIndexToClear = NSL_UNDEFINED_BUFFER_INDEX;
@@ -161,12 +172,92 @@ namespace nsl {
 					return true;
 				}
 
+			// seq is too far ahead, it cannot wait until the buffer moves
+			} else if (applicationIndex != NSL_UNDEFINED_BUFFER_INDEX && isSecondSeqGreater(lastSeq, seq)) {
+				return rebase(seq, ack, ackIndex, time, firstIndexToClear, lastIndexToClear, applicationTime);
+
 			// seq is not relevant
 			} else {
 				return false;
 			}
 		}
 
+		bool HistoryBuffer::rebase(seqNumber seq, seqNumber ack, int ackIndex, double time, int& firstIndexToClear, int& lastIndexToClear, double applicationTime)
+		{
+			// new seq follows the application index or the ack, whichever leaves more free indexes before the other one
+			int ackFromApplicationDistance = (ackIndex == NSL_UNDEFINED_BUFFER_INDEX ? 0 : (ackIndex - applicationIndex + NSL_PACKET_BUFFER_SIZE) % NSL_PACKET_BUFFER_SIZE);
+			int previousIndex = applicationIndex;
+			int limitIndex = applicationIndex;
+			if (ackFromApplicationDistance != 0) {
+				if (ackFromApplicationDistance <= NSL_PACKET_BUFFER_SIZE / 2) {
+					previousIndex = ackIndex;
+				} else {
+					limitIndex = ackIndex;
+				}
+			}
+
+			// new seq comes one average interval after the application data
+			double interval = getAverageTimeInterval(NSL_TIME_INTERVAL_AVERAGE_COUNT);
+			timeOffset = time - timeData[applicationIndex] - interval;
+
+			// only the application index stays valid, the ack keeps its data for diffs, but it is no longer a point in time
+			// data of other indexes are cleared when the network index reaches them
+			for (int index = 0; index < NSL_PACKET_BUFFER_SIZE; index++) {
+				if (index != applicationIndex) {
+					validData[index] = false;
+				}
+			}
+			networkIndex = (previousIndex + 1) % NSL_PACKET_BUFFER_SIZE;
+			firstIndexToClear = networkIndex;
+			lastIndexToClear = (limitIndex - 1 + NSL_PACKET_BUFFER_SIZE) % NSL_PACKET_BUFFER_SIZE;
+
+			// older seqs are not mapped to their indexes anymore, so the new seq is the first in bounds
+			validData[networkIndex] = true;
+			timeData[networkIndex] = time - timeOffset;
+			lastSeq = seq;
+			firstDataIndex = networkIndex;
+
+			// the ack is remembered until the server acknowledges something newer
+			if (ackIndex == NSL_UNDEFINED_BUFFER_INDEX) {
+				pushedAckIndex = networkIndex;
+				setNetworkAckIndex(networkIndex);
+			} else {
+				pushedAckIndex = ackIndex;
+				networkAckIndex = ackIndex;
+				rebasedAck = ack;
+				rebasedAckIndex = ackIndex;
+			}
+
+			updateNeccessaryIndexCount();
+			validUpdatesCounter++;
+			lastUpdateApplicationTime = applicationTime;
+			return true;
+		}
+
+		int HistoryBuffer::findAckIndex(seqNumber ack)
+		{
+			if (rebasedAckIndex != NSL_UNDEFINED_BUFFER_INDEX && ack == rebasedAck) {
+				return rebasedAckIndex;
+			}
+			if (isSeqInBounds(ack) && isIndexValid(seqToIndex(ack))) {
+				return seqToIndex(ack);
+			}
+			return NSL_UNDEFINED_BUFFER_INDEX;
+		}
+
+		seqNumber HistoryBuffer::getNetworkAck(void)
+		{
+			return (rebasedAckIndex != NSL_UNDEFINED_BUFFER_INDEX && networkAckIndex == rebasedAckIndex ? rebasedAck : indexToSeq(networkAckIndex));
+		}
+
+		void HistoryBuffer::setNetworkAckIndex(int index)
+		{
+			networkAckIndex = index;
+			if (index != rebasedAckIndex) {
+				rebasedAckIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			}
+		}
+
 		bool HistoryBuffer::isSeqInBounds(seqNumber seq)
 		{
 			if (isEmpty()) {
@@ -27,6 +27,10 @@ namespace nsl {
 			seqNumber lastSeq;		// last received seq (stored in networkIndex)
 			int networkIndex;		// last index written by network
 			int networkAckIndex;	// last ack the server knows about
+			int pushedAckIndex;		// index of ack of the last pushed seq
+			seqNumber rebasedAck;	// ack kept by rebase(), its index does not match its seq
+			int rebasedAckIndex;	// NSL_UNDEFINED_BUFFER_INDEX if there is no such ack
+			double timeOffset;		// subtracted from server times, so the time goes on smoothly over rebased buffer
 			int firstDataIndex;		// index of first received seq - it is available only between first packet arrival and rewriting due to cyclic buffer
 			int applicationIndex;	// last index, which application already passed in time (never exceeds networkIndex)
 			int neccessaryIndexBeforeNetworkCount; // number of neccessary (cannot be deleted) indexes before networkIndex (which is neccessary always)
@@ -34,6 +38,18 @@ namespace nsl {
 			double lastUpdateApplicationTime;
 
 			void updateNeccessaryIndexCount(void);
+
+			/// Accept seq, which is too far ahead to be awaited (the server has not been acknowledged for long or the client resumed its session)
+			/// Only the application index and the ack data are kept, the application sees one step from its index to the new seq
+			/// The ack keeps its index, but it is not mapped to its seq anymore, updates based on it are accepted until the server acknowledges a newer seq
+			bool rebase(seqNumber seq, seqNumber ack, int ackIndex, double serverTime, int& firstIndexToClear, int& lastIndexToClear, double applicationTime);
+
+			/// index of data the seq is based on, NSL_UNDEFINED_BUFFER_INDEX if they are not in buffer
+			int findAckIndex(seqNumber ack);
+
+			/// seq of networkAckIndex
+			seqNumber getNetworkAck(void);
+			void setNetworkAckIndex(int index);
 		public:
 			HistoryBuffer(void);
 			~HistoryBuffer(void);
@@ -78,6 +94,7 @@ namespace nsl {
 			/// 1) seq must be awaited or must fill skipped hole after skipped seq
 			/// 2) ack must be present in buffer or eqal to seq
 			/// If new seq was pushed, firstIndexToClear and lastIndexToClear define interval of invalidated indexes
+			/// Seq too far ahead is accepted, if the application index is set, by rebasing the buffer
 			bool pushSeq(seqNumber seq, seqNumber ack, double serverTime, int& firstIndexToClear, int& lastIndexToClear, double applicationTime);
 
 			/// finds next index, which seq data are present in buffer
@@ -130,6 +147,9 @@ namespace nsl {
 			/// If history buffer is empty, NSL_UNDEFINED_BUFFER_INDEX is returned
 			int getLastAckIndex(void);
 
+			/// Get index of ack of the last pushed seq, the data of the seq are based on it
+			int getPushedAckIndex(void) {return pushedAckIndex;}
+
 			/// Get application time when last server packet was received
 			double getLastUpdateApplicationTime(void);
 		};
@@ -19,6 +19,7 @@ namespace nsl {
 			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE; i++) {
 				data[i] = NULL;
 				state[i] = EMPTY;
+				skipped[i] = false;
 			}
 
 			clientObject = new ClientObject(this);
@@ -70,6 +71,7 @@ namespace nsl {
 			this->state[seqIndex] = state;
 			this->birth[seqIndex] = birth;
 			this->death[seqIndex] = death;
+			this->skipped[seqIndex] = false;
 		}
 
 		ObjectSnapshotMeta NetworkObject::getStateBySeqIndex(int seqIndex)
@@ -106,10 +108,18 @@ namespace nsl {
 
 			time = applicationTime;
 
-			// middle point
+			// middle point is the newest real data, skipped seqs only repeat older data
+			int middleIndex = applicationIndex;
+			while (skipped[middleIndex]) {
+				int previousIndex = historyBuffer->getPreviousValidIndex(middleIndex);
+				if (previousIndex == NSL_UNDEFINED_BUFFER_INDEX || data[previousIndex] == NULL) {
+					break;
+				}
+				middleIndex = previousIndex;
+			}
 			interpolationPointsCount = 1;
-			interpolationPoints[NSL_INTERPOLATION_MINIMAL_DATA_COUNT] = data[applicationIndex];
-			pointTimes[NSL_INTERPOLATION_MINIMAL_DATA_COUNT] = historyBuffer->getTime(applicationIndex);
+			interpolationPoints[NSL_INTERPOLATION_MINIMAL_DATA_COUNT] = data[middleIndex];
+			pointTimes[NSL_INTERPOLATION_MINIMAL_DATA_COUNT] = historyBuffer->getTime(middleIndex);
 
 			// forward search
 			int index = applicationIndex;
@@ -117,30 +127,33 @@ namespace nsl {
 			if (index != finalIndex) {
 				index = historyBuffer->getNextValidIndex(index);
 				while (index != NSL_UNDEFINED_BUFFER_INDEX && interpolationPointsCount <= NSL_INTERPOLATION_MINIMAL_DATA_COUNT) {
-					if (data[index] != NULL) {
+					if (data[index] == NULL) {
+						// we cannot to iterate further, because we got after object destruction
+						break;
+					}
+					// skipped seqs are a gap interpolated over
+					if (!skipped[index]) {
 						interpolationPoints[NSL_INTERPOLATION_MINIMAL_DATA_COUNT + interpolationPointsCount] = data[index];
 						pointTimes[NSL_INTERPOLATION_MINIMAL_DATA_COUNT + interpolationPointsCount] = historyBuffer->getTime(index);
 						interpolationPointsCount++;
-					} else {
-						// we cannot to iterate further, because we got after object destruction
-						break;
 					}
 					index = historyBuffer->getNextValidIndex(index);
 				}
 			}
 
 			// backward search
-			index = historyBuffer->getPreviousValidIndex(applicationIndex);
+			index = historyBuffer->getPreviousValidIndex(middleIndex);
 			interpolationPointsOffset = NSL_INTERPOLATION_MINIMAL_DATA_COUNT;
 			while (index != NSL_UNDEFINED_BUFFER_INDEX && interpolationPointsOffset > 0) {
-				if (data[index] != NULL) {
+				if (data[index] == NULL) {
+					// we cannot iterate further, because we got before object creation
+					break;
+				}
+				if (!skipped[index]) {
 					interpolationPointsOffset--;
 					interpolationPointsCount++;
 					interpolationPoints[interpolationPointsOffset] = data[index];
 					pointTimes[interpolationPointsOffset] = historyBuffer->getTime(index);
-				} else {
-					// we cannot iterate further, because we got before object creation
-					break;
 				}
 				index = historyBuffer->getPreviousValidIndex(index);
 			}
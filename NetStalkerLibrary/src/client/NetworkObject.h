@@ -41,6 +41,7 @@ namespace nsl {
 			ObjectSnapshotMeta state[NSL_PACKET_BUFFER_SIZE];
 			bool birth[NSL_PACKET_BUFFER_SIZE];
 			bool death[NSL_PACKET_BUFFER_SIZE];
+			bool skipped[NSL_PACKET_BUFFER_SIZE];		// data are a copy of older data, server did not update the object by relevance
 
 			ClientObject* clientObject;
 			BitStreamReader* creationCustomMessage;
@@ -83,6 +84,8 @@ namespace nsl {
 			bool getBirthBySeqIndex(int seqIndex);
 			bool getDeathBySeqIndex(int seqIndex);
 			void setDataBySeqIndex(int seqIndex, byte* data, ObjectSnapshotMeta state, bool birth = false, bool death = false);
+			/// data of the seq are kept for diffs of later updates, but they are not used as interpolation points
+			void markSkipped(int seqIndex) {skipped[seqIndex] = true;}
 			/// deletes old creation message and sets new one
 			void setCreationCustomMessage(BitStreamReader* reader);
 			BitStreamReader* getCreationCustomMessage(void);
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 namespace nsl {
 	namespace client {
@@ -32,11 +33,10 @@ namespace nsl {
 			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE; i++) {
 				objectsInPacket[i].clear();
 			}
-			for (std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
-				NetworkObject* o = it->second;
-				objects.erase(it);
-				delete o;
+			for (std::vector<NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
+				delete *it;
 			}
+			objects.clear();
 		}
 
 		void ObjectManager::registerObjectClass(ObjectClassDefinition* objectClass)
@@ -47,8 +47,8 @@ namespace nsl {
 		void ObjectManager::applicationUpdate(int firstIndexToProccess, int lastIndexToProccess, Client* userObject, double time)
 		{
 			// iterate trough all objects and set their interpolation points
-			for (std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
-				it->second->findInterpolationPoints(historyBuffer, lastIndexToProccess, time);
+			for (std::vector<NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
+				(*it)->findInterpolationPoints(historyBuffer, lastIndexToProccess, time);
 			}
 
 			if (firstIndexToProccess != NSL_UNDEFINED_BUFFER_INDEX) {
@@ -57,19 +57,20 @@ namespace nsl {
 
 				// iterate trough all valid indexes, which passed before the given time and manage scheduled operations
 				while (true) {
-					for (std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
-						
-						ObjectSnapshotMeta currentState = it->second->getStateBySeqIndex(currentIndex);
-						// if there are no data for this object in this seq, no scheduled operations are about to happen
-						if (currentState == EMPTY) {
-							continue;
-						}
+					for (std::vector<NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
 						
+						ObjectSnapshotMeta currentState = (*it)->getStateBySeqIndex(currentIndex);
 						ObjectSnapshotMeta previousState = (
 							previousIndex == NSL_UNDEFINED_BUFFER_INDEX ? 
 							EMPTY :
-							it->second->getStateBySeqIndex(previousIndex)
+							(*it)->getStateBySeqIndex(previousIndex)
 						);
+
+						// if there are no data for this object in this seq, no scheduled operations are about to happen
+						// unless the seq with its destruction was dropped by rebased history buffer
+						if (currentState == EMPTY && previousState != UPDATED && previousState != CREATED) {
+							continue;
+						}
 						
 						bool create = false;
 						bool destroy = false;
@@ -102,20 +103,20 @@ namespace nsl {
 						}
 
 						if (create) {
-							it->second->beforeApplicationCreate();
+							(*it)->beforeApplicationCreate();
 							userObject->onCreate(
-								it->second->getClientObject(), 
-								it->second->getBirthBySeqIndex(currentIndex), 
-								it->second->getCreationCustomMessage()
+								(*it)->getClientObject(), 
+								(*it)->getBirthBySeqIndex(currentIndex), 
+								(*it)->getCreationCustomMessage()
 							);
 						}
 
 						if (destroy) {
 							userObject->onDestroy(
-								it->second->getClientObject(), 
-								it->second->getDeathBySeqIndex(currentIndex)
+								(*it)->getClientObject(), 
+								(*it)->getDeathBySeqIndex(currentIndex)
 							);
-							it->second->afterApplicationDestroy();
+							(*it)->afterApplicationDestroy();
 						}
 					}
 
@@ -123,8 +124,8 @@ namespace nsl {
 						break;
 					}
 
-					previousIndex = firstIndexToProccess;
-					firstIndexToProccess = historyBuffer->getNextValidIndex(firstIndexToProccess);
+					previousIndex = currentIndex;
+					currentIndex = firstIndexToProccess = historyBuffer->getNextValidIndex(firstIndexToProccess);
 				}				
 			}
 		}
@@ -135,9 +136,9 @@ namespace nsl {
 			objectsInPacket[bufferIndex].clear();
 
 			// objects in packet cannot be used, because during deletion in packet data are received but object is not added into packet
-			for (std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
+			for (std::vector<NetworkObject*>::iterator it = objectsBegin(); it != objectsEnd(); it++) {
 
-				NetworkObject* o = it->second;
+				NetworkObject* o = *it;
 				byte* data = o->getDataBySeqIndex(bufferIndex);
 
 				if (data != NULL) {
@@ -151,14 +152,14 @@ namespace nsl {
 		{
 			int firstNeccessaryIndex = historyBuffer->getFirstNeccessaryIndex();
 
-			std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin();
-			while (it != objectsEnd()) {
+			unsigned int position = 0;
+			while (position < objects.getSize()) {
 
 				bool notUseful = false;
 				int currentIndex = historyBuffer->getLastSeqIndex();
 
 				do {
-					ObjectSnapshotMeta state = it->second->getStateBySeqIndex(currentIndex);
+					ObjectSnapshotMeta state = objects.getValue(position)->getStateBySeqIndex(currentIndex);
 					if (state != EMPTY) {
 						notUseful = false;
 						break;
@@ -167,11 +168,11 @@ namespace nsl {
 				} while(currentIndex != firstNeccessaryIndex);
 
 				if (notUseful) {
-					NetworkObject* o = it->second;
-					objects.erase(it++);
+					NetworkObject* o = objects.getValue(position);
+					objects.eraseAt(position);
 					delete o;
 				} else {
-					++it;
+					++position;
 				}
 			}
 		}
@@ -185,18 +186,13 @@ namespace nsl {
 
 			NetworkObject* o = new NetworkObject(it->second, this, id);
 
-			objects.insert(std::pair<unsigned int,NetworkObject*>(o->getId(),o));
+			objects.insert(id, o);
 			return o;
 		} 
 
 		NetworkObject* ObjectManager::findObjectById(unsigned int objectId)
 		{
-			std::map<unsigned int, NetworkObject*>::iterator it = objects.find(objectId);
-			if (it == objects.end()) {
-				return NULL;
-			} else {
-				return it->second;
-			}
+			return objects.find(objectId);
 		}
 
 		void ObjectManager::addObjectToPacket(int bufferIndex, NetworkObject* object)
@@ -204,5 +200,16 @@ namespace nsl {
 			objectsInPacket[bufferIndex].push_back(object);
 		}
 
+		static bool compareObjectIds(NetworkObject* first, NetworkObject* second)
+		{
+			return getSlotMapIndex(first->getId()) < getSlotMapIndex(second->getId());
+		}
+
+		void ObjectManager::mergeObjectsInPacket(int bufferIndex, unsigned int updatedCount)
+		{
+			std::vector<NetworkObject*>& packetObjects = objectsInPacket[bufferIndex];
+			std::inplace_merge(packetObjects.begin(), packetObjects.begin() + updatedCount, packetObjects.end(), compareObjectIds);
+		}
+
 	};
 };
@@ -17,6 +17,7 @@ namespace nsl {
 };
 
 #include "../configuration.h"
+#include "../SlotMap.h"
 #include <vector>
 #include <map>
 #include <iterator>
@@ -28,7 +29,7 @@ namespace nsl {
 		{
 		private:
 			HistoryBuffer* historyBuffer;
-			std::map<unsigned int,NetworkObject*> objects;
+			SlotMap<NetworkObject*> objects;
 			std::map<unsigned short, ObjectClassDefinition*> objectClasses;
 			std::vector<NetworkObject*> objectsInPacket[NSL_PACKET_BUFFER_SIZE];
 		public:
@@ -53,8 +54,9 @@ namespace nsl {
 			/// create new object with no data
 			NetworkObject* createObject(unsigned short classId, unsigned int id);
 
-			const std::map<unsigned int,NetworkObject*>::iterator objectsBegin(void) {return objects.begin();}
-			const std::map<unsigned int,NetworkObject*>::iterator objectsEnd(void) {return objects.end();}
+			/// all objects, in no particular order
+			const std::vector<NetworkObject*>::iterator objectsBegin(void) {return objects.begin();}
+			const std::vector<NetworkObject*>::iterator objectsEnd(void) {return objects.end();}
 
 			/// if no object is found, NULL is returned
 			NetworkObject* findObjectById(unsigned int objectId);
@@ -62,6 +64,11 @@ namespace nsl {
 			const std::vector<NetworkObject*>::iterator objectsInPacketBegin(int bufferIndex) {return objectsInPacket[bufferIndex].begin();}
 			const std::vector<NetworkObject*>::iterator objectsInPacketEnd(int bufferIndex) {return objectsInPacket[bufferIndex].end();}
 			void addObjectToPacket(int bufferIndex, NetworkObject* object);
+			unsigned int getObjectsInPacketCount(int bufferIndex) {return objectsInPacket[bufferIndex].size();}
+
+			/// order objects in packet by slot index of id, the same way as server orders peer scope
+			/// the first updatedCount objects and the rest (created objects) must be already ordered
+			void mergeObjectsInPacket(int bufferIndex, unsigned int updatedCount);
 		};
 	};
 };
@@ -9,6 +9,8 @@
 #include "ObjectManager.h"
 #include "CustomMessageBuffer.h"
 #include "../ObjectClassDefinition.h"
+#include "../delta/delta.h"
+#include <string.h>
 
 namespace nsl {
 	namespace client {
@@ -59,7 +61,7 @@ namespace nsl {
 			customMessageBuffer->updateAck(stream->read<Attribute<seqNumber> >());
 
 			int seqIndex = historyBuffer->seqToIndex(seq);
-			int ackIndex = historyBuffer->seqToIndex(ack);
+			int ackIndex = historyBuffer->getPushedAckIndex();
 
 
 			////////////////////// object modification part ////////////////////////
@@ -77,12 +79,8 @@ namespace nsl {
 
 				switch(flags.action) {
 				case NSL_OBJECT_FLAG_ACTION_DIFF:
-					// standard object delivery, undo diff and store data
-					newData = extractObjectData(objectClass, stream);
-
-					for (unsigned int i = 0; i < objectClass->getByteSize(); i++) {
-						newData[i] ^= ackData[i];
-					}
+					// standard object delivery, undo diff of changed attributes and store data
+					newData = extractChangedObjectData(objectClass, stream, ackData);
 
 					objectManager->addObjectToPacket(seqIndex, object);
 					object->setDataBySeqIndex(seqIndex, newData, UPDATED);
@@ -90,11 +88,7 @@ namespace nsl {
 
 				case NSL_OBJECT_FLAG_ACTION_DELETE:
 					// object was destroyed
-					newData = extractObjectData(objectClass, stream);
-
-					for (unsigned int i = 0; i < objectClass->getByteSize(); i++) {
-						newData[i] ^= ackData[i];
-					}
+					newData = extractChangedObjectData(objectClass, stream, ackData);
 					
 					if (flags.scopeDestroy == NSL_OBJECT_FLAG_SD_HIDE) {
 						object->setDataBySeqIndex(seqIndex, newData, DESTROYED, false, true);
@@ -110,22 +104,28 @@ namespace nsl {
 					objectManager->addObjectToPacket(seqIndex, object);
 					object->setDataBySeqIndex(seqIndex, newData, UPDATED);
 					break;
-				/*
+
 				case NSL_OBJECT_FLAG_ACTION_NO_CHANGE:
-					// no change occured, just copy ack data to the current destination
+				case NSL_OBJECT_FLAG_ACTION_SKIP:
+					// no change occured (or it was not sent), just copy ack data to the current destination
 					newData = new byte[objectClass->getByteSize()];
 					memcpy(newData, ackData, objectClass->getByteSize());
 
-					objectManager.addObjectToPacket(seqIndex, object);
+					objectManager->addObjectToPacket(seqIndex, object);
 					object->setDataBySeqIndex(seqIndex, newData, UPDATED);
+					if (flags.action == NSL_OBJECT_FLAG_ACTION_SKIP) {
+						object->markSkipped(seqIndex);
+					}
 					break;
-					*/
 				}
 				
 			}	// end of object iteration
 
 
 			////////////////////// object creation part ////////////////////////
+
+			// objects updated and created by this packet are both ordered by slot index of id
+			unsigned int updatedCount = objectManager->getObjectsInPacketCount(seqIndex);
 			
 			while (true) {
 				ObjectFlags flags;
@@ -174,6 +174,7 @@ namespace nsl {
 					o->setCreationCustomMessage(creationReader);
 				}
 			}
+			objectManager->mergeObjectsInPacket(seqIndex, updatedCount);
 
 
 			////////////////////// custom messages part ////////////////////////
@@ -192,6 +193,31 @@ namespace nsl {
 			return data;
 		}
 
+		byte* ProtocolParser::extractChangedObjectData(ObjectClassDefinition* objectClass, BitStreamReader* stream, byte* ackData)
+		{
+			unsigned int maskSize = objectClass->getAttributeMaskByteSize();
+			mask.resize(maskSize);
+			for (unsigned int i = 0; i < maskSize; i++) {
+				mask[i] = stream->readByte();
+			}
+
+			// unchanged attributes stay the same as in ack data
+			byte* data = new byte[objectClass->getByteSize()];
+			memcpy(data, ackData, objectClass->getByteSize());
+
+			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+				if ((mask[i / 8] & (1 << (i % 8))) == 0) {
+					continue;
+				}
+				int size = objectClass->getAttributeDefinition(i)->size;
+				int offset = objectClass->getDataOffset(i);
+				stream->read(size, data+offset);
+				xorDeltaInPlace(data+offset, ackData+offset, size);
+			}
+
+			return data;
+		}
+
 		void ProtocolParser::extractObjectFromStream(NetworkObject*& o, BitStreamReader* stream, int seqIndex, unsigned short classId, unsigned int objectId, ObjectSnapshotMeta snapshotMeta, bool birth, bool death) 
 		{
 			byte* data;
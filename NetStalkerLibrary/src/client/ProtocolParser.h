@@ -19,6 +19,7 @@ namespace nsl {
 
 #include <map>
 #include <set>
+#include <vector>
 #include "../configuration.h"
 #include "NetworkObject.h"
 
@@ -30,6 +31,7 @@ namespace nsl {
 			HistoryBuffer* historyBuffer;
 			ObjectManager* objectManager;
 			CustomMessageBuffer* customMessageBuffer;
+			std::vector<byte> mask;		// changed attribute mask of the object being read, reused so decoding does not allocate
 		public:
 			ProtocolParser(HistoryBuffer* historyBuffer, ObjectManager* objectManager, CustomMessageBuffer* customMessageBuffer);
 			~ProtocolParser(void);
@@ -45,6 +47,9 @@ namespace nsl {
 			void extractObjectFromStream(NetworkObject*& o, BitStreamReader* stream, int seqIndex, unsigned short classId, unsigned int objectId, ObjectSnapshotMeta snapshotMeta, bool birth, bool death);
 
 			byte* extractObjectData(ObjectClassDefinition* objectClass, BitStreamReader* stream);
+
+			/// Read changed attribute mask and XORed data of changed attributes, undo the diff against ackData
+			byte* extractChangedObjectData(ObjectClassDefinition* objectClass, BitStreamReader* stream, byte* ackData);
 		};
 	};
 };
\ No newline at end of file
@@ -38,7 +38,9 @@ namespace nsl {
 			return 0;
 		}
 #else
-		return LZ4_decompress_safe((const char *)src, (char *)dest, srclen, destlen);
+		// negative result means failure (too small destination as well)
+		int resultSize = LZ4_decompress_safe((const char *)src, (char *)dest, srclen, destlen);
+		return resultSize < 0 ? 0 : resultSize;
 #endif
 	}
 };
@@ -23,6 +23,24 @@ namespace nsl {
 	/* server configuration */
 
 	#define NSL_PACKET_BUFFER_SIZE_SERVER 50
+	#define NSL_FLUSH_PEERS_PER_JOB 4		// number of peers, whose updates are encoded and sent by one job of parallel flushNetwork()
+	#define NSL_SNAPSHOT_ARENA_PAGE_SLOTS 64	// number of objects of one class in one page of history data, page is shared by history indexes until it is changed
+	#define NSL_SNAPSHOT_ARENA_WRITE_LOCKS 16	// number of locks of pages in one class, objects set from more threads wait only for objects on pages with the same lock
+	#define NSL_RECLAIM_OBJECTS_PER_TICK 256	// minimal number of expired objects deleted in one updateNetwork(), the rest waits for following ticks
+	#define NSL_DIFF_CACHE_LOCK_COUNT 64	// number of locks guarding shared encoded object records during parallel flushNetwork()
+	#define NSL_SCOPE_GRID_CELL_SIZE 64.0	// default edge length of spatial grid cells used for scope of peers with a view
+	#define NSL_PEER_BYTE_BUDGET 0			// default maximal size of one peer update (before compression), 0 means unlimited
+	#define NSL_PEER_BUDGET_CUSTOM_MESSAGE_SHARE 0.25	// part of peer byte budget reserved for custom messages
+	#define NSL_PEER_CREATION_BYTES 4096	// maximal size of creation records in one peer update, joining peers get the world over more updates (nearest objects first), 0 means unlimited
+	#define NSL_PEER_SEND_INTERVAL 1		// default number of flushes between updates of one peer, 0 means adapted automatically
+	#define NSL_PEER_MAX_SEND_INTERVAL 16	// limit of automatic send interval, acks of throttled peers must stay in history (less than NSL_PACKET_BUFFER_SIZE_SERVER / 2)
+	#define NSL_PEER_MAX_QUEUE_DELAY 4		// acks later by more flushes than the shortest recent round trip make automatic send interval double, acks in half of it make it decrease by one
+	#define NSL_PEER_ROUND_TRIP_WINDOW 64	// number of acks after which the shortest round trip of a peer is measured again
+	#define NSL_PEER_BUDGET_MAX_SKIPPED_UPDATES 10	// objects not sent in this many updates of the peer are sent regardless of budget and relevance, objects whose data would leave history before the next update is acknowledged as well
+	#define NSL_MAX_UPDATE_PERIOD 8			// irrelevant objects are updated at least in every n-th update of the peer (power of two, lower than NSL_PEER_BUDGET_MAX_SKIPPED_UPDATES, throttled peers get them sooner if n updates do not fit in history)
+	#define NSL_RELEVANCE_FULL_RATE_DISTANCE 0.25	// objects closer than this part of view radius have relevance 1, relevance of farther ones falls with distance
+	#define NSL_KEYFRAME_INTERVAL 100		// every peer gets absolute values of objects instead of diffs once per this many of its updates (peers are staggered), 0 disables it
+	#define NSL_KEYFRAME_ACK_AGE 20			// peer whose last ack is older than this many of its updates gets absolute values as well
 
 	/* client configuration */
 
@@ -47,22 +65,34 @@ namespace nsl {
 
 	#define NSL_MAX_UDP_PACKET_SIZE 64000	// size of buffers for packet receiving and sending, do not set bigger then 64000
 	#define NSL_INITIAL_MAX_PACKET_SIZE 2000	// initial size of buffers for packet parsing, this will dynamically increase as needed
+	#define NSL_MAX_DECOMPRESSED_PACKET_SIZE (NSL_MAX_UDP_PACKET_SIZE * 255)	// buffer for decompressed updates does not grow above this (worst ratio of LZ4), bigger updates are malformed and dropped
+	#define NSL_DEFAULT_MTU 1200				// maximal size of sent UDP payload, bigger updates are split into fragments
+	#define NSL_MIN_MTU 300						// MTU must be big enough to send NSL_MAX_UDP_PACKET_SIZE in 255 fragments
+	#define NSL_MAX_MTU 9000
+	#define NSL_SLOT_MAP_INDEX_BITS 20			// object ids consist of slot index (lower bits) and slot generation, this limits count of live objects
 
 
 	/* inner constans (do not change) */
 
 	#define NSL_UNDEFINED_BUFFER_INDEX -1
+	#define NSL_SLOT_MAP_FREE 0xFFFFFFFF
 
 	#define NSL_CONNECTION_FLAG_DISCONNECT 1
-	#define NSL_CONNECTION_FLAG_HANDSHAKE 2
+	#define NSL_CONNECTION_FLAG_HANDSHAKE 2		// handshake of the client and replies to its request (followed by nonce) and to its handshake (followed by connection id and resume token)
 	#define NSL_CONNECTION_FLAG_UPDATE 3
 	#define NSL_CONNECTION_FLAG_COMPRESSED_UPDATE 4
+	#define NSL_CONNECTION_FLAG_FRAGMENT 5
+	#define NSL_CONNECTION_FLAG_RESUME 6		// handshake of a session, which continues under its old connection id (followed by resume token)
+	#define NSL_FRAGMENT_HEADER_SIZE 13		// connection header, flag, fragmented packet id, fragment index and count, packet size
 
 	#define NSL_TIMEOUT_CLIENT_CONNECTION_REQUEST 0.5
 	#define NSL_TIMEOUT_CLIENT_HANDSHAKE 0.5
-	#define NSL_TIMEOUT_SERVER_HANDSHAKE_RESEND 0.5
-	#define NSL_TIMEOUT_SERVER_HANDSHAKE_KILL 5
+	#define NSL_TIMEOUT_SERVER_HANDSHAKE 5		// handshake cookie is accepted for at least this long and at most twice as long
 	#define NSL_TIMEOUT_SERVER_CONNECTED_KILL 5
+	#define NSL_TIMEOUT_SERVER_RESUME 10		// timed out peer is kept this long, so the client can resume its session, 0 disconnects it at once
+	#define NSL_TIMER_WHEEL_RESOLUTION 0.01	// seconds covered by one slot of the lowest level of timer wheel
+	#define NSL_TIMER_WHEEL_SLOT_BITS 6	// every level of timer wheel has 2^bits slots
+	#define NSL_TIMER_WHEEL_LEVELS 4	// timers further than resolution * 2^(bits*levels) seconds are postponed to the end of the wheel
 
 	#define NSL_OBJECT_FLAG_ACTION_DIFF 0
 	#define NSL_OBJECT_FLAG_ACTION_END_OF_SECTION 1
@@ -70,6 +100,8 @@ namespace nsl {
 	#define NSL_OBJECT_FLAG_ACTION_DELETE 3
 	#define NSL_OBJECT_FLAG_ACTION_CREATE 4
 	#define NSL_OBJECT_FLAG_ACTION_CREATE_AND_DELETE 5
+	#define NSL_OBJECT_FLAG_ACTION_NO_CHANGE 6
+	#define NSL_OBJECT_FLAG_ACTION_SKIP 7		// changed object is not updated by relevance, client keeps its data but does not interpolate to them
 
 	#define NSL_OBJECT_FLAG_SC_BIRTH 0
 	#define NSL_OBJECT_FLAG_SC_SHOW 1
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "delta.h"
+
+#if !defined(NSL_DISABLE_SIMD)
+	#if defined(__AVX2__)
+		#define NSL_DELTA_AVX2
+		#include <immintrin.h>
+	#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define NSL_DELTA_SSE2
+		#include <emmintrin.h>
+	#endif
+#endif
+
+namespace nsl {
+
+	void xorDelta(byte* dest, const byte* first, const byte* second, unsigned int size)
+	{
+		unsigned int i = 0;
+
+#if defined(NSL_DELTA_AVX2)
+		for (; i + 32 <= size; i += 32) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(first + i));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(second + i));
+			_mm256_storeu_si256((__m256i*)(dest + i), _mm256_xor_si256(a, b));
+		}
+#endif
+#if defined(NSL_DELTA_AVX2) || defined(NSL_DELTA_SSE2)
+		for (; i + 16 <= size; i += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(first + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(second + i));
+			_mm_storeu_si128((__m128i*)(dest + i), _mm_xor_si128(a, b));
+		}
+#endif
+
+		// objects are usually small, so the tail is done by 4 bytes at once
+		for (; i + 4 <= size; i += 4) {
+			dest[i] = first[i] ^ second[i];
+			dest[i+1] = first[i+1] ^ second[i+1];
+			dest[i+2] = first[i+2] ^ second[i+2];
+			dest[i+3] = first[i+3] ^ second[i+3];
+		}
+		for (; i < size; i++) {
+			dest[i] = first[i] ^ second[i];
+		}
+	}
+
+	void xorDeltaInPlace(byte* data, const byte* delta, unsigned int size)
+	{
+		xorDelta(data, data, delta, size);
+	}
+
+	bool isZeroDelta(const byte* delta, unsigned int size)
+	{
+		byte result = 0;
+		for (unsigned int i = 0; i < size; i++) {
+			result |= delta[i];
+		}
+		return result == 0;
+	}
+
+	const char* getDeltaKernelName(void)
+	{
+#if defined(NSL_DELTA_AVX2)
+		return "avx2";
+#elif defined(NSL_DELTA_SSE2)
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+};
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+#include "../configuration.h"
+
+namespace nsl {
+	// XOR delta kernels, vectorized by SSE2 or AVX2 if the compiler targets them
+	// buffers can be unaligned and of any size
+
+	// dest = first ^ second
+	// dest can be the same buffer as first or second
+	void xorDelta(byte* dest, const byte* first, const byte* second, unsigned int size);
+
+	// data ^= delta
+	void xorDeltaInPlace(byte* data, const byte* delta, unsigned int size);
+
+	// is every byte of delta zero (no change between compared data)?
+	bool isZeroDelta(const byte* delta, unsigned int size);
+
+	// return name of the kernel chosen at compile time ("avx2", "sse2" or "scalar")
+	const char* getDeltaKernelName(void);
+};
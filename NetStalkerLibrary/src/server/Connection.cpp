@@ -6,6 +6,9 @@
 
 #include "Connection.h"
 #include "../../include/nslBitStream.h"
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
 
 namespace nsl {
 	namespace server {
@@ -23,9 +26,9 @@ namespace nsl {
 			delete stream;
 		}
 
-		void Packet::send(void) 
+		void Packet::send(byte* compressBuffer) 
 		{
-			connection->send(this);
+			connection->send(this, compressBuffer);
 		}
 		
 		BitStreamWriter* Packet::getStream(void) 
@@ -37,12 +40,36 @@ namespace nsl {
 
 		/* Connection */
 
+		static void generateKey(byte* key)
+		{
+			unsigned int filled = 0;
+#ifndef NSL_PLATFORM_WINDOWS
+			FILE* random = fopen("/dev/urandom", "rb");
+			if (random != NULL) {
+				filled = fread(key, 1, NSL_SIPHASH_KEY_SIZE, random);
+				fclose(random);
+			}
+#endif
+			if (filled < NSL_SIPHASH_KEY_SIZE) {
+				// no system source of randomness, mix what differs between runs
+				double seed[5] = {getTime(), (double)clock(), (double)time(NULL), (double)rand(), (double)(size_t)key};
+				byte seedKey[NSL_SIPHASH_KEY_SIZE];
+				memset(seedKey, 0, NSL_SIPHASH_KEY_SIZE);
+				for (unsigned int i = 0; i < NSL_SIPHASH_KEY_SIZE; i += 8) {
+					seedKey[0] = (byte)i;
+					uint64_t value = sipHash(seedKey, (byte*)seed, sizeof(seed));
+					memcpy(key + i, &value, 8);
+				}
+			}
+		}
+
 		Connection::Connection(unsigned short applicationId) 
 			: applicationId(applicationId), serverPort(serverPort)
 		{
 			state = CLOSED;
-			timeoutIteratorValid = false;
-			lastConnectionId = 0;
+			timeoutsValid = false;
+			mtu = NSL_DEFAULT_MTU;
+			connectionCounter = 0;
 		}
 
 		Connection::~Connection(void)
@@ -58,6 +85,10 @@ namespace nsl {
 			// try start accepting connections
 			socket.open(port);
 
+			// cookies of the previous session are not accepted
+			generateKey(cookieKey);
+			handshakes.clear();
+
 			state = OPENED;
 		}
 
@@ -72,7 +103,7 @@ namespace nsl {
 				throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: trying to update connection when server is not connected.");
 			}
 
-			timeoutIteratorValid = false;
+			timeoutsValid = false;
 
 			Address sender;
 			unsigned int size;
@@ -89,14 +120,31 @@ namespace nsl {
 					continue;
 				}
 
-				int connectionId = stream->read<uint32>();
+				unsigned int connectionId = stream->read<uint32>();
 				
-				// new connection
+				// new connection, nothing is stored until the client proves it receives packets sent to its address
+				// client resends the request if the cookie gets lost
 				if (connectionId == 0) {
-					peer = new PeerConnection(++lastConnectionId, sender);
-					peer->lastResponse = time;
-					handshakingPeers.insert(std::pair<unsigned int, PeerConnection*>(lastConnectionId, peer));
-					sendHandshake(sender, lastConnectionId);
+					if (size >= 10) {
+						unsigned int nonce = stream->read<uint32>();
+						sendCookie(sender, createCookie(sender, (unsigned int)floor(time / NSL_TIMEOUT_SERVER_HANDSHAKE), nonce), nonce);
+					}
+					delete stream;
+					continue;
+				}
+
+				if (size < 7) {
+					delete stream;
+					continue;
+				}
+				byte flag = stream->read<uint8>();
+
+				// handshake carries the cookie instead of connection id
+				if (flag == NSL_CONNECTION_FLAG_HANDSHAKE) {
+					if (size >= 11 && acceptHandshake(peer, sender, connectionId, stream->read<uint32>(), time)) {
+						data = stream;
+						return PEER_CONNECT;
+					}
 					delete stream;
 					continue;
 				}
@@ -105,18 +153,16 @@ namespace nsl {
 				std::map<unsigned int, PeerConnection*>::iterator it = connectedPeers.find(connectionId);
 				if (it == connectedPeers.end()) {
 
-					// try handshaking peers
-					it = handshakingPeers.find(connectionId);
-					if (it != handshakingPeers.end()) {
-
+					// suspended session can be continued by its resume token only
+					it = suspendedPeers.find(connectionId);
+					if (it != suspendedPeers.end() && size >= 15 && flag == NSL_CONNECTION_FLAG_RESUME && stream->read<uint64>() == createResumeToken(connectionId)) {
 						peer = it->second;
-						handshakingPeers.erase(connectionId);
-						connectedPeers.insert(std::pair<unsigned int, PeerConnection*>(connectionId, peer));
-						peer->lastResponse = time;
+						peer->resumeAddress = sender;
 						data = stream;
-						return PEER_CONNECT;
+						return PEER_RESUME;
 					}
 
+					// client, which missed the disconnect, is told again
 					sendDisconnect(sender, connectionId);
 					delete stream;
 					continue;
@@ -124,32 +170,37 @@ namespace nsl {
 
 				peer = it->second;
 
-				if (size >= 7) {
-					byte flag = stream->read<uint8>();
-					switch (flag) {
-					case NSL_CONNECTION_FLAG_DISCONNECT:
-						sendDisconnect(sender, connectionId);
-						connectedPeers.erase(connectionId);
-						data = stream;
-						peer->lastResponse = time;
-						return PEER_DISCONNECT;
-					case NSL_CONNECTION_FLAG_UPDATE:
+				switch (flag) {
+				case NSL_CONNECTION_FLAG_DISCONNECT:
+					sendDisconnect(sender, connectionId);
+					peersLock.lock();
+					connectedPeers.erase(connectionId);
+					peersLock.unlock();
+					timeouts.cancel(&peer->timeout);
+					data = stream;
+					peer->lastResponse = time;
+					return PEER_DISCONNECT;
+				case NSL_CONNECTION_FLAG_UPDATE:
+					data = stream;
+					peer->lastResponse = time;
+					return PEER_UPDATE;
+				case NSL_CONNECTION_FLAG_RESUME:
+					// client lost the connection before the server noticed it (or it changed its address)
+					if (size >= 15 && stream->read<uint64>() == createResumeToken(connectionId)) {
+						peer->resumeAddress = sender;
 						data = stream;
-						peer->lastResponse = time;
-						return PEER_UPDATE;
-					case NSL_CONNECTION_FLAG_HANDSHAKE:
-						delete stream;
-						continue;
-					default:
-						delete stream;
-						throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: protocol error, unknown flag arrived");
+						return PEER_RESUME;
 					}
+					delete stream;
+					continue;
+				default:
+					delete stream;
+					throw Exception(NSL_EXCEPTION_LIBRARY_ERROR, "NSL: protocol error, unknown flag arrived");
 				}
 			}
 
-			timeoutIteratorValid = true;
-			timeoutIteratorHandshaking = true;
-			timeoutIterator = handshakingPeers.begin();
+			timeouts.advance(time);
+			timeoutsValid = true;
 			return EMPTY;
 		}
 
@@ -157,9 +208,6 @@ namespace nsl {
 		{
 			if (state == OPENED) {
 				state = CLOSED;
-				for (std::map<unsigned int, PeerConnection*>::iterator it = handshakingPeers.begin(); it != handshakingPeers.end(); it++) {
-					sendDisconnect(it->second->connectedAddress, it->second->connectionId);
-				}
 				for (std::map<unsigned int, PeerConnection*>::iterator it = connectedPeers.begin(); it != connectedPeers.end(); it++) {
 					sendDisconnect(it->second->connectedAddress, it->second->connectionId);
 				}
@@ -169,51 +217,65 @@ namespace nsl {
 		void Connection::disconnect(PeerConnection* peer) 
 		{
 			sendDisconnect(peer->connectedAddress, peer->connectionId);
-			connectedPeers.erase(peer->connectionId);
-			delete peer;
+			if (peer->suspended) {
+				suspendedPeers.erase(peer->connectionId);
+			} else {
+				peersLock.lock();
+				connectedPeers.erase(peer->connectionId);
+				peersLock.unlock();
+			}
+			timeouts.cancel(&peer->timeout);
+		}
+
+		void Connection::resume(PeerConnection* peer, double time)
+		{
+			peer->connectedAddress = peer->resumeAddress;
+			peer->lastResponse = time;
+			if (peer->suspended) {
+				peer->suspended = false;
+				suspendedPeers.erase(peer->connectionId);
+				peersLock.lock();
+				connectedPeers.insert(std::pair<unsigned int, PeerConnection*>(peer->connectionId, peer));
+				peersLock.unlock();
+				timeouts.cancel(&peer->timeout);
+				timeouts.schedule(&peer->timeout, time + NSL_TIMEOUT_SERVER_CONNECTED_KILL);
+			}
 		}
 
 		PeerConnection* Connection::proccessTimeouts(double time)
 		{
-			if (!timeoutIteratorValid) {
+			if (!timeoutsValid) {
 				return NULL;
 			}
-			
-			PeerConnection* peer;
-
-			if (timeoutIteratorHandshaking) {
 
-				while(timeoutIterator != handshakingPeers.end()) {
-					peer = timeoutIterator->second;
-					if (peer->lastResponse + NSL_TIMEOUT_SERVER_HANDSHAKE_KILL < time) {
-						sendDisconnect(peer->connectedAddress, peer->connectionId);
-						handshakingPeers.erase(timeoutIterator++);
-						return peer;
-					}
-					if (peer->lastResponse + NSL_TIMEOUT_SERVER_HANDSHAKE_RESEND < time) {
-						sendHandshake(timeoutIterator->second->connectedAddress, timeoutIterator->second->connectionId);
-					}
-					timeoutIterator++;
+			// responses only move lastResponse, the timer is moved when it expires
+			Timer* timer;
+			while (NULL != (timer = timeouts.popExpired())) {
+				PeerConnection* peer = (PeerConnection*)timer->owner;
+				if (peer->suspended) {
+					// nobody resumed the session
+					suspendedPeers.erase(peer->connectionId);
+					return peer;
 				}
-
-				timeoutIterator = connectedPeers.begin();
-				timeoutIteratorHandshaking = false;
-			}
-
-			if (!timeoutIteratorHandshaking) {
-
-				while(timeoutIterator != connectedPeers.end()) {
-					peer = timeoutIterator->second;
-					if (peer->lastResponse + NSL_TIMEOUT_SERVER_CONNECTED_KILL < time) {
-						sendDisconnect(peer->connectedAddress, peer->connectionId);
-						connectedPeers.erase(timeoutIterator++);
+				if (peer->lastResponse + NSL_TIMEOUT_SERVER_CONNECTED_KILL < time) {
+					sendDisconnect(peer->connectedAddress, peer->connectionId);
+					peersLock.lock();
+					connectedPeers.erase(peer->connectionId);
+					peersLock.unlock();
+					if (NSL_TIMEOUT_SERVER_RESUME <= 0) {
 						return peer;
 					}
-					timeoutIterator++;
+
+					// the peer keeps its state, so its client can resume the session
+					peer->suspended = true;
+					suspendedPeers.insert(std::pair<unsigned int, PeerConnection*>(peer->connectionId, peer));
+					timeouts.schedule(timer, time + NSL_TIMEOUT_SERVER_RESUME);
+					continue;
 				}
+				timeouts.schedule(timer, peer->lastResponse + NSL_TIMEOUT_SERVER_CONNECTED_KILL);
 			}
 
-			timeoutIteratorValid = false;
+			timeoutsValid = false;
 			return NULL;
 		}
 
@@ -232,18 +294,25 @@ namespace nsl {
 			return new Packet(this, stream, peer);
 		}
 
-		void Connection::send(Packet* packet)
+		void Connection::send(Packet* packet, byte* compressBuffer)
 		{
 			if (state != OPENED)
 			{
 				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to send packet when server is not connected.");
 			}
 
-			if (connectedPeers.find(packet->peer->connectionId) == connectedPeers.end()) {
-				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to send packet to not connected peer.");
+			peersLock.lock();
+			bool connected = connectedPeers.find(packet->peer->connectionId) != connectedPeers.end();
+			peersLock.unlock();
+			if (!connected) {
+				// with network thread, peer may be disconnected by the game thread while its update is sent, the update is dropped then
+				return;
 			}
 
 #ifdef NSL_COMPRESS
+			if (compressBuffer == NULL) {
+				compressBuffer = this->compressBuffer;
+			}
 			unsigned int streamByteSize = packet->stream->getByteSize();
 			
 			unsigned int bytesAfterCompression = compress(packet->stream->buffer + 7, compressBuffer + 7, streamByteSize - 7, NSL_MAX_UDP_PACKET_SIZE-7);
@@ -259,21 +328,77 @@ namespace nsl {
 				// send compressed update
 				memcpy(compressBuffer, packet->stream->buffer, 6);
 				compressBuffer[6] = NSL_CONNECTION_FLAG_COMPRESSED_UPDATE;
-				send(
-					packet->peer->connectedAddress, 
+				sendUpdate(
+					packet->peer, 
 					compressBuffer, 
 					bytesAfterCompression + 7
 				);
 			/*}*/
 #else
-			send(
-				packet->peer->connectedAddress, 
+			sendUpdate(
+				packet->peer, 
 				packet->stream->buffer, 
 				packet->stream->currentByte - packet->stream->buffer
 			);
 #endif
 		}
 
+		void Connection::sendUpdate(PeerConnection* peer, byte* data, unsigned int dataSize)
+		{
+			if (dataSize <= mtu) {
+				send(peer->connectedAddress, data, dataSize);
+				MutexGuard guard(statsLock);
+				stats.packetCount++;
+				return;
+			}
+
+			if (dataSize > NSL_MAX_UDP_PACKET_SIZE) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to send too much data, maximum UDP packet limits reached");
+			}
+
+			// everything behind connection header (update flag and data) is split evenly, so the client can find places of fragments
+			byte* packet = data + 6;
+			unsigned int packetSize = dataSize - 6;
+			unsigned int maxFragmentSize = mtu - NSL_FRAGMENT_HEADER_SIZE;
+			unsigned int fragmentCount = (packetSize + maxFragmentSize - 1) / maxFragmentSize;
+			unsigned int fragmentSize = (packetSize + fragmentCount - 1) / fragmentCount;
+			unsigned short packetId = ++peer->fragmentedPacketId;
+
+			byte fragment[NSL_MAX_MTU];
+			memcpy(fragment, data, 6);
+			fragment[6] = NSL_CONNECTION_FLAG_FRAGMENT;
+			for (unsigned int i = 0; i < fragmentCount; i++) {
+				unsigned int offset = i * fragmentSize;
+				unsigned int size = (packetSize - offset < fragmentSize ? packetSize - offset : fragmentSize);
+				BitStreamWriter header(fragment + 7, NSL_FRAGMENT_HEADER_SIZE - 7);
+				header.write<uint16>(packetId);
+				header.writeByte((byte)i);
+				header.writeByte((byte)fragmentCount);
+				header.write<uint16>(packetSize);
+				memcpy(fragment + NSL_FRAGMENT_HEADER_SIZE, packet + offset, size);
+				send(peer->connectedAddress, fragment, NSL_FRAGMENT_HEADER_SIZE + size);
+			}
+
+			MutexGuard guard(statsLock);
+			stats.packetCount++;
+			stats.fragmentedPacketCount++;
+			stats.fragmentCount += fragmentCount;
+		}
+
+		void Connection::setMtu(unsigned int mtu)
+		{
+			if (mtu < NSL_MIN_MTU || mtu > NSL_MAX_MTU) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: MTU out of supported range");
+			}
+			this->mtu = mtu;
+		}
+
+		FragmentationStats Connection::getFragmentationStats(void)
+		{
+			MutexGuard guard(statsLock);
+			return stats;
+		}
+
 		void Connection::send(Address& address, byte* data, unsigned int dataSize)
 		{
 			if (dataSize > NSL_MAX_UDP_PACKET_SIZE) {
@@ -286,21 +411,135 @@ namespace nsl {
 			);
 		}
 
-		void Connection::sendHandshake(Address& address, unsigned int connectionId)
+		void Connection::sendCookie(Address& address, unsigned int cookie, unsigned int nonce)
 		{
-			BitStreamWriter* stream = new BitStreamWriter(6);
-			stream->write<uint16>(applicationId);
-			stream->write<uint32>(connectionId);
-			socket.send(address, stream->buffer, 6);
+			BitStreamWriter stream(11);
+			stream.write<uint16>(applicationId);
+			stream.write<uint32>(cookie);
+			stream.write<uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
+			stream.write<uint32>(nonce);
+			socket.send(address, stream.buffer, 11);
+		}
+
+		void Connection::sendHandshake(Address& address, unsigned int cookie, unsigned int connectionId)
+		{
+			BitStreamWriter stream(19);
+			stream.write<uint16>(applicationId);
+			stream.write<uint32>(cookie);
+			stream.write<uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
+			stream.write<uint32>(connectionId);
+			stream.write<uint64>(createResumeToken(connectionId));
+			socket.send(address, stream.buffer, 19);
+		}
+
+		unsigned int Connection::createCookie(Address& address, unsigned int timeBucket, unsigned int nonce)
+		{
+			// only the port and host of IPv4 address are hashed, the rest of the structure is padding
+			byte data[8 + sizeof(sockaddr_storage)];
+			unsigned int size;
+			memcpy(data, &timeBucket, 4);
+			memcpy(data + 4, &nonce, 4);
+			if (address.address.ss_family == AF_INET) {
+				sockaddr_in* ipv4 = (sockaddr_in*)&address.address;
+				memcpy(data + 8, &ipv4->sin_port, sizeof(ipv4->sin_port));
+				memcpy(data + 8 + sizeof(ipv4->sin_port), &ipv4->sin_addr, sizeof(ipv4->sin_addr));
+				size = 8 + sizeof(ipv4->sin_port) + sizeof(ipv4->sin_addr);
+			} else {
+				memcpy(data + 8, &address.address, address.length);
+				size = 8 + address.length;
+			}
+
+			unsigned int cookie = (unsigned int)sipHash(cookieKey, data, size);
+
+			// zero is a connection request
+			return cookie == 0 ? 1 : cookie;
+		}
+
+		bool Connection::isCookieValid(Address& address, unsigned int cookie, unsigned int nonce, unsigned int timeBucket)
+		{
+			// cookie from the previous time bucket is accepted as well, so every cookie lives at least one bucket
+			return cookie == createCookie(address, timeBucket, nonce) || cookie == createCookie(address, timeBucket - 1, nonce);
+		}
+
+		bool Connection::acceptHandshake(PeerConnection*& peer, Address& address, unsigned int cookie, unsigned int nonce, double time)
+		{
+			unsigned int timeBucket = (unsigned int)floor(time / NSL_TIMEOUT_SERVER_HANDSHAKE);
+			if (!isCookieValid(address, cookie, nonce, timeBucket)) {
+				sendDisconnect(address, cookie);
+				return false;
+			}
+
+			// used cookies are remembered only while they are valid
+			std::map<unsigned int, Handshake>::iterator it = handshakes.begin();
+			while (it != handshakes.end()) {
+				if (it->second.timeBucket + 1 < timeBucket) {
+					handshakes.erase(it++);
+				} else {
+					it++;
+				}
+			}
+
+			// the client did not get the reply, or the handshake is a late copy
+			it = handshakes.find(cookie);
+			if (it != handshakes.end() && it->second.nonce == nonce) {
+				peersLock.lock();
+				bool connected = connectedPeers.find(it->second.connectionId) != connectedPeers.end();
+				peersLock.unlock();
+				if (connected) {
+					sendHandshake(address, cookie, it->second.connectionId);
+				} else {
+					// session, which ended already, is not created again
+					sendDisconnect(address, cookie);
+				}
+				return false;
+			}
+
+			peer = new PeerConnection(createConnectionId(), address);
+			peer->lastResponse = time;
+			peersLock.lock();
+			connectedPeers.insert(std::pair<unsigned int, PeerConnection*>(peer->connectionId, peer));
+			peersLock.unlock();
+			timeouts.schedule(&peer->timeout, time + NSL_TIMEOUT_SERVER_CONNECTED_KILL);
+
+			Handshake handshake;
+			handshake.nonce = nonce;
+			handshake.connectionId = peer->connectionId;
+			handshake.timeBucket = timeBucket;
+			handshakes[cookie] = handshake;
+			sendHandshake(address, cookie, peer->connectionId);
+			return true;
+		}
+
+		unsigned int Connection::createConnectionId(void)
+		{
+			// ids are not predictable, so other clients cannot guess them, and unique among living sessions
+			unsigned int connectionId;
+			do {
+				byte data[5];
+				memcpy(data, &connectionCounter, 4);
+				data[4] = NSL_CONNECTION_FLAG_HANDSHAKE;
+				connectionCounter++;
+				connectionId = (unsigned int)sipHash(cookieKey, data, 5);
+			} while (connectionId == 0 || connectedPeers.find(connectionId) != connectedPeers.end() || suspendedPeers.find(connectionId) != suspendedPeers.end());
+			return connectionId;
+		}
+
+		uint64_t Connection::createResumeToken(unsigned int connectionId)
+		{
+			// trailing flag keeps tokens apart from cookies hashed by the same key
+			byte data[5];
+			memcpy(data, &connectionId, 4);
+			data[4] = NSL_CONNECTION_FLAG_RESUME;
+			return sipHash(cookieKey, data, 5);
 		}
 
 		void Connection::sendDisconnect(Address& address, unsigned int connectionId)
 		{
-			BitStreamWriter* stream = new BitStreamWriter(7);
-			stream->write<uint16>(applicationId);
-			stream->write<uint32>(connectionId);
-			stream->write<uint8>(NSL_CONNECTION_FLAG_DISCONNECT);
-			socket.send(address, stream->buffer, 7);
+			BitStreamWriter stream(7);
+			stream.write<uint16>(applicationId);
+			stream.write<uint32>(connectionId);
+			stream.write<uint8>(NSL_CONNECTION_FLAG_DISCONNECT);
+			socket.send(address, stream.buffer, 7);
 		}
 
 	};
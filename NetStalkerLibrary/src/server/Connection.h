@@ -13,6 +13,9 @@ namespace nsl {
 
 #include "../configuration.h"
 #include "../Socket.h"
+#include "../Thread.h"
+#include "../TimerWheel.h"
+#include "../SipHash.h"
 #ifdef NSL_COMPRESS
 #include "../compression/compression.h"
 #endif
@@ -26,7 +29,7 @@ namespace nsl {
 		};
 
 		enum UpdateCode {
-			EMPTY, PEER_CONNECT, PEER_DISCONNECT, PEER_UPDATE
+			EMPTY, PEER_CONNECT, PEER_DISCONNECT, PEER_UPDATE, PEER_RESUME
 		};
 
 		struct PeerConnection 
@@ -34,13 +37,25 @@ namespace nsl {
 			unsigned int connectionId;
 			Address connectedAddress;
 			double lastResponse;
+			unsigned short fragmentedPacketId;		// id of the last update sent in fragments
+			Timer timeout;		// next check of the peer timeout, lastResponse is compared only when it expires
+			bool suspended;		// timed out peer waiting for its client to resume the session, no updates are sent to it
+			Address resumeAddress;	// address of the client asking to resume the session, see Connection::resume
 			PeerConnection(unsigned int connectionId, Address& address)
-				: connectionId(connectionId), connectedAddress(address) {}
+				: connectionId(connectionId), connectedAddress(address), fragmentedPacketId(0), timeout(this), suspended(false) {}
 		};
 
 
 		class Connection;
 
+		/// Accepted handshake, remembered while its cookie is valid
+		struct Handshake
+		{
+			unsigned int nonce;
+			unsigned int connectionId;
+			unsigned int timeBucket;
+		};
+
 
 		class Packet
 		{
@@ -53,7 +68,9 @@ namespace nsl {
 
 			Packet(Connection* connection, BitStreamWriter* stream, PeerConnection* peer);
 		public:
-			void send(void);
+			/// compressBuffer of NSL_MAX_UDP_PACKET_SIZE bytes is used for packet compression
+			/// if it is NULL, shared buffer of the connection is used, so packets cannot be sent from more threads at once
+			void send(byte* compressBuffer = NULL);
 			BitStreamWriter* getStream(void);
 			~Packet(void);
 		};
@@ -73,16 +90,40 @@ namespace nsl {
 #endif
 			ConnectionState state;
 			std::map<unsigned int,PeerConnection*> connectedPeers;
-			std::map<unsigned int,PeerConnection*> handshakingPeers;
-			unsigned int lastConnectionId;
-			std::map<unsigned int, PeerConnection*>::iterator timeoutIterator;
-			bool timeoutIteratorHandshaking;
-			bool timeoutIteratorValid;
-
-			void send(Packet* packet);
+			std::map<unsigned int,PeerConnection*> suspendedPeers;	// timed out peers, which can be resumed
+			byte cookieKey[NSL_SIPHASH_KEY_SIZE];		// secret of handshake cookies, generated on every open
+			std::map<unsigned int,Handshake> handshakes;	// accepted handshakes by their cookies, so resent or replayed ones do not create peers again
+			unsigned int connectionCounter;				// number of allocated connection ids, see createConnectionId
+			TimerWheel timeouts;
+			bool timeoutsValid;
+			unsigned int mtu;
+			FragmentationStats stats;
+			Mutex statsLock;		// packets are sent from more threads during parallel flush
+			Mutex peersLock;		// peers are looked up by the network thread while they are changed by update
+
+			void send(Packet* packet, byte* compressBuffer);
+			/// Send update, split it into fragments if it does not fit into MTU
+			void sendUpdate(PeerConnection* peer, byte* data, unsigned int dataSize);
 			/// Send custom data and check data max size
 			void send(Address& address, byte* data, unsigned int dataSize);
-			void sendHandshake(Address& address, unsigned int connectionId);
+			/// reply to connection request, the client sends the cookie back in its handshake
+			void sendCookie(Address& address, unsigned int cookie, unsigned int nonce);
+			/// reply to accepted handshake with the connection id and resume token of the new peer
+			void sendHandshake(Address& address, unsigned int cookie, unsigned int connectionId);
+
+			/// handshake cookie is a keyed hash of the client address, time and nonce of the request (new for every connection of the client)
+			/// server keeps no state of handshaking clients, it only checks the cookie the client sends back
+			unsigned int createCookie(Address& address, unsigned int timeBucket, unsigned int nonce);
+			bool isCookieValid(Address& address, unsigned int cookie, unsigned int nonce, unsigned int timeBucket);
+			/// create the peer for handshake with a valid cookie, return false if the cookie is not valid or it was used already
+			/// handshake accepted before is answered again while its peer is connected
+			bool acceptHandshake(PeerConnection*& peer, Address& address, unsigned int cookie, unsigned int nonce, double time);
+			/// unique id of a new peer, it is not derived from the cookie, so it does not collide with ids of other sessions
+			unsigned int createConnectionId(void);
+
+			/// resume token proves that the client got the connection id from the server, it is a keyed hash of the id
+			/// the client receives it with its cookie and sends it back when it resumes the session
+			uint64_t createResumeToken(unsigned int connectionId);
 			void sendDisconnect(Address& address, unsigned int connectionId);
 		public:
 			Connection(unsigned short applicationId);
@@ -95,23 +136,33 @@ namespace nsl {
 
 			/// proccesses incoming packets
 			/// connection requests are handled automaticcaly
-			/// after succesful handshake, delete or update, this function returs the peer and payload packet data
+			/// after succesful handshake, delete, update or resume request, this function returs the peer and payload packet data
 			/// id EMPTY code is returned, no more packet are pending
 			UpdateCode update(PeerConnection*& peer, BitStreamReader*& data, double time);
 
-			/// if some peer timeouts for a long time, it is disconnected (and returned)
+			/// if some peer timeouts for a long time, it is suspended for NSL_TIMEOUT_SERVER_RESUME seconds
+			/// if it is not resumed meanwhile, it is disconnected (and returned)
 			/// callable only after update(...) returned EMPTY (otherwise nothing happens and NULL is returned)
 			/// if NULL is returned after update(...) returned EMPTY, all timeouts have been already checked and solved
-			/// if handshaking client timeouts just for a while, handshake is resent
+			/// only peers with expired timers are checked, so the cost does not grow with the number of connected peers
 			PeerConnection* proccessTimeouts(double time);
 
+			/// continue the session of peer, which asked for it by a valid resume token (PEER_RESUME was returned by update)
+			/// the peer is addressed by the address of the request from now on
+			void resume(PeerConnection* peer, double time);
+
 			/// send disconnect packet to peer and closes its connection
+			/// peer connection is not deleted, it still belongs to the server peer
 			void disconnect(PeerConnection* peer);
 
 			/// disconnect all peers and close connection
 			void close(void);
 
 			Packet* createPacket(PeerConnection* peer);
+
+			/// maximal size of sent UDP payload, updates above it are fragmented
+			void setMtu(unsigned int mtu);
+			FragmentationStats getFragmentationStats(void);
 		};
 	};
 };
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "DiffCache.h"
+#include "ProtocolParser.h"
+#include "NetworkObject.h"
+#include "../ObjectClassDefinition.h"
+#include "../../include/nslBitStream.h"
+
+namespace nsl {
+	namespace server {
+
+		/* DiffCacheEntry */
+
+		DiffCacheEntry::DiffCacheEntry(void)
+		{
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				diffTick[i] = 0;
+				diff[i] = NULL;
+				diffSize[i] = 0;
+			}
+			creationTick = 0;
+			creation = NULL;
+			creationSize = 0;
+			creationBufferSize = 0;
+		}
+
+		DiffCacheEntry::~DiffCacheEntry(void)
+		{
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				if (diff[i] != NULL) delete[] diff[i];
+			}
+			if (creation != NULL) {
+				delete[] creation;
+			}
+		}
+
+
+		/* DiffCache */
+
+		DiffCache::DiffCache(ProtocolParser* protocolParser) : protocolParser(protocolParser)
+		{
+			// entries start with tick 0, so nothing is valid at the beginning
+			tick = 1;
+		}
+
+		DiffCache::~DiffCache(void)
+		{
+		}
+
+		Mutex& DiffCache::getLock(NetworkObject* object)
+		{
+			return locks[object->getId() % NSL_DIFF_CACHE_LOCK_COUNT];
+		}
+
+		DiffCacheEntry* DiffCache::getEntry(NetworkObject* object)
+		{
+			DiffCacheEntry* entry = object->getDiffCacheEntry();
+			if (entry == NULL) {
+				entry = new DiffCacheEntry();
+				object->setDiffCacheEntry(entry);
+			}
+			return entry;
+		}
+
+		void DiffCache::invalidate(void)
+		{
+			if (++tick == 0) {
+				// wrapped around, old ticks could become valid again
+				// it takes years of updates, so do not bother with anything smarter
+				tick = 1;
+			}
+		}
+
+		void DiffCache::getDiff(NetworkObject* object, int baseIndex, byte*& diff, unsigned int& diffSize)
+		{
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			MutexGuard guard(getLock(object));
+			DiffCacheEntry* entry = getEntry(object);
+			if (entry->diff[baseIndex] == NULL) {
+				entry->diff[baseIndex] = new byte[objectClass->getAttributeMaskByteSize() + objectClass->getByteSize()];
+			}
+
+			if (entry->diffTick[baseIndex] != tick) {
+				entry->diffSize[baseIndex] = protocolParser->encodeDiffData(entry->diff[baseIndex], object, baseIndex);
+				entry->diffTick[baseIndex] = tick;
+			}
+
+			// record is not touched again until next invalidation
+			diff = entry->diff[baseIndex];
+			diffSize = entry->diffSize[baseIndex];
+		}
+
+		void DiffCache::writeDiff(BitStreamWriter* stream, NetworkObject* object, int baseIndex, ObjectFlags flags)
+		{
+			byte* diff;
+			unsigned int diffSize;
+			getDiff(object, baseIndex, diff, diffSize);
+
+			// empty mask means no attribute changed, plain diff does not need any data then
+			if (flags.action == NSL_OBJECT_FLAG_ACTION_DIFF && diffSize == object->getObjectClass()->getAttributeMaskByteSize()) {
+				flags.action = NSL_OBJECT_FLAG_ACTION_NO_CHANGE;
+				*stream << flags;
+				return;
+			}
+
+			*stream << flags;
+			stream->writeRaw(diffSize, diff);
+		}
+
+		unsigned int DiffCache::getDiffByteSize(NetworkObject* object, int baseIndex, ObjectFlags flags)
+		{
+			byte* diff;
+			unsigned int diffSize;
+			getDiff(object, baseIndex, diff, diffSize);
+
+			if (flags.action == NSL_OBJECT_FLAG_ACTION_DIFF && diffSize == object->getObjectClass()->getAttributeMaskByteSize()) {
+				return 1;
+			}
+			return 1 + diffSize;
+		}
+
+		void DiffCache::writeCreation(BitStreamWriter* stream, NetworkObject* object)
+		{
+			byte* creation;
+			unsigned int creationSize;
+			{
+				MutexGuard guard(getLock(object));
+				DiffCacheEntry* entry = getEntry(object);
+
+				if (entry->creationTick != tick) {
+					unsigned int size = protocolParser->getCreationRecordByteSize(object);
+					if (entry->creationBufferSize < size) {
+						if (entry->creation != NULL) {
+							delete[] entry->creation;
+						}
+						entry->creation = new byte[size];
+						entry->creationBufferSize = size;
+					}
+
+					BitStreamWriter creationStream(entry->creation, size);
+					protocolParser->writeCreationRecord(&creationStream, object);
+					entry->creationSize = size;
+					entry->creationTick = tick;
+				}
+
+				creation = entry->creation;
+				creationSize = entry->creationSize;
+			}
+
+			stream->writeRaw(creationSize, creation);
+		}
+	};
+};
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+namespace nsl {
+	class BitStreamWriter;
+
+	namespace server {
+		class NetworkObject;
+		class ProtocolParser;
+	};
+};
+
+#include "../configuration.h"
+#include "../Thread.h"
+
+namespace nsl {
+	namespace server {
+
+		/// Encoded records of one object, every record is valid only in the tick it was encoded in
+		struct DiffCacheEntry
+		{
+			unsigned int diffTick[NSL_PACKET_BUFFER_SIZE_SERVER];
+			byte* diff[NSL_PACKET_BUFFER_SIZE_SERVER];		// changed attribute mask and XORed data of changed attributes
+			unsigned int diffSize[NSL_PACKET_BUFFER_SIZE_SERVER];
+			unsigned int creationTick;
+			byte* creation;									// whole creation record
+			unsigned int creationSize;
+			unsigned int creationBufferSize;
+
+			DiffCacheEntry(void);
+			~DiffCacheEntry(void);
+		};
+
+		/// Cache of encoded object records shared by all peer updates of one flushNetwork().
+		/// Every distinct (object, ackIndex) diff and every creation record is encoded only once
+		/// and then copied into the stream of each peer which needs it.
+		/// Can be used from more threads at once.
+		class DiffCache
+		{
+		private:
+			ProtocolParser* protocolParser;
+			unsigned int tick;
+			Mutex locks[NSL_DIFF_CACHE_LOCK_COUNT];
+
+			/// get lock guarding records of given object
+			Mutex& getLock(NetworkObject* object);
+
+			/// get records of given object, create them if they do not exist yet
+			/// lock of the object must be held
+			DiffCacheEntry* getEntry(NetworkObject* object);
+
+			/// get diff record of object against data at given index, encode it if it is not cached yet
+			void getDiff(NetworkObject* object, int baseIndex, byte*& diff, unsigned int& diffSize);
+		public:
+			DiffCache(ProtocolParser* protocolParser);
+			~DiffCache(void);
+
+			/// throw away all cached records
+			/// must be called whenever object data of current seq might have changed
+			void invalidate(void);
+
+			/// write flags and object data XORed with its data at baseIndex
+			/// if nothing changed since baseIndex, DIFF action is replaced by NO_CHANGE and no data are written
+			void writeDiff(BitStreamWriter* stream, NetworkObject* object, int baseIndex, ObjectFlags flags);
+
+			/// get byte size of record written by writeDiff, including flags
+			unsigned int getDiffByteSize(NetworkObject* object, int baseIndex, ObjectFlags flags);
+
+			/// write whole creation record of object
+			void writeCreation(BitStreamWriter* stream, NetworkObject* object);
+		};
+	};
+};
@@ -18,6 +18,10 @@ namespace nsl {
 			currentSeq = 0;
 			currentIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			validUpdatesCounter = 0;
+			reservedIndexCount = 0;
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				tickData[i] = -1;
+			}
 		}
 
 		HistoryBuffer::~HistoryBuffer(void)
@@ -40,16 +44,30 @@ namespace nsl {
 				int prevIndex = currentIndex;
 				currentSeq = (currentSeq + 1) % NSL_SEQ_MODULO;
 				currentIndex = (currentIndex + 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
+
+				// seq, which was stored in the index before
+				// peers keep its scope and data before objects destroyed in it are reclaimed and the data are cleared
+				seqNumber clearedSeq = (currentSeq - NSL_PACKET_BUFFER_SIZE_SERVER + NSL_SEQ_MODULO) % NSL_SEQ_MODULO;
+				for(std::map<unsigned int, Peer*>::iterator it = peers->begin(); it != peers->end(); it++) {
+					Peer* peer = it->second;
+					if (peer->hasAck() && peer->getLastAck() == clearedSeq) {
+						peer->retainScope(currentIndex);
+					}
+				}
 				objectManager->clearBufferIndex(currentIndex, prevIndex);
+
 				for(std::map<unsigned int, Peer*>::iterator it = peers->begin(); it != peers->end(); it++) {
-					it->second->clearIndex(currentIndex);
+					Peer* peer = it->second;
+					peer->clearIndex(currentIndex, peer->hasAck() && !isSecondSeqGreater(peer->getLastAck(), clearedSeq));
 				}
 			} else {
 				// if this is first update, set currentIndex to 0 (data are already cleared)
 				currentIndex = 0;
 			}
 			timeData[currentIndex] = time;
+			tickData[currentIndex] = validUpdatesCounter;
 			validUpdatesCounter++;
+			objectManager->applyDeferredAttributes();
 		}
 
 		int HistoryBuffer::getCurrentSeqIndex(void)
@@ -69,8 +87,26 @@ namespace nsl {
 				return seq <= validUpdatesCounter;
 			} else {
 				// whole buffer is full now, so every seq smaller than currentSeq by less than buffer size is in bounds
-				return ((currentSeq - seq + NSL_SEQ_MODULO) % NSL_SEQ_MODULO) < NSL_PACKET_BUFFER_SIZE;
+				return ((currentSeq - seq + NSL_SEQ_MODULO) % NSL_SEQ_MODULO) < (int)(NSL_PACKET_BUFFER_SIZE - reservedIndexCount);
+			}
+		}
+
+		bool HistoryBuffer::isIndexInBounds(int bufferIndex)
+		{
+			if (bufferIndex == NSL_UNDEFINED_BUFFER_INDEX || currentIndex == NSL_UNDEFINED_BUFFER_INDEX) {
+				return false;
+			}
+			int oldestIndex = getOldestIndex();
+			return (bufferIndex - oldestIndex + NSL_PACKET_BUFFER_SIZE) % NSL_PACKET_BUFFER_SIZE <= (currentIndex - oldestIndex + NSL_PACKET_BUFFER_SIZE) % NSL_PACKET_BUFFER_SIZE;
+		}
+
+		int HistoryBuffer::getOldestIndex(void)
+		{
+			if (validUpdatesCounter < NSL_PACKET_BUFFER_SIZE_SERVER) {
+				// buffer is not full yet, indexes are filled from zero
+				return 0;
 			}
+			return (currentIndex + 1 + reservedIndexCount) % NSL_PACKET_BUFFER_SIZE_SERVER;
 		}
 
 		bool HistoryBuffer::isSecondSeqGreater(seqNumber first, seqNumber second)
@@ -25,9 +25,11 @@ namespace nsl {
 		{
 		private:
 			double timeData[NSL_PACKET_BUFFER_SIZE];
+			long tickData[NSL_PACKET_BUFFER_SIZE_SERVER];	// value of validUpdatesCounter when the index was written, -1 if never
 			seqNumber currentSeq;		// current seq (stored in currentIndex)
 			int currentIndex;			// current index, updates are written in here
 			long validUpdatesCounter;
+			unsigned int reservedIndexCount;	// the oldest indexes, which are treated as out of bounds
 		public:
 			HistoryBuffer(void);
 			~HistoryBuffer(void);
@@ -46,13 +48,37 @@ namespace nsl {
 			/// Is there index in history buffer for this seq?
 			bool isSeqInBounds(seqNumber);
 
+			/// Is the index one of the valid indexes from the oldest to the current one?
+			bool isIndexInBounds(int bufferIndex);
+
+			/// Get the oldest index, which is in bounds
+			int getOldestIndex(void);
+
+			/// Treat given number of the oldest indexes as out of bounds
+			/// Copy of the buffer used by the network thread reserves the index, which the game thread is going to clear meanwhile
+			void setReservedIndexCount(unsigned int count) {reservedIndexCount = count;}
+
 			/// Get time for given index
 			/// if the given index is not valid (there are no data in buffer on this index), result is undefined
 			double getTime(int);
 
+			/// Get number of the update stored in given index, counted from the first update without modulo
+			/// Objects compare it with the update of their last change to find out whether the index holds their current data
+			long getTick(int bufferIndex) {return tickData[bufferIndex];}
+
+			/// Number of the current update
+			long getCurrentTick(void) {return validUpdatesCounter - 1;}
+
+			/// Number of the update with given seq, which may be out of history already
+			/// seq must not be older than NSL_SEQ_MODULO updates
+			long getSeqTick(seqNumber seq) {return getCurrentTick() - (currentSeq - seq + NSL_SEQ_MODULO) % NSL_SEQ_MODULO;}
+
 			/// Add next seq to buffer
 			/// Previous values in that buffer index are deleted (using object manager)
-			/// Old index will be cleared in object manager and in peers
+			/// Old index will be cleared in object manager and in peers (peers are told whether they acknowledged it)
+			/// Peer, whose ack is leaving the history, retains its scope first
+			/// Tick of the old index is still available while the object manager clears it
+			/// Values held back by update groups of objects are written into the new index
 			void addSeq(double, ObjectManager*, std::map<unsigned int, Peer*>*);
 			
 			/// seq comparator using modulo
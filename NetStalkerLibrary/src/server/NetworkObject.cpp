@@ -6,37 +6,69 @@
 
 #include "NetworkObject.h"
 #include "HistoryBuffer.h"
+#include "ObjectManager.h"
+#include "DiffCache.h"
+#include "SnapshotArena.h"
 #include "../ObjectClassDefinition.h"
 #include "../../include/nslServer.h"
+#include <algorithm>
 
 namespace nsl {
 	namespace server {
 		NetworkObject::NetworkObject(
 			ObjectClassDefinition* objectClass, 
+			SnapshotArena* arena,
 			HistoryBuffer* historyBuffer, 
-			unsigned int id)
-			: historyBuffer(historyBuffer), objectClass(objectClass), id(id)
+			ObjectManager* objectManager,
+			unsigned int id,
+			SpatialGrid* spatialGrid)
+			: historyBuffer(historyBuffer), objectManager(objectManager), objectClass(objectClass), arena(arena), id(id), spatialGrid(spatialGrid)
 		{
-			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE; i++) {
-				data[i] = NULL;
-			}
-
 			int currentIndex = historyBuffer->getCurrentSeqIndex();
 			if (currentIndex == NSL_UNDEFINED_BUFFER_INDEX) {
 				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: creating new object before updating network");
 			}
-			data[currentIndex] = new byte[objectClass->getByteSize()];
+			slot = arena->allocateSlot(currentIndex);
 
 			serverObject = new ServerObject(this);
 			destroyIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			creationIndex = historyBuffer->getCurrentSeqIndex();
 			creationCustomMessage = NULL;
+			diffCacheEntry = NULL;
+			priority = 1;
+
+			// new object has to be copied into following indexes, even if its data are never set
+			changeTick = historyBuffer->getCurrentTick();
+			attributeChangeTicks.assign(objectClass->getAttributeCount(), changeTick);
+			creationTick = changeTick;
+
+			// encoding does not see the object before it gets into some scope, so it starts published
+			publishedChangeTick = changeTick;
+			publishedAttributeChangeTicks = attributeChangeTicks;
+			publishedPriority = priority;
+			publishedDestroyIndex = destroyIndex;
+			changePending = false;
+
+			deferred = false;
+			deferredData = NULL;
+			pinCount = 0;
+			if (objectClass->hasDeferredGroups()) {
+				deferredData = new byte[objectClass->getByteSize()];
+				deferredAttributes.assign(objectClass->getAttributeCount(), false);
+			}
+
+			// object gets its cell when the grid is updated
+			if (spatialGrid != NULL) {
+				spatialGrid->markMoved(this);
+			}
 		}
 
 		NetworkObject::~NetworkObject(void)
 		{
-			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE; i++) {
-				if (data[i] != NULL) delete[] data[i];
+			arena->releaseSlot(slot);
+
+			if (spatialGrid != NULL) {
+				spatialGrid->remove(this);
 			}
 
 			if (serverObject != NULL) {
@@ -46,6 +78,14 @@ namespace nsl {
 			if (creationCustomMessage != NULL) {
 				delete creationCustomMessage;
 			}
+
+			if (diffCacheEntry != NULL) {
+				delete diffCacheEntry;
+			}
+
+			if (deferredData != NULL) {
+				delete[] deferredData;
+			}
 		}
 
 		unsigned int NetworkObject::getId(void)
@@ -62,6 +102,12 @@ namespace nsl {
 		{
 			if (destroyIndex == NSL_UNDEFINED_BUFFER_INDEX) {
 				destroyIndex = historyBuffer->getCurrentSeqIndex();
+
+				// object is taken out of the spatial grid by the manager
+				objectManager->onObjectDestroyed(this, destroyIndex);
+				if (!holdChange()) {
+					publishedDestroyIndex = destroyIndex;
+				}
 			}
 		}
 
@@ -87,21 +133,128 @@ namespace nsl {
 
 		void NetworkObject::set(unsigned int attrId, unsigned int byteSize, byte* value)
 		{
-			memcpy(
-				data[historyBuffer->getCurrentSeqIndex()] + objectClass->getDataOffset(attrId),
-				value,
-				byteSize
-			);
+			// slow groups keep the last value until their tick, so history and diffs change only then
+			if (deferredData != NULL) {
+				if (!isGroupDue(objectClass->getAttributeGroup(attrId))) {
+					memcpy(deferredData + objectClass->getDataOffset(attrId), value, byteSize);
+					deferredAttributes[attrId] = true;
+					if (!deferred) {
+						deferred = true;
+						objectManager->onObjectDeferred(this);
+					}
+					return;
+				}
+				deferredAttributes[attrId] = false;
+			}
+
+			int currentIndex = historyBuffer->getCurrentSeqIndex();
+
+			// in concurrent mode, objects sharing a page wait for each other, because copy on write replaces the page
+			Mutex* lock = arena->getWriteLock(slot);
+			if (lock != NULL) {
+				lock->lock();
+			}
+
+			// most objects are set the same values again and again, they stay clean then
+			// and their history pages stay shared
+			bool changed = memcmp(arena->getAttribute(currentIndex, slot, attrId), value, byteSize) != 0;
+			if (changed) {
+				memcpy(arena->getWritableAttribute(currentIndex, slot, attrId), value, byteSize);
+			}
+
+			if (lock != NULL) {
+				lock->unlock();
+			}
+			if (!changed) {
+				return;
+			}
+			changeTick = attributeChangeTicks[attrId] = historyBuffer->getCurrentTick();
+			if (!holdChange()) {
+				publishedChangeTick = publishedAttributeChangeTicks[attrId] = changeTick;
+			}
+
+			if (spatialGrid != NULL && objectClass->isPositionAttribute(attrId)) {
+				spatialGrid->markMoved(this);
+			}
+		}
+
+		void NetworkObject::setPriority(double priority)
+		{
+			this->priority = priority;
+			if (!holdChange()) {
+				publishedPriority = priority;
+			}
+		}
+
+		bool NetworkObject::holdChange(void)
+		{
+			if (!objectManager->isHoldingChanges()) {
+				return false;
+			}
+			if (!changePending) {
+				changePending = true;
+				objectManager->onObjectChanged(this);
+			}
+			return true;
+		}
+
+		void NetworkObject::publishChanges(void)
+		{
+			publishedChangeTick = changeTick;
+			publishedAttributeChangeTicks = attributeChangeTicks;
+			publishedPriority = priority;
+			publishedDestroyIndex = destroyIndex;
+			changePending = false;
+		}
+
+		bool NetworkObject::isGroupDue(unsigned int groupId)
+		{
+			// initial values are written at once, ticks of objects are shifted by their ids, so the group is not sent for all of them together
+			unsigned int period = objectClass->getGroup(groupId).period;
+			long tick = historyBuffer->getCurrentTick();
+			return period == 1 || tick == creationTick || (tick + id) % period == 0;
+		}
+
+		bool NetworkObject::applyDeferredAttributes(void)
+		{
+			bool waiting = false;
+			for (unsigned int i = 0; i < deferredAttributes.size(); i++) {
+				if (!deferredAttributes[i]) {
+					continue;
+				}
+				if (isGroupDue(objectClass->getAttributeGroup(i))) {
+					set(i, objectClass->getAttributeDefinition(i)->size, deferredData + objectClass->getDataOffset(i));
+				} else {
+					waiting = true;
+				}
+			}
+			deferred = waiting;
+			return waiting;
+		}
+
+		double NetworkObject::getChangePriority(int bufferIndex)
+		{
+			if (objectClass->getGroupCount() == 1) {
+				return objectClass->getGroup(0).priority;
+			}
+
+			double result = 0;
+			for (unsigned int i = 0; i < publishedAttributeChangeTicks.size(); i++) {
+				if (isAttributeChangedSince(i, bufferIndex)) {
+					result = std::max(result, objectClass->getGroup(objectClass->getAttributeGroup(i)).priority);
+				}
+			}
+			return result;
 		}
 
-		byte* NetworkObject::getDataBySeqIndex(short seqIndex)
+		bool NetworkObject::isChangedSince(int bufferIndex)
 		{
-			return data[seqIndex];
+			return publishedChangeTick > historyBuffer->getTick(bufferIndex);
 		}
 
-		void NetworkObject::setDataBySeqIndex(short seqIndex, byte* data)
+		bool NetworkObject::isAttributeChangedSince(unsigned int attrId, int bufferIndex)
 		{
-			this->data[seqIndex] = data;
+			return publishedAttributeChangeTicks[attrId] > historyBuffer->getTick(bufferIndex);
 		}
 
 		bool NetworkObject::getCreationCustomMessage(byte*& data, unsigned int& size)
@@ -13,10 +13,16 @@ namespace nsl {
 	namespace server {
 		class ObjectManager;
 		class HistoryBuffer;
+		class SnapshotArena;
+		class SpatialGrid;
+		struct DiffCacheEntry;
 	};
 };
 
 #include "../configuration.h"
+#include "../SlotMap.h"
+#include "SpatialGrid.h"
+#include <vector>
 
 namespace nsl {
 	namespace server {
@@ -25,19 +31,46 @@ namespace nsl {
 		{
 		private:
 			HistoryBuffer* historyBuffer;				// pointer to class, that handles objects
+			ObjectManager* objectManager;				// owner of the object, deletes it when its data leave history
 			ObjectClassDefinition* objectClass;			// definition of data field types
-			byte* data[NSL_PACKET_BUFFER_SIZE_SERVER];	// data for every seq of object existence
+			SnapshotArena* arena;						// data for every seq of object existence
+			unsigned int slot;							// position of object data in arena blocks
 			int destroyIndex;
 			int creationIndex;
 			unsigned int id;
 			ServerObject* serverObject;
 			byte* creationCustomMessage;
 			unsigned int creationCustomMessageSize;
+			DiffCacheEntry* diffCacheEntry;				// encoded records shared by peer updates, owned by the object
+			SpatialGrid* spatialGrid;					// grid computing scope of peers with a view, NULL if not used
+			SpatialGridEntry spatialGridEntry;
+			double priority;							// weight of object when peer update does not fit into byte budget
+			long changeTick;							// the last update, in which data of object changed (see HistoryBuffer::getTick)
+			std::vector<long> attributeChangeTicks;		// the last update, in which given attribute changed
+			long publishedChangeTick;					// values read by encoding of updates, see ObjectManager::setHoldingChanges
+			std::vector<long> publishedAttributeChangeTicks;
+			double publishedPriority;
+			int publishedDestroyIndex;
+			bool changePending;							// is the object queued in the manager to publish its changes?
+			long creationTick;
+			byte* deferredData;							// values of attributes held back until their update group is due, NULL if the class has no such group
+			std::vector<char> deferredAttributes;		// attributes with value waiting in deferredData
+			bool deferred;								// is the object queued in the manager to write deferred values?
+			unsigned int pinCount;						// number of peers retaining the object for session resume, see Peer::retainScope
+
+			/// are changes of attributes in given group written into the current index?
+			bool isGroupDue(unsigned int groupId);
+
+			/// should the change be held back from encoding of updates? the object is queued in the manager then
+			bool holdChange(void);
 		public:
 			NetworkObject(
 				ObjectClassDefinition* objectClass, 
+				SnapshotArena* arena,
 				HistoryBuffer* historyBuffer, 
-				unsigned int id);
+				ObjectManager* objectManager,
+				unsigned int id,
+				SpatialGrid* spatialGrid = NULL);
 			~NetworkObject(void);
 			unsigned int getId(void);
 			ServerObject* getUserObject(void);
@@ -46,11 +79,49 @@ namespace nsl {
 			int getCreationIndex(void);
 			void invalidateCreationIndex(void);
 			ObjectClassDefinition* getObjectClass(void);
+
+			/// Store value of attribute into the current index, object and attribute are marked as changed only if the value differs
 			void set(unsigned int attrId, unsigned int byteSize, byte* value);
-			byte* getDataBySeqIndex(short seqIndex);
-			void setDataBySeqIndex(short seqIndex, byte* data);
+
+			/// Write values held back by update groups, whose period is over in the current index
+			/// Returns true, if some values are still waiting
+			bool applyDeferredAttributes(void);
+
+			/// Did data of object change since given index was written?
+			/// Clean object has the same data in that index as in the current one
+			/// Like the rest of published values, changes held back by the manager are not seen until they are published
+			bool isChangedSince(int bufferIndex);
+			bool isAttributeChangedSince(unsigned int attrId, int bufferIndex);
+
+			/// The same for data, which may be out of history already (see HistoryBuffer::getSeqTick)
+			bool isChangedSinceTick(long tick) {return publishedChangeTick > tick;}
+
+			/// Make changes held back by the manager visible to encoding of updates
+			void publishChanges(void);
+			bool isChangePending(void) {return changePending;}
+			int getPublishedDestroyIndex(void) {return publishedDestroyIndex;}
+			double getPublishedPriority(void) {return publishedPriority;}
+
+			/// Pinned object is not deleted after it expires, because some peer may still need it
+			void pin(void) {pinCount++;}
+			void unpin(void) {pinCount--;}
+			bool isPinned(void) {return pinCount > 0;}
+			SnapshotArena* getArena(void) {return arena;}
+			unsigned int getSlot(void) {return slot;}
 			void setCreationCustomMessage(byte* data, unsigned int size);
 			bool getCreationCustomMessage(byte*& data, unsigned int& size);
+			DiffCacheEntry* getDiffCacheEntry(void) {return diffCacheEntry;}
+			void setDiffCacheEntry(DiffCacheEntry* entry) {diffCacheEntry = entry;}
+			SpatialGridEntry& getSpatialGridEntry(void) {return spatialGridEntry;}
+			double getPriority(void) {return priority;}
+			void setPriority(double priority);
+
+			/// highest priority of update groups with attributes changed since given index
+			double getChangePriority(int bufferIndex);
+
+			/// order of objects in peer scopes, by slot index of their ids
+			/// objects in one scope never share the slot, because it is reused only after the old object is deleted
+			static bool compareIds(NetworkObject* first, NetworkObject* second) {return getSlotMapIndex(first->id) < getSlotMapIndex(second->id);}
 		};
 	};
 };
@@ -7,71 +7,178 @@
 #include "ObjectManager.h"
 #include "../ObjectClassDefinition.h"
 #include "NetworkObject.h"
+#include "SnapshotArena.h"
 #include <string.h>
+#include <algorithm>
 
 namespace nsl {
 	namespace server {
 
 		ObjectManager::ObjectManager(void)
 		{
-			lastId = 0;
+			concurrent = false;
+			holdingChanges = false;
 		}
 
 		ObjectManager::~ObjectManager(void)
 		{
-
+			// objects give their slots back to arenas, so they must be deleted first
+			for (std::vector<NetworkObject*>::iterator it = objects.begin(); it != objects.end(); it++) {
+				delete *it;
+			}
+			for (std::vector<NetworkObject*>::iterator it = expiredObjects.begin(); it != expiredObjects.end(); it++) {
+				delete *it;
+			}
+			for (std::map<unsigned short, SnapshotArena*>::iterator it = arenas.begin(); it != arenas.end(); it++) {
+				delete it->second;
+			}
 		}
 
 		void ObjectManager::registerObjectClass(ObjectClassDefinition* objectClass)
 		{
-			objectClasses.insert(std::pair<unsigned int, ObjectClassDefinition*>(objectClass->getId(), objectClass));
+			if (objectClasses.insert(std::pair<unsigned int, ObjectClassDefinition*>(objectClass->getId(), objectClass)).second) {
+				SnapshotArena* arena = new SnapshotArena(objectClass);
+				arena->setConcurrent(concurrent);
+				arenas.insert(std::pair<unsigned short, SnapshotArena*>(objectClass->getId(), arena));
+			}
 		}
 
-		void ObjectManager::clearBufferIndex(int bufferIndex, int defaultsBufferIndex)
+		void ObjectManager::setConcurrent(bool concurrent)
 		{
-			std::map<unsigned int, NetworkObject*>::iterator it = objectsBegin();
-			// objects in packet cannot be used, because during deletion in packet data are received but object is not added into packet
-			while ( it != objectsEnd()) {
+			mergeConcurrentChanges();
+			this->concurrent = concurrent;
+			spatialGrid.setConcurrent(concurrent);
+			for (std::map<unsigned short, SnapshotArena*>::iterator it = arenas.begin(); it != arenas.end(); it++) {
+				it->second->setConcurrent(concurrent);
+			}
+		}
 
-				NetworkObject* o = it->second;
-				byte* data = o->getDataBySeqIndex(bufferIndex);
+		void ObjectManager::onObjectDestroyed(NetworkObject* object, int bufferIndex)
+		{
+			if (concurrent) {
+				concurrentDestroyedObjects.push(object);
+				return;
+			}
+			destroyedObjects[bufferIndex].push_back(object);
+			spatialGrid.remove(object);
+		}
 
-				// if object contains no more data, delete it from memmory
-				if (o->getDestroyIndex() == bufferIndex) {
-					objects.erase(it++);
-					delete o;
-					continue;
-				}
+		void ObjectManager::onObjectDeferred(NetworkObject* object)
+		{
+			if (concurrent) {
+				concurrentDeferredObjects.push(object->getId());
+			} else {
+				deferredObjects.push_back(object->getId());
+			}
+		}
+
+		void ObjectManager::onObjectChanged(NetworkObject* object)
+		{
+			if (concurrent) {
+				concurrentChangedObjects.push(object);
+			} else {
+				changedObjects.push_back(object);
+			}
+		}
 
-				// invalidate creation index
-				if (o->getCreationIndex() == bufferIndex) {
-					o->invalidateCreationIndex();
+		void ObjectManager::publishChanges(void)
+		{
+			concurrentChangedObjects.popAll(changedObjects);
+			for (std::vector<NetworkObject*>::iterator it = changedObjects.begin(); it != changedObjects.end(); it++) {
+				(*it)->publishChanges();
+			}
+			changedObjects.clear();
+		}
+
+		void ObjectManager::applyDeferredAttributes(void)
+		{
+			concurrentDeferredObjects.popAll(deferredObjects);
+
+			// objects are referenced by id, destroyed objects drop their waiting values
+			unsigned int kept = 0;
+			for (unsigned int i = 0; i < deferredObjects.size(); i++) {
+				NetworkObject* object = objects.find(deferredObjects[i]);
+				if (object != NULL && object->getDestroyIndex() == NSL_UNDEFINED_BUFFER_INDEX && object->applyDeferredAttributes()) {
+					deferredObjects[kept++] = deferredObjects[i];
 				}
+			}
+			deferredObjects.resize(kept);
+		}
 
-				// choose to copy default data (only if object was not deleted yet) or set NULL
+		void ObjectManager::mergeConcurrentChanges(void)
+		{
+			if (concurrentDestroyedObjects.isEmpty()) {
+				return;
+			}
+			concurrentDestroyedObjects.popAll(mergedObjects);
+			for (std::vector<NetworkObject*>::iterator it = mergedObjects.begin(); it != mergedObjects.end(); it++) {
+				destroyedObjects[(*it)->getDestroyIndex()].push_back(*it);
+				spatialGrid.remove(*it);
+			}
+			mergedObjects.clear();
+		}
+
+		void ObjectManager::clearBufferIndex(int bufferIndex, int defaultsBufferIndex)
+		{
+			mergeConcurrentChanges();
+
+			// invalidate creation index, before possible deletion of objects created and destroyed in the same index
+			for (std::vector<NetworkObject*>::iterator it = createdObjects[bufferIndex].begin(); it != createdObjects[bufferIndex].end(); it++) {
+				(*it)->invalidateCreationIndex();
+			}
+			createdObjects[bufferIndex].clear();
+
+			// if object contains no more data, it cannot be found anymore and it waits for deletion
+			for (std::vector<NetworkObject*>::iterator it = destroyedObjects[bufferIndex].begin(); it != destroyedObjects[bufferIndex].end(); it++) {
+				objects.erase((*it)->getId());
+				expiredObjects.push_back(*it);
+			}
+			destroyedObjects[bufferIndex].clear();
+			reclaimExpiredObjects();
+
+			// share default data or clear the whole index, block by block
+			for (std::map<unsigned short, SnapshotArena*>::iterator it = arenas.begin(); it != arenas.end(); it++) {
 				if (defaultsBufferIndex != NSL_UNDEFINED_BUFFER_INDEX) {
-					byte* defaultData = o->getDataBySeqIndex(defaultsBufferIndex);
-					if (defaultData != NULL) {
-						if (data == NULL) {
-							data = new byte[o->getObjectClass()->getByteSize()];
-							o->setDataBySeqIndex(bufferIndex, data);
-						}
-						memcpy(data, defaultData, o->getObjectClass()->getByteSize());
-					} else {
-						if (data != NULL) {
-							delete[] data;
-							o->setDataBySeqIndex(bufferIndex, NULL);
-						}
-					}
+					it->second->copyIndex(bufferIndex, defaultsBufferIndex);
 				} else {
-					if (data == NULL) {
-						data = new byte[o->getObjectClass()->getByteSize()];
-						o->setDataBySeqIndex(bufferIndex, data);
+					it->second->clearIndex(bufferIndex);
+				}
+			}
+		}
+
+		void ObjectManager::reclaimExpiredObjects(void)
+		{
+			// under steady load the queue is emptied within one history length
+			unsigned int count = std::max((unsigned int)NSL_RECLAIM_OBJECTS_PER_TICK, (unsigned int)expiredObjects.size() / NSL_PACKET_BUFFER_SIZE_SERVER);
+			unsigned int position = expiredObjects.size();
+			while (count > 0 && position > 0) {
+				position--;
+				// objects retained by peers wait in the queue until they are released, held changes until they are published
+				if (expiredObjects[position]->isPinned() || expiredObjects[position]->isChangePending()) {
+					continue;
+				}
+				delete expiredObjects[position];
+				expiredObjects[position] = expiredObjects.back();
+				expiredObjects.pop_back();
+				count--;
+			}
+		}
+
+		void ObjectManager::prepareDiffs(const std::vector<int>& ackIndexes, int currentIndex)
+		{
+			for (std::map<unsigned short, SnapshotArena*>::iterator it = arenas.begin(); it != arenas.end(); it++) {
+				if (it->second->isColumnar()) {
+					for (std::vector<int>::const_iterator ack = ackIndexes.begin(); ack != ackIndexes.end(); ack++) {
+						it->second->prepareDiff(*ack, currentIndex);
 					}
-					memset(data, 0, o->getObjectClass()->getByteSize());
 				}
+			}
+		}
 
-				it++;
+		void ObjectManager::invalidateDiffs(void)
+		{
+			for (std::map<unsigned short, SnapshotArena*>::iterator it = arenas.begin(); it != arenas.end(); it++) {
+				it->second->invalidateDiffs();
 			}
 		}
 
@@ -82,20 +189,23 @@ namespace nsl {
 				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to create unknown object");
 			}
 
-			NetworkObject* o = new NetworkObject(it->second, historyBuffer, ++lastId);
+			unsigned int id = objects.getNextId();
+			NetworkObject* o = new NetworkObject(it->second, arenas[classId], historyBuffer, this, id, &spatialGrid);
 
-			objects.insert(std::pair<unsigned int,NetworkObject*>(o->getId(),o));
+			objects.insert(id, o);
+			createdObjects[o->getCreationIndex()].push_back(o);
 			return o;
 		} 
 
+		bool ObjectManager::isArenaFull(unsigned short classId)
+		{
+			std::map<unsigned short, SnapshotArena*>::iterator it = arenas.find(classId);
+			return it != arenas.end() && it->second->isFull();
+		}
+
 		NetworkObject* ObjectManager::findObjectById(unsigned int objectId)
 		{
-			std::map<unsigned int, NetworkObject*>::iterator it = objects.find(objectId);
-			if (it == objects.end()) {
-				return NULL;
-			} else {
-				return it->second;
-			}
+			return objects.find(objectId);
 		}
 	};
 };
@@ -12,10 +12,14 @@ namespace nsl {
 	namespace server {
 		class NetworkObject;
 		class HistoryBuffer;
+		class SnapshotArena;
 	};
 };
 
 #include "../configuration.h"
+#include "../SlotMap.h"
+#include "../ConcurrentStack.h"
+#include "SpatialGrid.h"
 #include <vector>
 #include <map>
 #include <iterator>
@@ -26,9 +30,24 @@ namespace nsl {
 		class ObjectManager 
 		{
 		private:
-			std::map<unsigned int,NetworkObject*> objects;
+			SlotMap<NetworkObject*> objects;
 			std::map<unsigned short, ObjectClassDefinition*> objectClasses;
-			unsigned int lastId;
+			std::map<unsigned short, SnapshotArena*> arenas;	// history data of all objects of given class
+			SpatialGrid spatialGrid;	// cells of objects by position, used for scope of peers with a view
+			std::vector<NetworkObject*> createdObjects[NSL_PACKET_BUFFER_SIZE_SERVER];		// objects by index of their creation
+			std::vector<NetworkObject*> destroyedObjects[NSL_PACKET_BUFFER_SIZE_SERVER];	// objects by index of their destruction
+			std::vector<NetworkObject*> expiredObjects;		// objects without data in history, deleted a few at a time
+			ConcurrentStack<NetworkObject*> concurrentDestroyedObjects;	// objects destroyed in concurrent mode, not added to destroyedObjects yet
+			std::vector<NetworkObject*> mergedObjects;
+			std::vector<unsigned int> deferredObjects;	// ids of objects with attribute values waiting for their update group
+			ConcurrentStack<unsigned int> concurrentDeferredObjects;	// ids of objects deferred in concurrent mode, added to deferredObjects later
+			std::vector<NetworkObject*> changedObjects;	// objects with changes held back from encoding, see setHoldingChanges
+			ConcurrentStack<NetworkObject*> concurrentChangedObjects;
+			bool concurrent;
+			bool holdingChanges;
+
+			/// delete some of expired objects, so thousands of objects expiring together do not stall one tick
+			void reclaimExpiredObjects(void);
 		public:
 			ObjectManager(void);
 			~ObjectManager(void);
@@ -37,17 +56,71 @@ namespace nsl {
 
 			/// wipe all data from that index so it can be used to store new data
 			/// if defaultsBufferIndex is set, data of all objects in this index will be set to copy of defaults
-			/// if all data of some object are deleted, it is deleted from memmory
+			/// (the index only shares pages of defaults, see SnapshotArena)
+			/// if defaultsBufferIndex is not set, data of all objects are set to zero
+			/// objects destroyed in that index are forgotten and deleted later, only objects created or destroyed in it are visited
 			void clearBufferIndex(int bufferIndex, int defaultsBufferIndex = NSL_UNDEFINED_BUFFER_INDEX);
 
+			/// remember object destroyed in the current index, so it is deleted when the index is cleared
+			/// in concurrent mode it is only queued until mergeConcurrentChanges
+			void onObjectDestroyed(NetworkObject* object, int bufferIndex);
+
+			/// remember object with attribute values held back by its update groups
+			void onObjectDeferred(NetworkObject* object);
+
+			/// write held back values of groups due in the current index, called when a new index is started
+			void applyDeferredAttributes(void);
+
+			/// let objects be set and destroyed from more threads at once (distinct objects only)
+			/// creation is not synchronized here, it must be serialized by the caller
+			void setConcurrent(bool concurrent);
+
+			/// apply destructions queued in concurrent mode, no object can be set or destroyed meanwhile
+			/// called by clearBufferIndex as well
+			void mergeConcurrentChanges(void);
+
+			/// hold changes of objects (change ticks, priority and destruction) back from encoding of updates until publishChanges,
+			/// so the network thread reads the state of the flush it encodes while the game thread goes on
+			/// objects with held changes are not deleted before they are published
+			void setHoldingChanges(bool holding) {holdingChanges = holding;}
+			bool isHoldingChanges(void) {return holdingChanges;}
+
+			/// remember object with changes held back, queued in concurrent mode
+			void onObjectChanged(NetworkObject* object);
+
+			/// make held changes visible to encoding, no object can be set meanwhile and no update can be encoded
+			void publishChanges(void);
+
+			/// number of objects waiting for deletion
+			unsigned int getExpiredObjectCount(void) {return expiredObjects.size();}
+
+			/// compute diffs of columnar classes against given ack indexes, each for all objects of the class at once
+			void prepareDiffs(const std::vector<int>& ackIndexes, int currentIndex);
+
+			/// forget diffs computed by prepareDiffs
+			void invalidateDiffs(void);
+
 			/// create new object with no data
 			NetworkObject* createObject(unsigned short classId, HistoryBuffer* historyBuffer);
 
-			const std::map<unsigned int,NetworkObject*>::iterator objectsBegin(void) {return objects.begin();}
-			const std::map<unsigned int,NetworkObject*>::iterator objectsEnd(void) {return objects.end();}
+			/// will creating object of given class grow history of the class?
+			bool isArenaFull(unsigned short classId);
+
+			/// all objects, in no particular order
+			const std::vector<NetworkObject*>::iterator objectsBegin(void) {return objects.begin();}
+			const std::vector<NetworkObject*>::iterator objectsEnd(void) {return objects.end();}
+
+			/// objects by slot index of their ids, NULL for free slots
+			unsigned int getObjectSlotCount(void) {return objects.getSlotCount();}
+			NetworkObject* getObjectBySlot(unsigned int index) {return objects.getBySlot(index);}
 
 			/// if no object is found, NULL is returned
 			NetworkObject* findObjectById(unsigned int objectId);
+
+			/// move objects, whose position changed since the last call, to their current cells
+			void updateSpatialGrid(int currentIndex) {spatialGrid.update(this, currentIndex);}
+
+			SpatialGrid* getSpatialGrid(void) {return &spatialGrid;}
 		};
 	};
 };
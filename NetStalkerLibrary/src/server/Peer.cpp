@@ -6,7 +6,11 @@
 
 #include "Peer.h"
 #include "Connection.h"
+#include "NetworkObject.h"
+#include "SnapshotArena.h"
+#include "../ObjectClassDefinition.h"
 #include "../../include/nslBitStream.h"
+#include <string.h>
 
 namespace nsl {
 	namespace server {
@@ -15,11 +19,36 @@ namespace nsl {
 			customMessageSeq = 0;
 			userObject = new nsl::Peer(this);
 			isAck = false;
+			isPublishedAck = false;
+			publishedCustomMessageSeq = 0;
 			firstUpdateIndex = NSL_UNDEFINED_BUFFER_INDEX;
+			view = false;
+			lostCustomMessages = false;
+			byteBudget = NSL_PEER_BYTE_BUDGET;
+			flushesSinceUpdate = 0;
+			sentUpdateCount = 0;
+			flushCount = 0;
+			ackedUpdateCount = 0;
+			ackedUpdateFlush = 0;
+			adaptedUpdateCount = 0;
+			roundTrip = 0;
+			minRoundTrip = 0;
+			windowMinRoundTrip = 0;
+			roundTripCount = 0;
+			memset(sentUpdateOrdinals, 0, sizeof(sentUpdateOrdinals));
+			memset(sentUpdateFlushes, 0, sizeof(sentUpdateFlushes));
+			setSendInterval(NSL_PEER_SEND_INTERVAL);
+			retainedAck = 0;
+			retained = false;
+			publishedRetained = false;
+			publishedByteBudget = byteBudget;
+			publishedSendInterval = currentSendInterval;
+			publishedView = false;
 		}
 
 		Peer::~Peer(void)
 		{
+			releaseRetainedScope();
 			// TODO	where to delete this struct?
 			delete peerConnection;
 			delete userObject;
@@ -51,13 +80,150 @@ namespace nsl {
 			return isAck;
 		}
 
+		void Peer::publish(void)
+		{
+			publishedAck = lastAck;
+			isPublishedAck = isAck;
+			publishedCustomMessageSeq = customMessageSeq;
+			publishedRetained = retained;
+			publishedByteBudget = byteBudget;
+			publishedSendInterval = currentSendInterval;
+			publishedView = view;
+			memcpy(publishedViewPosition, viewPosition, sizeof(viewPosition));
+
+			if (outgoingCustomMessages.empty()) {
+				outgoingCustomMessages.swap(newCustomMessages);
+			} else {
+				outgoingCustomMessages.insert(outgoingCustomMessages.end(), newCustomMessages.begin(), newCustomMessages.end());
+				newCustomMessages.clear();
+			}
+		}
+
+		void Peer::setView(double x, double y, double z, double radius)
+		{
+			if (radius < 0) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: view radius cannot be negative");
+			}
+			viewPosition[0] = x;
+			viewPosition[1] = y;
+			viewPosition[2] = z;
+			viewRadius = radius;
+			view = true;
+		}
+
 		std::vector<NetworkObject*>* Peer::getScope(int bufferIndex)
 		{
 			return &scope[bufferIndex];
 		}
 
-		void Peer::clearIndex(int bufferIndex)
+		void Peer::setSendInterval(unsigned int flushes)
+		{
+			sendInterval = flushes;
+			currentSendInterval = (flushes == 0 ? 1 : flushes);
+		}
+
+		bool Peer::isUpdateDue(int ackIndex)
+		{
+			flushCount++;
+			flushesSinceUpdate++;
+			if (ackIndex != NSL_UNDEFINED_BUFFER_INDEX && sentUpdateOrdinals[ackIndex] > ackedUpdateCount) {
+				ackedUpdateCount = sentUpdateOrdinals[ackIndex];
+				ackedUpdateFlush = sentUpdateFlushes[ackIndex];
+				roundTrip = flushCount - ackedUpdateFlush;
+
+				// the shortest round trip is taken again after every window, so a longer route does not look like a queue forever
+				if (roundTripCount == 0 || roundTrip < windowMinRoundTrip) {
+					windowMinRoundTrip = roundTrip;
+				}
+				if (minRoundTrip == 0 || roundTrip < minRoundTrip) {
+					minRoundTrip = roundTrip;
+				}
+				if (++roundTripCount == NSL_PEER_ROUND_TRIP_WINDOW) {
+					minRoundTrip = windowMinRoundTrip;
+					roundTripCount = 0;
+				}
+			}
+
+			// nothing is known about the link until the first ack
+			if (sendInterval == 0 && ackedUpdateCount > 0) {
+				// the next update after the acknowledged one was sent one interval later, its ack is awaited one round trip after that
+				unsigned int waited = flushCount - ackedUpdateFlush;
+				bool late = roundTrip > minRoundTrip + NSL_PEER_MAX_QUEUE_DELAY || waited > minRoundTrip + currentSendInterval + NSL_PEER_MAX_QUEUE_DELAY;
+				bool inTime = roundTrip <= minRoundTrip + NSL_PEER_MAX_QUEUE_DELAY / 2 && waited <= minRoundTrip + currentSendInterval;
+				if (late && ackedUpdateCount >= adaptedUpdateCount) {
+					// react once per round trip, updates sent before the change cannot show its effect
+					currentSendInterval = (currentSendInterval * 2 < NSL_PEER_MAX_SEND_INTERVAL ? currentSendInterval * 2 : NSL_PEER_MAX_SEND_INTERVAL);
+					adaptedUpdateCount = sentUpdateCount + 1;
+				} else if (inTime && currentSendInterval > 1 && flushesSinceUpdate >= currentSendInterval) {
+					currentSendInterval--;
+				}
+			}
+
+			if (flushesSinceUpdate < currentSendInterval) {
+				return false;
+			}
+			flushesSinceUpdate = 0;
+			return true;
+		}
+
+		void Peer::setUpdateSent(int bufferIndex)
+		{
+			sentUpdateOrdinals[bufferIndex] = ++sentUpdateCount;
+			sentUpdateFlushes[bufferIndex] = flushCount;
+		}
+
+		void Peer::retainScope(int bufferIndex)
 		{
+			if (retained) {
+				return;
+			}
+			retainedScope = scope[bufferIndex];
+			retainedBases = scopeBases[bufferIndex];
+			retainedAck = lastAck;
+			retained = true;
+			for (std::vector<NetworkObject*>::iterator it = retainedScope.begin(); it != retainedScope.end(); it++) {
+				(*it)->pin();
+			}
+
+			// data of the ack are going to be cleared, the client applies the next diffs to them
+			retainedData.assign(retainedScope.size(), NULL);
+			for (unsigned int i = 0; i < retainedScope.size(); i++) {
+				if (retainedBases[i] != retainedAck) {
+					continue;
+				}
+				NetworkObject* o = retainedScope[i];
+				ObjectClassDefinition* objectClass = o->getObjectClass();
+				byte* data = new byte[objectClass->getByteSize()];
+				for (unsigned int a = 0; a < objectClass->getAttributeCount(); a++) {
+					memcpy(data + objectClass->getDataOffset(a), o->getArena()->getAttribute(bufferIndex, o->getSlot(), a), objectClass->getAttributeDefinition(a)->size);
+				}
+				retainedData[i] = data;
+			}
+		}
+
+		void Peer::releaseRetainedScope(void)
+		{
+			for (std::vector<NetworkObject*>::iterator it = retainedScope.begin(); it != retainedScope.end(); it++) {
+				(*it)->unpin();
+			}
+			for (std::vector<byte*>::iterator it = retainedData.begin(); it != retainedData.end(); it++) {
+				if (*it != NULL) {
+					delete[] *it;
+				}
+			}
+			retainedScope.clear();
+			retainedBases.clear();
+			retainedData.clear();
+			retained = false;
+			publishedRetained = false;
+		}
+
+		void Peer::clearIndex(int bufferIndex, bool acknowledged)
+		{
+			if (!acknowledged && !customMessageBuffer[bufferIndex].empty()) {
+				lostCustomMessages = true;
+			}
+
 			if (firstUpdateIndex == bufferIndex) {
 				firstUpdateIndex = NSL_UNDEFINED_BUFFER_INDEX;
 			}
@@ -67,6 +233,8 @@ namespace nsl {
 			}
 
 			customMessageBuffer[bufferIndex].clear();
+			scope[bufferIndex].clear();
+			scopeBases[bufferIndex].clear();
 		}
 	};
 };
\ No newline at end of file
@@ -22,17 +22,89 @@ namespace nsl {
 namespace nsl {
 	namespace server {
 
+		/// Object which might be sent in an update with limited byte budget
+		struct BudgetCandidate
+		{
+			double priority;
+			unsigned int size;			// bytes needed to send the object
+			unsigned int position;		// position in ack scope (updated objects) or in new scope (created objects)
+			bool creation;
+
+			/// objects unknown to the client go first, then higher priority, ties keep order of scopes
+			bool operator<(const BudgetCandidate& other) const {
+				if (creation != other.creation) return creation;
+				if (priority != other.priority) return priority > other.priority;
+				return position < other.position;
+			}
+		};
+
+		/// Working data of one peer update, kept in peer to avoid reallocation every tick
+		struct UpdateSelection
+		{
+			// by position in ack scope
+			std::vector<char> kept;				// is the object still in scope?
+			std::vector<int> baseIndexes;		// index of data the client has, NSL_UNDEFINED_BUFFER_INDEX if out of history
+			std::vector<long> baseTicks;		// tick of data the client has, known even out of history
+			std::vector<char> sent;				// is the object updated (or deleted) in this update?
+			std::vector<char> due;				// is the update period of the object over (see Server::getRelevance)?
+			std::vector<seqNumber> bases;		// base of the object after this update
+
+			// by position in new scope
+			std::vector<char> added;			// is the object unknown to the client?
+			std::vector<char> created;			// is the object created in this update?
+
+			std::vector<BudgetCandidate> candidates;
+			bool keyframe;						// are kept objects sent by absolute values?
+			std::vector<byte*>* retainedData;	// data of the retained ack by position in ack scope, NULL if the ack is in history
+			std::vector<byte> retainedDiff;		// diff against retained data being encoded
+		};
+
 		class Peer {
 		private:
 			PeerConnection* peerConnection;
 			std::vector<NetworkObject*> scope[NSL_PACKET_BUFFER_SIZE_SERVER];
+			std::vector<seqNumber> scopeBases[NSL_PACKET_BUFFER_SIZE_SERVER];	// seq of data client has for every object in scope
 			std::vector<std::pair<byte*, unsigned int> > customMessageBuffer[NSL_PACKET_BUFFER_SIZE_SERVER];
-			std::vector<std::pair<BitStreamWriter*, bool> > newCustomMessages;
+			std::vector<std::pair<BitStreamWriter*, bool> > newCustomMessages;		// created by user since the last flush
+			std::vector<std::pair<BitStreamWriter*, bool> > outgoingCustomMessages;	// written by the next update
 			seqNumber lastAck;
 			seqNumber customMessageSeq;
 			int firstUpdateIndex;
 			bool isAck;
+			seqNumber publishedAck;					// values used by the next update, see publish()
+			seqNumber publishedCustomMessageSeq;
+			bool isPublishedAck;
+			unsigned int publishedByteBudget;
+			unsigned int publishedSendInterval;
+			bool publishedView;
+			double publishedViewPosition[3];
+			bool lostCustomMessages;
 			nsl::Peer* userObject;
+			bool view;
+			double viewPosition[3];
+			double viewRadius;
+			unsigned int byteBudget;
+			UpdateSelection updateSelection;
+			unsigned int sendInterval;				// set by user, 0 means automatic
+			unsigned int currentSendInterval;		// flushes between updates currently used
+			unsigned int flushesSinceUpdate;
+			unsigned int sentUpdateCount;
+			unsigned int sentUpdateOrdinals[NSL_PACKET_BUFFER_SIZE_SERVER];	// sentUpdateCount after the update of the buffer index was sent
+			unsigned int sentUpdateFlushes[NSL_PACKET_BUFFER_SIZE_SERVER];	// flush in which the update of the buffer index was sent
+			unsigned int flushCount;
+			unsigned int ackedUpdateCount;			// ordinal of the newest acknowledged update
+			unsigned int ackedUpdateFlush;			// flush in which the newest acknowledged update was sent
+			unsigned int roundTrip;					// flushes between sending the newest acknowledged update and seeing its ack
+			unsigned int minRoundTrip;				// shortest round trip of the last window, the link without queues
+			unsigned int windowMinRoundTrip;
+			unsigned int roundTripCount;			// acks measured in the current window
+			unsigned int adaptedUpdateCount;		// interval is not increased again until this update is acknowledged
+			std::vector<NetworkObject*> retainedScope;	// scope of the ack, which left the history, see retainScope()
+			std::vector<seqNumber> retainedBases;
+			std::vector<byte*> retainedData;		// data of objects, which had the retained ack as base, NULL for the others
+			seqNumber retainedAck;
+			bool retained;
+			bool publishedRetained;
 		public:
 			Peer(PeerConnection* peer);
 			~Peer(void);
@@ -43,12 +115,60 @@ namespace nsl {
 			seqNumber getLastAck(void);
 			void setLastAck(seqNumber ack);
 			bool hasAck(void);
-			void clearIndex(int bufferIndex);
+			/// Forget data of buffer index, which is going to be reused
+			/// If there were reliable custom messages not acknowledged by peer, they are lost
+			void clearIndex(int bufferIndex, bool acknowledged);
+			bool hasLostCustomMessages(void) {return lostCustomMessages;}
 			int getFirstUpdateIndex(void) {return firstUpdateIndex;}
 			void setFirstUpdateIndex(int bufferIndex) {firstUpdateIndex = bufferIndex;};
 			std::vector<NetworkObject*>* getScope(int bufferIndex);
+			std::vector<seqNumber>* getScopeBases(int bufferIndex) {return &scopeBases[bufferIndex];}
 			std::vector<std::pair<byte*, unsigned int> >& getBufferedCustomMessages(int bufferIndex) {return customMessageBuffer[bufferIndex];}
 			std::vector<std::pair<BitStreamWriter*, bool> >& getNewCustomMessages() {return newCustomMessages;}
+			std::vector<std::pair<BitStreamWriter*, bool> >& getOutgoingCustomMessages() {return outgoingCustomMessages;}
+			/// Keep scope of the ack, which is leaving the history, so the peer is not sent all objects created again after a long silence
+			/// (or after its client resumes the session), data of objects based on the ack are copied, so they are still sent as diffs
+			/// objects with older bases (skipped by budget or relevance) are sent in full, their data are gone already
+			/// Objects of the scope are pinned (their ids stay valid), only the first ack is retained until the scope is released
+			/// Must be called before the index is cleared
+			void retainScope(int bufferIndex);
+			/// Forget the retained scope, the peer has an ack in history again
+			void releaseRetainedScope(void);
+			bool hasPublishedRetainedScope(void) {return publishedRetained;}
+			std::vector<NetworkObject*>* getRetainedScope(void) {return &retainedScope;}
+			std::vector<seqNumber>* getRetainedBases(void) {return &retainedBases;}
+			std::vector<byte*>* getRetainedData(void) {return &retainedData;}
+			seqNumber getRetainedAck(void) {return retainedAck;}
+			/// Hand new custom messages, ack, custom message seq and settings (budget, send interval and view) over to the next update
+			/// so the game thread can create more messages, receive more acks and change the settings while the update is encoded
+			void publish(void);
+			seqNumber getPublishedAck(void) {return publishedAck;}
+			bool hasPublishedAck(void) {return isPublishedAck;}
+			seqNumber getPublishedCustomMessageSeq(void) {return publishedCustomMessageSeq;}
+			unsigned int getPublishedByteBudget(void) {return publishedByteBudget;}
+			unsigned int getPublishedSendInterval(void) {return publishedSendInterval;}
+			bool hasPublishedView(void) {return publishedView;}
+			double* getPublishedViewPosition(void) {return publishedViewPosition;}
+			void setView(double x, double y, double z, double radius);
+			void clearView(void) {view = false;}
+			bool hasView(void) {return view;}
+			double* getViewPosition(void) {return viewPosition;}
+			double getViewRadius(void) {return viewRadius;}
+			unsigned int getByteBudget(void) {return byteBudget;}
+			void setByteBudget(unsigned int bytes) {byteBudget = bytes;}
+			UpdateSelection& getUpdateSelection(void) {return updateSelection;}
+			void setSendInterval(unsigned int flushes);
+			unsigned int getSendInterval(void) {return currentSendInterval;}
+			unsigned int getSentUpdateCount(void) {return sentUpdateCount;}
+			/// Count the flush and tell whether the peer gets an update in it
+			/// Automatic interval doubles when acks come later than the shortest round trip allows (queues grow or updates are lost)
+			/// and decreases by one while they come in time, so a long but healthy round trip does not throttle the peer
+			bool isUpdateDue(int ackIndex);
+			/// Number of updates sent to the peer since the update of the buffer index, the update being encoded included
+			/// Ages of acks and object bases are measured by it, so they do not grow with the send interval
+			unsigned int getUpdateAge(int bufferIndex) {return sentUpdateCount - sentUpdateOrdinals[bufferIndex];}
+			/// Remember that the update stored in the buffer index was sent to the peer
+			void setUpdateSent(int bufferIndex);
 		};
 	};
 };
\ No newline at end of file
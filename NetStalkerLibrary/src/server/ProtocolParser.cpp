@@ -7,109 +7,138 @@
 #include "ProtocolParser.h"
 #include "HistoryBuffer.h"
 #include "Peer.h"
+#include "Connection.h"
 #include "../ObjectClassDefinition.h"
 #include "NetworkObject.h"
+#include "SnapshotArena.h"
+#include "../delta/delta.h"
+#include <algorithm>
+#include <string.h>
 
 namespace nsl {
 	namespace server {
-		ProtocolParser::ProtocolParser(HistoryBuffer* historyBuffer) : historyBuffer(historyBuffer)
+		ProtocolParser::ProtocolParser(HistoryBuffer* historyBuffer) : historyBuffer(historyBuffer), diffCache(this)
 		{}
 
 		ProtocolParser::~ProtocolParser(void)
 		{}
 
-		void ProtocolParser::writeUpdateToPeer(BitStreamWriter* stream, Peer* peer, std::set<NetworkObject*>& scope, int ackIndex)
+		void ProtocolParser::invalidateCache(void)
+		{
+			diffCache.invalidate();
+		}
+
+		void ProtocolParser::writeUpdateToPeer(BitStreamWriter* stream, Peer* peer, const std::vector<NetworkObject*>& scope, int ackIndex, const std::vector<char>* due)
 		{
 			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
 			std::vector<NetworkObject*>* seqScope = peer->getScope(currentSeqIndex);
+			std::vector<seqNumber>* seqBases = peer->getScopeBases(currentSeqIndex);
 			seqScope->clear();
+			seqBases->clear();
+
+			std::vector<NetworkObject*> emptyScope;
+			std::vector<seqNumber> emptyBases;
+			std::vector<NetworkObject*>* ackScope = &emptyScope;
+			std::vector<seqNumber>* ackBases = &emptyBases;
+			std::vector<byte*>* retainedData = NULL;
 
 			seqNumber seq = historyBuffer->indexToSeq(currentSeqIndex);
 			stream->write<Attribute<seqNumber> >(seq);
-			if (ackIndex == NSL_UNDEFINED_BUFFER_INDEX) {
-				stream->write<Attribute<seqNumber> >(seq);
-			} else {
+			if (ackIndex != NSL_UNDEFINED_BUFFER_INDEX) {
 				stream->write<Attribute<seqNumber> >(historyBuffer->indexToSeq(ackIndex));
+				ackScope = peer->getScope(ackIndex);
+				ackBases = peer->getScopeBases(ackIndex);
+			} else if (peer->hasPublishedRetainedScope()) {
+				// ack is out of history, but the client still has the retained one, objects it knows are not created again
+				// data of the ack are gone from history, so objects changed since then are diffed against data kept by the peer
+				stream->write<Attribute<seqNumber> >(peer->getRetainedAck());
+				ackScope = peer->getRetainedScope();
+				ackBases = peer->getRetainedBases();
+				retainedData = peer->getRetainedData();
+			} else {
+				stream->write<Attribute<seqNumber> >(seq);
 			}
 			stream->write<double64>(historyBuffer->getTime(currentSeqIndex));
-			stream->write<Attribute<seqNumber> >(peer->getCustomMessageSeq());
+			stream->write<Attribute<seqNumber> >(peer->getPublishedCustomMessageSeq());
+
+			// decide what happens with every object, then write it
+			UpdateSelection& selection = peer->getUpdateSelection();
+			selection.retainedData = retainedData;
+			mergeScopes(selection, peer, scope, *ackScope, *ackBases, due);
+			selection.keyframe = isKeyframe(peer, ackIndex);
+			if (peer->getPublishedByteBudget() == 0) {
+				selection.sent.assign(selection.due.begin(), selection.due.end());
+				selection.created.assign(selection.added.begin(), selection.added.end());
+				limitCreations(selection, peer, scope);
+			} else {
+				selectObjectsInBudget(selection, peer, scope, *ackScope, *ackBases);
+			}
 
 			// create diff part of update
-			if (ackIndex != NSL_UNDEFINED_BUFFER_INDEX) {
-				std::vector<NetworkObject*>* ackScope = peer->getScope(ackIndex);
-				for(std::vector<NetworkObject*>::iterator it = ackScope->begin(); it != ackScope->end(); it++) {
-
-					NetworkObject* o = *it;
-					ObjectFlags flags;
-
-					std::set<NetworkObject*>::iterator scopeObject = scope.find(o);
-					if (scopeObject == scope.end()) {
-						flags.action = NSL_OBJECT_FLAG_ACTION_DELETE;
-						if (o->getDestroyIndex() == currentSeqIndex) {
-							flags.scopeDestroy = NSL_OBJECT_FLAG_SD_DEATH;
-						} else {
-							flags.scopeDestroy = NSL_OBJECT_FLAG_SD_HIDE;
-						}
+			for (unsigned int i = 0; i < ackScope->size(); i++) {
+				NetworkObject* o = (*ackScope)[i];
+				int baseIndex = selection.baseIndexes[i];
+				ObjectFlags flags;
+				unsigned int diffSize;
+
+				if (!selection.kept[i]) {
+					flags.action = NSL_OBJECT_FLAG_ACTION_DELETE;
+					if (o->getPublishedDestroyIndex() == currentSeqIndex) {
+						flags.scopeDestroy = NSL_OBJECT_FLAG_SD_DEATH;
 					} else {
-						scope.erase(scopeObject);
-						flags.action = NSL_OBJECT_FLAG_ACTION_DIFF;
-						seqScope->push_back(o);
+						flags.scopeDestroy = NSL_OBJECT_FLAG_SD_HIDE;
 					}
-					*stream << flags;
 
-					byte* newData;	
-					unsigned int byteSize = o->getObjectClass()->getByteSize();
-					byte* ackData = o->getDataBySeqIndex(ackIndex);
-					byte* currentData = o->getDataBySeqIndex(currentSeqIndex);
-					newData = new byte[byteSize];
-						
-					for (unsigned int i = 0; i < byteSize; i++) {
-						newData[i] = ackData[i] ^ currentData[i];
+					// without base the client keeps the data it has
+					diffCache.writeDiff(stream, o, baseIndex == NSL_UNDEFINED_BUFFER_INDEX ? currentSeqIndex : baseIndex, flags);
+				} else if (!o->isChangedSinceTick(selection.baseTicks[i])) {
+					// clean object needs neither diff nor keyframe, the client already has its current data
+					flags.action = NSL_OBJECT_FLAG_ACTION_NO_CHANGE;
+					*stream << flags;
+					selection.bases[i] = seq;
+				} else if (baseIndex == NSL_UNDEFINED_BUFFER_INDEX && (diffSize = encodeRetainedDiff(selection, o, i)) != 0) {
+					// data the client has are not in history anymore, but the peer kept them
+					flags.action = (diffSize == o->getObjectClass()->getAttributeMaskByteSize() ? NSL_OBJECT_FLAG_ACTION_NO_CHANGE : NSL_OBJECT_FLAG_ACTION_DIFF);
+					*stream << flags;
+					if (flags.action == NSL_OBJECT_FLAG_ACTION_DIFF) {
+						stream->writeRaw(diffSize, &selection.retainedDiff[0]);
 					}
-
-					// TODO: NO_CHANGE flag?
-
-					// TODO: count ticks and sometimes call snapshot:
-					//stream->writeByte(NSL_OBJECT_FLAG_SNAPSHOT);
-					//newData = o->getDataBySeqIndex(currentSeqIndex);
-
-					writeObjectData(o->getObjectClass(), stream, newData);
-				}
-			}
-
-			// TODO: create and destroy
-
-			// add new objects to packet
-			for(std::set<NetworkObject*>::iterator it = scope.begin(); it != scope.end(); it++) {
-				NetworkObject* o = (*it);
-				ObjectFlags flags;
-				flags.action = NSL_OBJECT_FLAG_ACTION_CREATE;
-				seqScope->push_back(o);
-				if (o->getCreationIndex() == currentSeqIndex) {
-					flags.scopeCreate = NSL_OBJECT_FLAG_SC_BIRTH;
+					selection.bases[i] = seq;
+				} else if (baseIndex == NSL_UNDEFINED_BUFFER_INDEX || (selection.keyframe && selection.sent[i])) {
+					// data the client has are not in history anymore or absolute values are wanted
+					flags.action = NSL_OBJECT_FLAG_ACTION_SNAPSHOT;
+					*stream << flags;
+					writeArenaData(stream, o, o->getArena()->getBlock(currentSeqIndex));
+					selection.bases[i] = seq;
+				} else if (selection.sent[i]) {
+					flags.action = NSL_OBJECT_FLAG_ACTION_DIFF;
+					diffCache.writeDiff(stream, o, baseIndex, flags);
+					selection.bases[i] = seq;
 				} else {
-					flags.scopeCreate = NSL_OBJECT_FLAG_SC_SHOW;
+					// object did not fit into budget or is not relevant enough, the client keeps the data it has
+					flags.action = (selection.due[i] ? NSL_OBJECT_FLAG_ACTION_NO_CHANGE : NSL_OBJECT_FLAG_ACTION_SKIP);
+					*stream << flags;
+					selection.bases[i] = (*ackBases)[i];
 				}
+			}
 
-				// add custom message if there is some bound
-				byte* creationCustomMessage = NULL;
-				unsigned int creationCustomMessageSize;
-				if (o->getCreationCustomMessage(creationCustomMessage, creationCustomMessageSize)) {
-					flags.creationCustomMessage = NSL_OBJECT_FLAG_CM_PRESENT;
+			// add new objects to packet, the client keeps the same ordered list of objects in this packet
+			unsigned int ackPosition = 0;
+			for (unsigned int i = 0; i < scope.size(); i++) {
+				NetworkObject* o = scope[i];
+				if (selection.added[i]) {
+					if (selection.created[i]) {
+						diffCache.writeCreation(stream, o);
+						seqScope->push_back(o);
+						seqBases->push_back(seq);
+					}
 				} else {
-					flags.creationCustomMessage = NSL_OBJECT_FLAG_CM_EMPTY;
-				}
-
-				*stream << flags;
-				stream->write<uint16>(o->getObjectClass()->getId());
-				stream->write<uint32>(o->getId());
-
-				if (creationCustomMessage != NULL) {
-					stream->write<Attribute<customMessageSizeNumber> >(creationCustomMessageSize);
-					stream->writeRaw(creationCustomMessageSize, creationCustomMessage);
+					while ((*ackScope)[ackPosition] != o) {
+						ackPosition++;
+					}
+					seqScope->push_back(o);
+					seqBases->push_back(selection.bases[ackPosition]);
 				}
-
-				writeObjectData(o->getObjectClass(), stream, o->getDataBySeqIndex(currentSeqIndex));
 			}
 			ObjectFlags flags;
 			flags.action = NSL_OBJECT_FLAG_ACTION_END_OF_SECTION;
@@ -118,23 +147,17 @@ namespace nsl {
 			// custom messages
 
 			// add unacked reliable custom messages
-			int index;
-			if (peer->hasAck()) {
-				index = (historyBuffer->seqToIndex(peer->getLastAck()) + 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
-			} else {
-				index = peer->getFirstUpdateIndex();
-			}
-
+			int index = getFirstUnackedIndex(peer);
 			while (index != currentSeqIndex) {
 				pushBufferedMessagesByIndex(stream, index, peer);
 				index = (index + 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
 			}
 				
-			// new messages (current index)
-			std::vector<std::pair<BitStreamWriter*, bool> > newCustomMessages = peer->getNewCustomMessages();
-			if (!newCustomMessages.empty()) {
+			// messages created since the last update (current index)
+			std::vector<std::pair<BitStreamWriter*, bool> >& outgoingCustomMessages = peer->getOutgoingCustomMessages();
+			if (!outgoingCustomMessages.empty()) {
 				stream->write<Attribute<seqNumber> >(historyBuffer->indexToSeq(currentSeqIndex));
-				for (std::vector<std::pair<BitStreamWriter*, bool> >::iterator it = newCustomMessages.begin(); it != newCustomMessages.end(); it++) {
+				for (std::vector<std::pair<BitStreamWriter*, bool> >::iterator it = outgoingCustomMessages.begin(); it != outgoingCustomMessages.end(); it++) {
 
 					// append data to stream
 					unsigned int size;
@@ -152,17 +175,289 @@ namespace nsl {
 
 					delete it->first;
 				}
-				newCustomMessages.clear();
+				outgoingCustomMessages.clear();
 				stream->write<Attribute<customMessageSizeNumber> >(0);
 			}
 		}
 
+		void ProtocolParser::mergeScopes(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope, const std::vector<NetworkObject*>& ackScope, const std::vector<seqNumber>& ackBases, const std::vector<char>* due)
+		{
+			selection.kept.assign(ackScope.size(), false);
+			selection.due.assign(ackScope.size(), true);
+			selection.baseIndexes.resize(ackScope.size());
+			selection.baseTicks.resize(ackScope.size());
+			selection.bases.resize(ackScope.size());
+			selection.added.assign(scope.size(), false);
+
+			// both scopes are ordered by slot index of ids, so kept, removed and added objects are found by merging them
+			unsigned int a = 0;
+			unsigned int s = 0;
+			while (a < ackScope.size() || s < scope.size()) {
+				if (s == scope.size() || (a < ackScope.size() && NetworkObject::compareIds(ackScope[a], scope[s]))) {
+					a++;
+				} else if (a == ackScope.size() || NetworkObject::compareIds(scope[s], ackScope[a])) {
+					selection.added[s++] = true;
+				} else if (ackScope[a] != scope[s]) {
+					// slot was reused by another object
+					a++;
+					selection.added[s++] = true;
+				} else {
+					if (due != NULL && !due->empty()) {
+						selection.due[a] = (*due)[s];
+					}
+					selection.kept[a++] = true;
+					s++;
+				}
+			}
+
+			for (unsigned int i = 0; i < ackScope.size(); i++) {
+				if (historyBuffer->isSeqInBounds(ackBases[i])) {
+					selection.baseIndexes[i] = historyBuffer->seqToIndex(ackBases[i]);
+				} else {
+					selection.baseIndexes[i] = NSL_UNDEFINED_BUFFER_INDEX;
+				}
+				selection.baseTicks[i] = historyBuffer->getSeqTick(ackBases[i]);
+
+				if (isBaseOutdated(peer, selection.baseIndexes[i], ackBases[i])) {
+					selection.due[i] = true;
+				}
+			}
+		}
+
+		bool ProtocolParser::isBaseOutdated(Peer* peer, int baseIndex, seqNumber base)
+		{
+			if (baseIndex == NSL_UNDEFINED_BUFFER_INDEX) {
+				return true;
+			}
+
+			// few updates of throttled peer span the whole history, base has to last until the next update is acknowledged
+			seqNumber seq = historyBuffer->indexToSeq(historyBuffer->getCurrentSeqIndex());
+			return peer->getUpdateAge(baseIndex) >= NSL_PEER_BUDGET_MAX_SKIPPED_UPDATES
+				|| (seq - base + NSL_SEQ_MODULO) % NSL_SEQ_MODULO + 2 * peer->getPublishedSendInterval() >= NSL_PACKET_BUFFER_SIZE_SERVER;
+		}
+
+		void ProtocolParser::selectObjectsInBudget(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope, const std::vector<NetworkObject*>& ackScope, const std::vector<seqNumber>& ackBases)
+		{
+			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
+			double time = historyBuffer->getTime(currentSeqIndex);
+			unsigned int budget = peer->getPublishedByteBudget();
+
+			// header and end of section are always sent, custom messages may take only their share of budget
+			unsigned int used = 3 * Attribute<seqNumber>::getByteSize() + double64::getByteSize() + 1;
+			used += std::min(getCustomMessagesByteSize(peer), (unsigned int)(NSL_PEER_BUDGET_CUSTOM_MESSAGE_SHARE * budget));
+
+			selection.sent.assign(ackScope.size(), true);
+			selection.created.assign(scope.size(), false);
+			selection.candidates.clear();
+
+			// deletions, snapshots, unchanged objects and objects waiting for too long are sent always
+			for (unsigned int i = 0; i < ackScope.size(); i++) {
+				NetworkObject* o = ackScope[i];
+				int baseIndex = selection.baseIndexes[i];
+				ObjectFlags flags;
+				if (!selection.kept[i]) {
+					flags.action = NSL_OBJECT_FLAG_ACTION_DELETE;
+					used += diffCache.getDiffByteSize(o, baseIndex == NSL_UNDEFINED_BUFFER_INDEX ? currentSeqIndex : baseIndex, flags);
+				} else if (!o->isChangedSinceTick(selection.baseTicks[i])) {
+					used += 1;
+				} else if (baseIndex == NSL_UNDEFINED_BUFFER_INDEX) {
+					unsigned int diffSize = encodeRetainedDiff(selection, o, i);
+					if (diffSize == 0) {
+						used += 1 + o->getObjectClass()->getByteSize();
+					} else if (diffSize == o->getObjectClass()->getAttributeMaskByteSize()) {
+						used += 1;
+					} else {
+						used += 1 + diffSize;
+					}
+				} else if (!selection.due[i]) {
+					// update period of the object is not over, only the flag is sent
+					used += 1;
+					selection.sent[i] = false;
+				} else {
+					unsigned int size;
+					if (selection.keyframe) {
+						size = 1 + o->getObjectClass()->getByteSize();
+					} else {
+						flags.action = NSL_OBJECT_FLAG_ACTION_DIFF;
+						size = diffCache.getDiffByteSize(o, baseIndex, flags);
+					}
+					if (size == 1 || isBaseOutdated(peer, baseIndex, ackBases[i])) {
+						used += size;
+					} else {
+						// the flag is sent anyway
+						used += 1;
+						selection.sent[i] = false;
+						BudgetCandidate candidate;
+						candidate.priority = o->getPublishedPriority() * o->getChangePriority(baseIndex) * (time - historyBuffer->getTime(baseIndex));
+						candidate.size = size - 1;
+						candidate.position = i;
+						candidate.creation = false;
+						selection.candidates.push_back(candidate);
+					}
+				}
+			}
+
+			addCreationCandidates(selection, peer, scope);
+
+			// fill the rest of budget, smaller objects may still fit when bigger ones do not
+			std::sort(selection.candidates.begin(), selection.candidates.end());
+			unsigned int creationUsed = 0;
+			for (std::vector<BudgetCandidate>::iterator it = selection.candidates.begin(); it != selection.candidates.end(); it++) {
+				if (used + it->size > budget) {
+					continue;
+				}
+				if (it->creation) {
+					if (NSL_PEER_CREATION_BYTES != 0 && creationUsed + it->size > NSL_PEER_CREATION_BYTES) {
+						continue;
+					}
+					creationUsed += it->size;
+				}
+				used += it->size;
+				if (it->creation) {
+					selection.created[it->position] = true;
+				} else {
+					selection.sent[it->position] = true;
+				}
+			}
+		}
+
+		void ProtocolParser::addCreationCandidates(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope)
+		{
+			for (unsigned int i = 0; i < scope.size(); i++) {
+				if (selection.added[i]) {
+					BudgetCandidate candidate;
+					candidate.priority = getCreationPriority(peer, scope[i]);
+					candidate.size = getCreationRecordByteSize(scope[i]);
+					candidate.position = i;
+					candidate.creation = true;
+					selection.candidates.push_back(candidate);
+				}
+			}
+		}
+
+		double ProtocolParser::getCreationPriority(Peer* peer, NetworkObject* object)
+		{
+			double position[3];
+			if (!peer->hasPublishedView() || !SpatialGrid::getPosition(object, historyBuffer->getCurrentSeqIndex(), position)) {
+				return object->getPublishedPriority();
+			}
+
+			double* viewPosition = peer->getPublishedViewPosition();
+			double distance = 0;
+			for (unsigned int i = 0; i < 3; i++) {
+				distance += (position[i] - viewPosition[i]) * (position[i] - viewPosition[i]);
+			}
+			return object->getPublishedPriority() / (1 + distance);
+		}
+
+		void ProtocolParser::limitCreations(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope)
+		{
+			if (NSL_PEER_CREATION_BYTES == 0) {
+				return;
+			}
+
+			// sizes are summed first, so peers with few new objects skip the sorting
+			unsigned int size = 0;
+			for (unsigned int i = 0; i < scope.size() && size <= NSL_PEER_CREATION_BYTES; i++) {
+				if (selection.added[i]) {
+					size += getCreationRecordByteSize(scope[i]);
+				}
+			}
+			if (size <= NSL_PEER_CREATION_BYTES) {
+				return;
+			}
+
+			selection.candidates.clear();
+			addCreationCandidates(selection, peer, scope);
+			std::sort(selection.candidates.begin(), selection.candidates.end());
+			selection.created.assign(scope.size(), false);
+			unsigned int used = 0;
+			for (std::vector<BudgetCandidate>::iterator it = selection.candidates.begin(); it != selection.candidates.end(); it++) {
+				if (used + it->size > NSL_PEER_CREATION_BYTES) {
+					continue;
+				}
+				used += it->size;
+				selection.created[it->position] = true;
+			}
+		}
+
+		unsigned int ProtocolParser::encodeRetainedDiff(UpdateSelection& selection, NetworkObject* object, unsigned int position)
+		{
+			if (selection.retainedData == NULL || (*selection.retainedData)[position] == NULL) {
+				return 0;
+			}
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			selection.retainedDiff.resize(objectClass->getAttributeMaskByteSize() + objectClass->getByteSize());
+			return encodeRetainedDiffData(&selection.retainedDiff[0], object, (*selection.retainedData)[position]);
+		}
+
+		bool ProtocolParser::isKeyframe(Peer* peer, int ackIndex)
+		{
+			if (ackIndex == NSL_UNDEFINED_BUFFER_INDEX) {
+				// all objects are created with absolute values anyway
+				return false;
+			}
+
+			// ages are counted in updates of the peer, so throttled peers get diffs as well
+			if (peer->getUpdateAge(ackIndex) >= NSL_KEYFRAME_ACK_AGE) {
+				return true;
+			}
+
+#if NSL_KEYFRAME_INTERVAL > 0
+			// peers are staggered, so the keyframes do not come all at once
+			return (peer->getSentUpdateCount() + peer->getPeerConnection()->connectionId) % NSL_KEYFRAME_INTERVAL == 0;
+#else
+			return false;
+#endif
+		}
+
+		int ProtocolParser::getFirstUnackedIndex(Peer* peer)
+		{
+			if (peer->hasPublishedAck()) {
+				if (!historyBuffer->isSeqInBounds(peer->getPublishedAck())) {
+					// every message in history is unacknowledged, start by the oldest index
+					return historyBuffer->getOldestIndex();
+				}
+				return (historyBuffer->seqToIndex(peer->getPublishedAck()) + 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
+			} else {
+				// the first index may be recycled already (by the game thread, while the update is encoded by the network thread)
+				int firstUpdateIndex = peer->getFirstUpdateIndex();
+				return historyBuffer->isIndexInBounds(firstUpdateIndex) ? firstUpdateIndex : historyBuffer->getOldestIndex();
+			}
+		}
+
+		unsigned int ProtocolParser::getCustomMessagesByteSize(Peer* peer)
+		{
+			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
+			unsigned int size = 0;
+
+			// the same as written by pushBufferedMessagesByIndex
+			for (int index = getFirstUnackedIndex(peer); index != currentSeqIndex; index = (index + 1) % NSL_PACKET_BUFFER_SIZE_SERVER) {
+				const std::vector<std::pair<byte*, unsigned int> >& messages = peer->getBufferedCustomMessages(index);
+				if (!messages.empty()) {
+					size += Attribute<seqNumber>::getByteSize() + Attribute<customMessageSizeNumber>::getByteSize();
+					for (std::vector<std::pair<byte*, unsigned int> >::const_iterator it = messages.begin(); it != messages.end(); it++) {
+						size += Attribute<customMessageSizeNumber>::getByteSize() + it->second;
+					}
+				}
+			}
+
+			std::vector<std::pair<BitStreamWriter*, bool> >& outgoingCustomMessages = peer->getOutgoingCustomMessages();
+			if (!outgoingCustomMessages.empty()) {
+				size += Attribute<seqNumber>::getByteSize() + Attribute<customMessageSizeNumber>::getByteSize();
+				for (std::vector<std::pair<BitStreamWriter*, bool> >::iterator it = outgoingCustomMessages.begin(); it != outgoingCustomMessages.end(); it++) {
+					size += Attribute<customMessageSizeNumber>::getByteSize() + it->first->getByteSize();
+				}
+			}
+			return size;
+		}
+
 		void ProtocolParser::pushBufferedMessagesByIndex(BitStreamWriter* stream, int bufferIndex, Peer* peer)
 		{
-			std::vector<std::pair<byte*, unsigned int> > messages = peer->getBufferedCustomMessages(bufferIndex);
+			const std::vector<std::pair<byte*, unsigned int> >& messages = peer->getBufferedCustomMessages(bufferIndex);
 			if (!messages.empty()) {
 				stream->write<Attribute<seqNumber> >(historyBuffer->indexToSeq(bufferIndex));
-				for(std::vector<std::pair<byte*, unsigned int> >::iterator it = messages.begin(); it != messages.end(); it++) {
+				for(std::vector<std::pair<byte*, unsigned int> >::const_iterator it = messages.begin(); it != messages.end(); it++) {
 					stream->write<Attribute<customMessageSizeNumber> >(it->second);
 					stream->writeRaw(it->second, it->first);
 				}
@@ -170,6 +465,149 @@ namespace nsl {
 			}
 		}
 
+		unsigned int ProtocolParser::encodeDiffData(byte* target, NetworkObject* object, int ackIndex)
+		{
+			SnapshotArena* arena = object->getArena();
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			unsigned int slot = object->getSlot();
+			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
+			unsigned int maskSize = objectClass->getAttributeMaskByteSize();
+			byte* data = target + maskSize;
+
+			// diff of whole class might be already computed
+			SnapshotBlock* preparedDiff = arena->getPreparedDiff(ackIndex);
+
+			// first encode full-width diff behind the mask
+#ifdef NSL_LITTLE_ENDIAN
+			// encoded rows are the same as stored rows
+			bool wholeRow = !arena->isColumnar();
+#else
+			bool wholeRow = false;
+#endif
+			if (wholeRow) {
+				if (preparedDiff != NULL) {
+					memcpy(data, arena->getAttribute(*preparedDiff, slot, 0), objectClass->getByteSize());
+				} else {
+					xorDelta(data, arena->getData(ackIndex, slot), arena->getData(currentSeqIndex, slot), objectClass->getByteSize());
+				}
+			} else {
+				for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+					unsigned int size = objectClass->getAttributeDefinition(i)->size;
+					byte* attributeTarget = data + objectClass->getDataOffset(i);
+					if (!object->isAttributeChangedSince(i, ackIndex)) {
+						// left out of the mask below
+						continue;
+					}
+					if (preparedDiff != NULL) {
+						memcpy(attributeTarget, arena->getAttribute(*preparedDiff, slot, i), size);
+					} else {
+						xorDelta(attributeTarget, arena->getAttribute(ackIndex, slot, i), arena->getAttribute(currentSeqIndex, slot, i), size);
+					}
+#ifdef NSL_BIG_ENDIAN
+					std::reverse(attributeTarget, attributeTarget + size);
+#endif
+				}
+			}
+
+			// then keep only changed attributes, packed right behind the mask
+			// packed data never overtake the attribute being moved, so it can be done in place
+			memset(target, 0, maskSize);
+			unsigned int encodedSize = maskSize;
+			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+				unsigned int size = objectClass->getAttributeDefinition(i)->size;
+				byte* attributeData = data + objectClass->getDataOffset(i);
+				if (!object->isAttributeChangedSince(i, ackIndex) || isZeroDelta(attributeData, size)) {
+					continue;
+				}
+				target[i / 8] |= 1 << (i % 8);
+				memmove(target + encodedSize, attributeData, size);
+				encodedSize += size;
+			}
+			return encodedSize;
+		}
+
+		void ProtocolParser::writeCreationRecord(BitStreamWriter* stream, NetworkObject* object)
+		{
+			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
+			ObjectFlags flags;
+			flags.action = NSL_OBJECT_FLAG_ACTION_CREATE;
+			if (object->getCreationIndex() == currentSeqIndex) {
+				flags.scopeCreate = NSL_OBJECT_FLAG_SC_BIRTH;
+			} else {
+				flags.scopeCreate = NSL_OBJECT_FLAG_SC_SHOW;
+			}
+
+			// add custom message if there is some bound
+			byte* creationCustomMessage = NULL;
+			unsigned int creationCustomMessageSize;
+			if (object->getCreationCustomMessage(creationCustomMessage, creationCustomMessageSize)) {
+				flags.creationCustomMessage = NSL_OBJECT_FLAG_CM_PRESENT;
+			} else {
+				flags.creationCustomMessage = NSL_OBJECT_FLAG_CM_EMPTY;
+			}
+
+			*stream << flags;
+			stream->write<uint16>(object->getObjectClass()->getId());
+			stream->write<uint32>(object->getId());
+
+			if (creationCustomMessage != NULL) {
+				stream->write<Attribute<customMessageSizeNumber> >(creationCustomMessageSize);
+				stream->writeRaw(creationCustomMessageSize, creationCustomMessage);
+			}
+
+			writeArenaData(stream, object, object->getArena()->getBlock(currentSeqIndex));
+		}
+
+		unsigned int ProtocolParser::getCreationRecordByteSize(NetworkObject* object)
+		{
+			// flags, class id and object id
+			unsigned int size = 1 + uint16::getByteSize() + uint32::getByteSize() + object->getObjectClass()->getByteSize();
+
+			byte* creationCustomMessage;
+			unsigned int creationCustomMessageSize;
+			if (object->getCreationCustomMessage(creationCustomMessage, creationCustomMessageSize)) {
+				size += Attribute<customMessageSizeNumber>::getByteSize() + creationCustomMessageSize;
+			}
+			return size;
+		}
+
+		unsigned int ProtocolParser::encodeRetainedDiffData(byte* target, NetworkObject* object, byte* retainedData)
+		{
+			SnapshotArena* arena = object->getArena();
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			unsigned int slot = object->getSlot();
+			int currentSeqIndex = historyBuffer->getCurrentSeqIndex();
+			unsigned int maskSize = objectClass->getAttributeMaskByteSize();
+
+			// changed attributes are packed right behind the mask, unchanged ones are overwritten by the next one
+			memset(target, 0, maskSize);
+			unsigned int encodedSize = maskSize;
+			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+				unsigned int size = objectClass->getAttributeDefinition(i)->size;
+				byte* attributeTarget = target + encodedSize;
+				xorDelta(attributeTarget, retainedData + objectClass->getDataOffset(i), arena->getAttribute(currentSeqIndex, slot, i), size);
+				if (isZeroDelta(attributeTarget, size)) {
+					continue;
+				}
+#ifdef NSL_BIG_ENDIAN
+				std::reverse(attributeTarget, attributeTarget + size);
+#endif
+				target[i / 8] |= 1 << (i % 8);
+				encodedSize += size;
+			}
+			return encodedSize;
+		}
+
+		void ProtocolParser::writeArenaData(BitStreamWriter* stream, NetworkObject* object, SnapshotBlock& block)
+		{
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			SnapshotArena* arena = object->getArena();
+			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+				int size = objectClass->getAttributeDefinition(i)->size;
+				stream->write(size, arena->getAttribute(block, object->getSlot(), i));
+			}
+		}
+
 		void ProtocolParser::writeObjectData(ObjectClassDefinition* objectClass, BitStreamWriter* stream, byte* data)
 		{
 			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
@@ -14,12 +14,15 @@ namespace nsl {
 		class Peer;
 		class HistoryBuffer;
 		class NetworkObject;
+		struct UpdateSelection;
 	};
 };
 
 #include <map>
-#include <set>
+#include <vector>
 #include "../configuration.h"
+#include "DiffCache.h"
+#include "SnapshotArena.h"
 
 namespace nsl {
 	namespace server {
@@ -27,14 +30,74 @@ namespace nsl {
 		{
 		private:
 			HistoryBuffer* historyBuffer;
+			DiffCache diffCache;
+
+			/// Find kept, removed and added objects, bases of kept objects and whether their update period is over
+			void mergeScopes(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope, const std::vector<NetworkObject*>& ackScope, const std::vector<seqNumber>& ackBases, const std::vector<char>* due);
+
+			/// Object with base this old is sent regardless of budget and relevance, so lost updates do not let its base leave the history
+			/// Age is counted in updates of the peer, so throttled peers are not sent all objects every time
+			bool isBaseOutdated(Peer* peer, int baseIndex, seqNumber base);
+
+			/// Choose objects to be updated and created, so the update fits into peer byte budget
+			void selectObjectsInBudget(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope, const std::vector<NetworkObject*>& ackScope, const std::vector<seqNumber>& ackBases);
+
+			/// Encode diff of object at given position in retained scope into selection, return its size or 0 if no data are retained for it
+			unsigned int encodeRetainedDiff(UpdateSelection& selection, NetworkObject* object, unsigned int position);
+
+			/// Add objects new in scope to budget candidates, with their creation priority
+			void addCreationCandidates(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope);
+
+			/// Weight of object not known to the client yet, objects nearer to the view of peer are created first
+			double getCreationPriority(Peer* peer, NetworkObject* object);
+
+			/// Leave out creations over NSL_PEER_CREATION_BYTES (objects are created in later updates), when the peer has no budget
+			void limitCreations(UpdateSelection& selection, Peer* peer, const std::vector<NetworkObject*>& scope);
+
+			/// Should kept objects be sent by absolute values instead of diffs?
+			/// It happens periodically and for peers with old ack
+			bool isKeyframe(Peer* peer, int ackIndex);
+
+			/// First buffer index with custom messages not acknowledged by peer
+			int getFirstUnackedIndex(Peer* peer);
+
+			/// Size of all custom messages, which will be sent in the current update
+			unsigned int getCustomMessagesByteSize(Peer* peer);
 		public:
 			ProtocolParser(HistoryBuffer* historyBuffer);
 			~ProtocolParser(void);
 
+			/// Forget encoded object records shared among peers, must be called before peer updates of a new flush are written
+			void invalidateCache(void);
+
 			/// Append all custom messages from given index
 			void pushBufferedMessagesByIndex(BitStreamWriter* stream, int bufferIndex, Peer* peer);
-			void writeUpdateToPeer(BitStreamWriter* stream, Peer* peer, std::set<NetworkObject*>& scope, int ackIndex);
+
+			/// Write update of objects in scope, which must be ordered by id (see NetworkObject::compareIds)
+			/// If peer has byte budget, objects which do not fit are left out (created later or sent as NO_CHANGE)
+			/// Creation records take at most NSL_PEER_CREATION_BYTES, so the world is streamed to joining peers over more updates
+			/// Without ackIndex (first update or resynchronization), all objects are created
+			/// unless the peer has a retained scope, which is used as the ack then and changed objects are diffed against its data (see Peer::retainScope)
+			/// If due is given (by position in scope), changed objects which are not due are sent as SKIP
+			void writeUpdateToPeer(BitStreamWriter* stream, Peer* peer, const std::vector<NetworkObject*>& scope, int ackIndex, const std::vector<char>* due = NULL);
 			void writeObjectData(ObjectClassDefinition* objectClass, BitStreamWriter* stream, byte* data);
+
+			/// Write data of object's slot in given arena block (history data or prepared diff)
+			void writeArenaData(BitStreamWriter* stream, NetworkObject* object, SnapshotBlock& block);
+
+			/// Encode current object data XORed with its data at ackIndex into target buffer
+			/// of attribute mask byte size + object byte size, return the size of encoded record.
+			/// Record is a mask of changed attributes (bit i of byte i/8 for attrId i) followed by
+			/// XORed data of changed attributes only, each encoded the same way as by writeObjectData
+			unsigned int encodeDiffData(byte* target, NetworkObject* object, int ackIndex);
+
+			/// Encode current object data XORed with data retained by peer (see Peer::retainScope) the same way as encodeDiffData,
+			/// attributes are not tracked beyond the history, so all of them are compared
+			unsigned int encodeRetainedDiffData(byte* target, NetworkObject* object, byte* retainedData);
+
+			/// Write creation record of object (flags, class, id, creation custom message and current data)
+			void writeCreationRecord(BitStreamWriter* stream, NetworkObject* object);
+			unsigned int getCreationRecordByteSize(NetworkObject* object);
 		};
 	};
 };
\ No newline at end of file
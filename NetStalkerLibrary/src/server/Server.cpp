@@ -56,6 +56,51 @@ namespace nsl {
 		i->flushNetwork();
 	}
 
+	FlushHandle Server::flushNetworkAsync(void)
+	{
+		return i->flushNetworkAsync();
+	}
+
+	bool Server::isFlushFinished(FlushHandle flush)
+	{
+		return i->isFlushFinished(flush);
+	}
+
+	void Server::waitForFlush(FlushHandle flush)
+	{
+		i->waitForFlush(flush);
+	}
+
+	void Server::setFlushExecutor(Executor* executor)
+	{
+		i->setFlushExecutor(executor);
+	}
+
+	void Server::setFlushThreadCount(unsigned int threadCount)
+	{
+		i->setFlushThreadCount(threadCount);
+	}
+
+	void Server::setNetworkThread(bool enabled)
+	{
+		i->setNetworkThread(enabled);
+	}
+
+	void Server::setConcurrentMutation(bool enabled)
+	{
+		i->setConcurrentMutation(enabled);
+	}
+
+	void Server::setMtu(unsigned int mtu)
+	{
+		i->setMtu(mtu);
+	}
+
+	FragmentationStats Server::getFragmentationStats(void)
+	{
+		return i->getFragmentationStats();
+	}
+
 	void Server::updateNetwork(double time)
 	{
 		i->updateNetwork(time);
@@ -85,6 +130,21 @@ namespace nsl {
 		return false;
 	}
 
+	void Server::setScopeCellSize(double cellSize)
+	{
+		i->setScopeCellSize(cellSize);
+	}
+
+	void Server::setUpdateRelevance(bool enabled)
+	{
+		i->setUpdateRelevance(enabled);
+	}
+
+	double Server::getRelevance(nsl::Peer* peer, ServerObject* object)
+	{
+		return i->getViewRelevance(peer, object);
+	}
+
 	void Server::addToScope(ServerObject* object)
 	{
 		i->addToScope(object);
@@ -9,20 +9,46 @@
 #include "../../include/nslServer.h"
 #include "NetworkObject.h"
 #include "../ObjectClassDefinition.h"
+#include "../ThreadPool.h"
+#include <algorithm>
+#include <math.h>
 
 namespace nsl {
 	namespace server {
 
+		/// number of peer updates between updates of object with given relevance, power of two
+		static unsigned int getUpdatePeriod(double relevance)
+		{
+			unsigned int period = 1;
+			while (period < NSL_MAX_UPDATE_PERIOD && period * relevance < 1) {
+				period *= 2;
+			}
+			return period;
+		}
+
 		ServerImpl::ServerImpl(Server* userObject, unsigned int applicationId)
-			: userObject(userObject), connection(applicationId), protocolParser(&historyBuffer)
+			: userObject(userObject), connection(applicationId), protocolParser(&publishedHistoryBuffer)
 		{
 			currentScopeAccessible = false;
+			relevanceEnabled = false;
 			lastUpdateTime = 0;
+			flushExecutor = NULL;
+			threadPool = NULL;
+			networkThreadEnabled = false;
+			networkWorkPending = false;
+			networkStopping = false;
+			publishedUpdateCount = 0;
+			lastAsyncFlush = 0;
+			networkCompressBuffer = NULL;
+			networkErrorCode = 0;
+			networkErrorMessage = NULL;
 		}
 
 		ServerImpl::~ServerImpl(void)
 		{
 			close();
+			setFlushExecutor(NULL);
+			delete[] networkCompressBuffer;
 		}
 
 		void ServerImpl::open(const char* port)
@@ -32,6 +58,12 @@ namespace nsl {
 
 		void ServerImpl::close(void)
 		{
+			if (networkThread.isRunning()) {
+				stopNetworkThread();
+
+				// errors of updates sent before closing do not matter anymore
+				networkErrorCode = 0;
+			}
 			connection.close();
 		}
 
@@ -43,14 +75,25 @@ namespace nsl {
 			objectManager.registerObjectClass(objectClass);
 		}
 
-		NetworkObject* ServerImpl::createObject(unsigned int classId)
+		NetworkObject* ServerImpl::createObjectLocked(unsigned int classId)
 		{
+			if (objectManager.isArenaFull(classId)) {
+				// growing adds a page to all history indexes, including those read by the network thread
+				waitForNetworkThread();
+			}
 			return objectManager.createObject(classId, &historyBuffer);
 		}
 
+		NetworkObject* ServerImpl::createObject(unsigned int classId)
+		{
+			MutexGuard guard(creationLock);
+			return createObjectLocked(classId);
+		}
+
 		NetworkObject* ServerImpl::createObject(unsigned int classId, BitStreamWriter*& creationMetaData)
 		{
-			NetworkObject* o = objectManager.createObject(classId, &historyBuffer);
+			MutexGuard guard(creationLock);
+			NetworkObject* o = createObjectLocked(classId);
 			creationMetaData = new BitStreamWriter(NSL_MAX_CUSTOM_MESSAGE_SIZE, true);
 			unproccessedCreationCustomMessages.insert(std::pair<unsigned int, BitStreamWriter*>(o->getId(), creationMetaData));
 			return o;
@@ -92,6 +135,7 @@ namespace nsl {
 						Peer* oldPeer = it->second;
 						userObject->onClientDisconnect(oldPeer->getUserObject());
 						connectedPeers.erase(it);
+						waitForNetworkThread();
 						delete oldPeer;
 						delete stream;
 						break;
@@ -135,6 +179,14 @@ namespace nsl {
 						delete stream;
 						break;
 					}
+					case PEER_RESUME:
+					{
+						// the peer keeps its state, updates are sent to the new address
+						waitForNetworkThread();
+						connection.resume(peer, currentTime);
+						delete stream;
+						break;
+					}
 				}
 			}
 
@@ -144,6 +196,7 @@ namespace nsl {
 				Peer* oldPeer = it->second;
 				userObject->onClientDisconnect(oldPeer->getUserObject());
 				connectedPeers.erase(it);
+				waitForNetworkThread();
 				delete oldPeer;
 			}
 
@@ -162,12 +215,45 @@ namespace nsl {
 			if (object->networkObject->getDestroyIndex() != NSL_UNDEFINED_BUFFER_INDEX) {
 				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to add already destroyed object to scope");
 			} else {
-				currentScope.insert(object->networkObject);
+				currentScope.push_back(object->networkObject);
 			}
 		}
 
-		void ServerImpl::flushNetwork(void)
+		void ServerImpl::setScopeCellSize(double cellSize)
+		{
+			objectManager.getSpatialGrid()->setCellSize(cellSize);
+		}
+
+		double ServerImpl::getViewRelevance(nsl::Peer* userPeer, ServerObject* object)
 		{
+			Peer* peer = userPeer->peer;
+			double position[3];
+			if (!peer->hasView() || !objectManager.getSpatialGrid()->getPosition(object->networkObject, historyBuffer.getCurrentSeqIndex(), position)) {
+				return 1;
+			}
+
+			double* viewPosition = peer->getViewPosition();
+			double distance = 0;
+			for (unsigned int i = 0; i < 3; i++) {
+				distance += (position[i] - viewPosition[i]) * (position[i] - viewPosition[i]);
+			}
+			distance = sqrt(distance);
+
+			double fullRateDistance = NSL_RELEVANCE_FULL_RATE_DISTANCE * peer->getViewRadius();
+			return distance <= fullRateDistance ? 1 : fullRateDistance / distance;
+		}
+
+		FlushHandle ServerImpl::flushNetworkAsync(void)
+		{
+			flushNetwork(true);
+			return lastAsyncFlush;
+		}
+
+		void ServerImpl::flushNetwork(bool async)
+		{
+			// updates of the previous flush must be sent before they are prepared again
+			waitForNetworkThread();
+
 			// process object creation metadata custom messages
 			for (std::map<unsigned int, BitStreamWriter*>::iterator it = unproccessedCreationCustomMessages.begin();
 				it != unproccessedCreationCustomMessages.end(); it++) {
@@ -177,7 +263,26 @@ namespace nsl {
 			}
 			unproccessedCreationCustomMessages.clear();
 
-			// send updates for every connected peer
+			// objects destroyed from more threads leave the grid now
+			objectManager.mergeConcurrentChanges();
+
+			// only objects moved since the last flush change their cells
+			objectManager.updateSpatialGrid(historyBuffer.getCurrentSeqIndex());
+
+			// updates are encoded by a copy of the history buffer, so the game thread can add seqs meanwhile
+			// the oldest index is cleared by the next updateNetwork(), so the network thread must not use it
+			publishedHistoryBuffer = historyBuffer;
+			publishedHistoryBuffer.setReservedIndexCount(async ? 1 : 0);
+
+			// changes of objects held back while the last update was encoded are seen by this one,
+			// the next changes are held back until the next flush, if this update is encoded by the network thread
+			objectManager.publishChanges();
+			objectManager.setHoldingChanges(async);
+
+			// prepare updates for every connected peer
+			// user callbacks are called only from this thread
+			peerUpdates.resize(connectedPeers.size());
+			unsigned int updateCount = 0;
 			std::map<unsigned int, Peer*>::iterator it = connectedPeers.begin();
 			while(it != connectedPeers.end()) {
 
@@ -186,48 +291,296 @@ namespace nsl {
 
 				if (peer->hasAck()) {
 					seqNumber ack = peer->getLastAck();
-					if (!historyBuffer.isSeqInBounds(ack)) {
+					if (publishedHistoryBuffer.isSeqInBounds(ack)) {
+						ackIndex = publishedHistoryBuffer.seqToIndex(ack);
+						peer->releaseRetainedScope();
+					} else if (!peer->hasLostCustomMessages()) {
+						// server does not know what peer has, so it is resynchronized by its retained scope or by self-contained update (like the first one)
+						ackIndex = NSL_UNDEFINED_BUFFER_INDEX;
+					} else {
+						// reliable messages cannot be delivered anymore
 						userObject->onClientDisconnect(peer->getUserObject());
 						connectedPeers.erase(it++);
+						connection.disconnect(peer->getPeerConnection());
 						delete peer;
 						continue;
 					}
-
-					ackIndex = historyBuffer.seqToIndex(ack);
 				} else {
 					ackIndex = NSL_UNDEFINED_BUFFER_INDEX;
-					if (peer->getFirstUpdateIndex() == NSL_UNDEFINED_BUFFER_INDEX) {
-						peer->setFirstUpdateIndex(historyBuffer.getCurrentSeqIndex());
-					}
+				}
+
+				// suspended peer waits for its client to resume the session
+				if (peer->getPeerConnection()->suspended) {
+					it++;
+					continue;
+				}
+
+				// throttled peer waits, its next update is diffed against its ack, which stays in the history
+				if (!peer->isUpdateDue(ackIndex)) {
+					it++;
+					continue;
+				}
+
+				if (!peer->hasAck() && peer->getFirstUpdateIndex() == NSL_UNDEFINED_BUFFER_INDEX) {
+					peer->setFirstUpdateIndex(historyBuffer.getCurrentSeqIndex());
 				}
 
 				currentScopeAccessible = true;
 				if (!userObject->getScope(peer->getUserObject())) {
 					
-					// send all objects
 					currentScope.clear();
-					for (std::map<unsigned int, NetworkObject*>::iterator it2 = objectManager.objectsBegin(); it2 != objectManager.objectsEnd(); it2++) {
-						if (it2->second->getDestroyIndex() == NSL_UNDEFINED_BUFFER_INDEX) {
-							currentScope.insert(it2->second);
+					if (peer->hasView()) {
+						// send objects around peer's view
+						objectManager.getSpatialGrid()->query(peer->getViewPosition(), peer->getViewRadius(), historyBuffer.getCurrentSeqIndex(), currentScope);
+					} else {
+						// send all objects
+						// slots are visited in order, so the scope is ordered already
+						for (unsigned int i = 0; i < objectManager.getObjectSlotCount(); i++) {
+							NetworkObject* o = objectManager.getObjectBySlot(i);
+							if (o != NULL && o->getDestroyIndex() == NSL_UNDEFINED_BUFFER_INDEX) {
+								currentScope.push_back(o);
+							}
 						}
 					}
-
 				}
 				currentScopeAccessible = false;
 
-				Packet* p = connection.createPacket(peer->getPeerConnection());
-				protocolParser.writeUpdateToPeer(p->getStream(), peer, currentScope, ackIndex);
-				p->send();
+				// scopes built by user or by view need sorting and removal of duplicates
+				for (unsigned int i = 1; i < currentScope.size(); i++) {
+					if (!NetworkObject::compareIds(currentScope[i-1], currentScope[i])) {
+						std::sort(currentScope.begin(), currentScope.end(), NetworkObject::compareIds);
+						currentScope.erase(std::unique(currentScope.begin(), currentScope.end()), currentScope.end());
+						break;
+					}
+				}
 
+				PeerUpdate& update = peerUpdates[updateCount++];
+				update.due.clear();
+				if (relevanceEnabled) {
+					// objects with the same period are spread over its updates by their ids
+					unsigned int updateOrdinal = peer->getSentUpdateCount() + 1;
+					for (std::vector<NetworkObject*>::iterator object = currentScope.begin(); object != currentScope.end(); object++) {
+						unsigned int period = getUpdatePeriod(userObject->getRelevance(peer->getUserObject(), (*object)->getUserObject()));
+						update.due.push_back((updateOrdinal + (*object)->getId()) % period == 0);
+					}
+				}
+				update.peer = peer;
+				update.ackIndex = ackIndex;
+				update.scope.swap(currentScope);
 				currentScope.clear();
+				peer->publish();
+				peer->setUpdateSent(historyBuffer.getCurrentSeqIndex());
 				it++;
 			}
 
-			
+			if (async) {
+				if (!networkThread.isRunning()) {
+					startNetworkThread();
+				}
+				MutexGuard guard(networkLock);
+				lastAsyncFlush++;
+				publishedUpdateCount = updateCount;
+				networkWorkPending = true;
+				networkWorkReady.notifyOne();
+			} else {
+				sendPeerUpdates(updateCount, NULL);
+			}
 
 			// TODO: lock server objects
 		}
 
+		void ServerImpl::sendPeerUpdates(unsigned int updateCount, byte* compressBuffer)
+		{
+			protocolParser.invalidateCache();
+			objectManager.invalidateDiffs();
+			ackIndexes.clear();
+			for (unsigned int i = 0; i < updateCount; i++) {
+				int ackIndex = peerUpdates[i].ackIndex;
+				if (ackIndex != NSL_UNDEFINED_BUFFER_INDEX && std::find(ackIndexes.begin(), ackIndexes.end(), ackIndex) == ackIndexes.end()) {
+					ackIndexes.push_back(ackIndex);
+				}
+			}
+			objectManager.prepareDiffs(ackIndexes, publishedHistoryBuffer.getCurrentSeqIndex());
+			if (flushExecutor == NULL || updateCount <= NSL_FLUSH_PEERS_PER_JOB) {
+				for (unsigned int i = 0; i < updateCount; i++) {
+					sendPeerUpdate(peerUpdates[i], compressBuffer);
+				}
+			} else {
+				unsigned int jobCount = (updateCount + NSL_FLUSH_PEERS_PER_JOB - 1) / NSL_FLUSH_PEERS_PER_JOB;
+				while (flushJobs.size() < jobCount) {
+					FlushJob job;
+					job.compressBuffer = new byte[NSL_MAX_UDP_PACKET_SIZE];
+					flushJobs.push_back(job);
+				}
+				for (unsigned int i = 0; i < jobCount; i++) {
+					flushJobs[i].firstUpdate = i * NSL_FLUSH_PEERS_PER_JOB;
+					flushJobs[i].lastUpdate = std::min((i + 1) * NSL_FLUSH_PEERS_PER_JOB, updateCount);
+					flushJobs[i].errorCode = 0;
+					flushJobs[i].errorMessage = NULL;
+				}
+
+				flushExecutor->execute(&ServerImpl::flushJob, this, jobCount);
+
+				for (unsigned int i = 0; i < jobCount; i++) {
+					if (flushJobs[i].errorCode != 0) {
+						throw Exception(flushJobs[i].errorCode, flushJobs[i].errorMessage);
+					}
+				}
+			}
+		}
+
+		void ServerImpl::sendPeerUpdate(PeerUpdate& update, byte* compressBuffer)
+		{
+			Packet* p = connection.createPacket(update.peer->getPeerConnection());
+			protocolParser.writeUpdateToPeer(p->getStream(), update.peer, update.scope, update.ackIndex, &update.due);
+			p->send(compressBuffer);
+			delete p;
+			update.scope.clear();
+		}
+
+		void ServerImpl::flushJob(void* context, unsigned int jobIndex)
+		{
+			ServerImpl* server = (ServerImpl*)context;
+			FlushJob& job = server->flushJobs[jobIndex];
+
+			try {
+				for (unsigned int i = job.firstUpdate; i < job.lastUpdate; i++) {
+					server->sendPeerUpdate(server->peerUpdates[i], job.compressBuffer);
+				}
+			} catch (Exception& e) {
+				job.errorCode = e.getCode();
+				job.errorMessage = e.what();
+			} catch (...) {
+				job.errorCode = NSL_EXCEPTION_LIBRARY_ERROR;
+				job.errorMessage = "NSL: unexpected error while sending peer update";
+			}
+		}
+
+		void ServerImpl::networkLoop(void* context)
+		{
+			ServerImpl* server = (ServerImpl*)context;
+
+			server->networkLock.lock();
+			while (true) {
+				while (!server->networkWorkPending && !server->networkStopping) {
+					server->networkWorkReady.wait(server->networkLock);
+				}
+				if (!server->networkWorkPending) {
+					break;
+				}
+				server->networkLock.unlock();
+
+				int errorCode = 0;
+				const char* errorMessage = NULL;
+				try {
+					server->sendPeerUpdates(server->publishedUpdateCount, server->networkCompressBuffer);
+				} catch (Exception& e) {
+					errorCode = e.getCode();
+					errorMessage = e.what();
+				} catch (...) {
+					errorCode = NSL_EXCEPTION_LIBRARY_ERROR;
+					errorMessage = "NSL: unexpected error while sending peer updates";
+				}
+
+				server->networkLock.lock();
+				server->networkErrorCode = errorCode;
+				server->networkErrorMessage = errorMessage;
+				server->networkWorkPending = false;
+				server->networkWorkDone.notifyAll();
+			}
+			server->networkLock.unlock();
+		}
+
+		void ServerImpl::waitForNetworkThread(void)
+		{
+			MutexGuard guard(networkLock);
+			while (networkWorkPending) {
+				networkWorkDone.wait(networkLock);
+			}
+			if (networkErrorCode != 0) {
+				int errorCode = networkErrorCode;
+				networkErrorCode = 0;
+				throw Exception(errorCode, networkErrorMessage);
+			}
+		}
+
+		bool ServerImpl::isFlushFinished(FlushHandle flush)
+		{
+			MutexGuard guard(networkLock);
+			return !networkWorkPending || flush != lastAsyncFlush;
+		}
+
+		void ServerImpl::waitForFlush(FlushHandle flush)
+		{
+			MutexGuard guard(networkLock);
+			while (networkWorkPending && flush == lastAsyncFlush) {
+				networkWorkDone.wait(networkLock);
+			}
+			if (networkErrorCode != 0) {
+				int errorCode = networkErrorCode;
+				networkErrorCode = 0;
+				throw Exception(errorCode, networkErrorMessage);
+			}
+		}
+
+		void ServerImpl::startNetworkThread(void)
+		{
+			if (networkCompressBuffer == NULL) {
+				networkCompressBuffer = new byte[NSL_MAX_UDP_PACKET_SIZE];
+			}
+			networkStopping = false;
+			networkThread.start(&ServerImpl::networkLoop, this);
+		}
+
+		void ServerImpl::stopNetworkThread(void)
+		{
+			networkLock.lock();
+			networkStopping = true;
+			networkWorkReady.notifyOne();
+			networkLock.unlock();
+			networkThread.join();
+		}
+
+		void ServerImpl::setNetworkThread(bool enabled)
+		{
+			networkThreadEnabled = enabled;
+			if (enabled && !networkThread.isRunning()) {
+				startNetworkThread();
+			} else if (!enabled && networkThread.isRunning()) {
+				stopNetworkThread();
+				waitForNetworkThread();
+			}
+		}
+
+		void ServerImpl::setFlushExecutor(Executor* executor)
+		{
+			// executor may be used by the network thread right now
+			waitForNetworkThread();
+
+			if (threadPool != NULL) {
+				delete threadPool;
+				threadPool = NULL;
+			}
+			flushExecutor = executor;
+
+			if (executor == NULL) {
+				for (std::vector<FlushJob>::iterator it = flushJobs.begin(); it != flushJobs.end(); it++) {
+					delete[] it->compressBuffer;
+				}
+				flushJobs.clear();
+			}
+		}
+
+		void ServerImpl::setFlushThreadCount(unsigned int threadCount)
+		{
+			setFlushExecutor(NULL);
+			if (threadCount > 1) {
+				// calling thread works on the jobs as well
+				threadPool = new ThreadPool(threadCount - 1);
+				flushExecutor = threadPool;
+			}
+		}
+
 		BitStreamWriter* ServerImpl::createCustomMessage(nsl::Peer* peer, bool reliable)
 		{
 			/*std::map<unsigned int, Peer*>::iterator it = connectedPeers.find(peer);
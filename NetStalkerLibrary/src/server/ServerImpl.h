@@ -12,6 +12,7 @@ namespace nsl {
 	class ObjectClassDefinition;
 	class BitStreamWriter;
 	class Peer;
+	class ThreadPool;
 
 	namespace server {
 		class NetworkObject;
@@ -19,30 +20,103 @@ namespace nsl {
 	};
 };
 		
+#include "../../include/nslServer.h"
 #include "Connection.h"
 #include "ObjectManager.h"
 #include "HistoryBuffer.h"
 #include "ProtocolParser.h"
+#include "../Thread.h"
 #include <map>
-#include <set>
+#include <vector>
 
 namespace nsl {
 	namespace server {
 
+		/// Everything needed to encode and send an update to one peer.
+		/// Prepared by flushNetwork() on the calling thread, so the encoding can run in parallel.
+		struct PeerUpdate
+		{
+			Peer* peer;
+			int ackIndex;
+			std::vector<NetworkObject*> scope;	// ordered by id
+			std::vector<char> due;				// by position in scope, is the update period of the object over? empty if relevance is not used
+		};
+
+		/// Group of peer updates processed by one job of parallel flushNetwork()
+		struct FlushJob
+		{
+			unsigned int firstUpdate;
+			unsigned int lastUpdate;	// exclusive
+			byte* compressBuffer;
+			int errorCode;				// 0 if no exception was thrown
+			const char* errorMessage;
+		};
+
 		class ServerImpl
 		{
 		private:
 			Connection connection;
 			ObjectManager objectManager;
 			HistoryBuffer historyBuffer;
+			HistoryBuffer publishedHistoryBuffer;	// copy of historyBuffer taken by flushNetwork(), updates are encoded by it
 			ProtocolParser protocolParser;
 			Server* userObject;
 			bool opened;
 			double lastUpdateTime;
 			std::map<unsigned int, Peer*> connectedPeers;
 			std::map<unsigned int, BitStreamWriter*> unproccessedCreationCustomMessages;
-			std::set<NetworkObject*> currentScope;
+			std::vector<NetworkObject*> currentScope;
 			bool currentScopeAccessible;
+			bool relevanceEnabled;
+			Executor* flushExecutor;
+			ThreadPool* threadPool;
+			std::vector<PeerUpdate> peerUpdates;
+			std::vector<FlushJob> flushJobs;
+			std::vector<int> ackIndexes;		// distinct ack indexes of peers in current flush
+
+			// network thread, which sends peer updates prepared by flushNetwork() while the game thread goes on
+			bool networkThreadEnabled;			// are all flushes asynchronous?
+			Thread networkThread;
+			Mutex networkLock;
+			Condition networkWorkReady;
+			Condition networkWorkDone;
+			bool networkWorkPending;			// peer updates are published and not sent yet
+			bool networkStopping;
+			unsigned int publishedUpdateCount;
+			FlushHandle lastAsyncFlush;			// handle of the last flush published for the network thread
+			byte* networkCompressBuffer;
+			int networkErrorCode;				// 0 if no exception was thrown
+			const char* networkErrorMessage;
+
+			Mutex creationLock;					// objects may be created from more threads in concurrent mutation mode
+
+			/// encode, compress and send update to one peer
+			/// if compressBuffer is NULL, shared connection buffer is used
+			void sendPeerUpdate(PeerUpdate& update, byte* compressBuffer);
+
+			/// encode, compress and send the first updateCount peer updates, possibly in parallel
+			void sendPeerUpdates(unsigned int updateCount, byte* compressBuffer);
+
+			/// create object, creation lock must be held by the caller
+			NetworkObject* createObjectLocked(unsigned int classId);
+
+			/// Executor job of parallel flushNetwork(), context is ServerImpl
+			static void flushJob(void* context, unsigned int jobIndex);
+
+			/// Thread function of the network thread, context is ServerImpl
+			static void networkLoop(void* context);
+
+			/// block until published peer updates are sent, so the game thread can change what they use
+			/// error of the network thread is thrown here
+			void waitForNetworkThread(void);
+
+			void startNetworkThread(void);
+
+			/// published updates are sent before the thread ends, their error is kept for waitForNetworkThread
+			void stopNetworkThread(void);
+
+			/// prepare updates of all peers, send them right away or let the network thread send them
+			void flushNetwork(bool async);
 		public:
 			ServerImpl(Server* userObject, unsigned int applicationId);
 			~ServerImpl(void);
@@ -71,8 +145,41 @@ namespace nsl {
 			/// if current scope is null, exception is thrown
 			void addToScope(ServerObject* object);
 
+			/// set edge length of spatial grid cells used for scope of peers with a view
+			void setScopeCellSize(double cellSize);
+
+			/// update objects in peer scopes as often as their relevance says (see Server::getRelevance)
+			void setUpdateRelevance(bool enabled) {relevanceEnabled = enabled;}
+
+			/// relevance by distance from peer's view, 1 for peers without view and objects without position
+			double getViewRelevance(nsl::Peer* peer, ServerObject* object);
+
 			// send updates to all connected clients
-			void flushNetwork(void);
+			void flushNetwork(void) {flushNetwork(networkThreadEnabled);}
+
+			/// prepare updates and let the network thread send them, the handle identifies this flush
+			FlushHandle flushNetworkAsync(void);
+
+			/// have all updates of the flush been sent?
+			bool isFlushFinished(FlushHandle flush);
+
+			/// block until all updates of the flush are sent, throw its error
+			void waitForFlush(FlushHandle flush);
+
+			/// spread encoding and sending of peer updates over given executor, NULL means serial flush
+			void setFlushExecutor(Executor* executor);
+
+			/// spread encoding and sending of peer updates over library owned threads, 0 or 1 means serial flush
+			void setFlushThreadCount(unsigned int threadCount);
+
+			/// send peer updates from library owned thread, so flushNetwork() returns once the updates are prepared
+			void setNetworkThread(bool enabled);
+
+			/// let objects be created, set and destroyed from more threads between updateNetwork() and flushNetwork()
+			void setConcurrentMutation(bool enabled) {objectManager.setConcurrent(enabled);}
+
+			void setMtu(unsigned int mtu) {connection.setMtu(mtu);}
+			FragmentationStats getFragmentationStats(void) {return connection.getFragmentationStats();}
 		};
 	};
 };
@@ -44,6 +44,17 @@ namespace nsl {
 		networkObject->set(attrId, byteSize, value);
 	}
 
+	void ServerObject::setPriority(double weight)
+	{
+		if (networkObject->getDestroyIndex() != NSL_UNDEFINED_BUFFER_INDEX) {
+			throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: trying to work with inaccessible object.");
+		}
+		if (weight < 0) {
+			throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: object priority cannot be negative");
+		}
+		networkObject->setPriority(weight);
+	}
+
 	void ServerObject::destroy(void)
 	{
 		if (networkObject->getDestroyIndex() != NSL_UNDEFINED_BUFFER_INDEX) {
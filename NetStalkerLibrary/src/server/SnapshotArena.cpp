@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "SnapshotArena.h"
+#include "../ObjectClassDefinition.h"
+#include "../delta/delta.h"
+#include <string.h>
+
+namespace nsl {
+	namespace server {
+
+		SnapshotArena::SnapshotArena(ObjectClassDefinition* objectClass, unsigned int pageSlots)
+			: objectClass(objectClass)
+		{
+			objectByteSize = objectClass->getByteSize();
+			columnar = objectClass->isColumnar();
+			this->pageSlots = pageSlots > 0 ? pageSlots : 1;
+			pageByteSize = this->pageSlots * objectByteSize;
+			usedSlots = 0;
+			allocatedPages = 0;
+			concurrent = false;
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				diffPrepared[i] = false;
+			}
+			grow();
+		}
+
+		SnapshotArena::~SnapshotArena(void)
+		{
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				for (SnapshotBlock::iterator it = blocks[i].begin(); it != blocks[i].end(); it++) {
+					releasePage(*it);
+				}
+				for (SnapshotBlock::iterator it = diffBlocks[i].begin(); it != diffBlocks[i].end(); it++) {
+					releasePage(*it);
+				}
+			}
+			for (std::vector<SnapshotPage*>::iterator it = freePages.begin(); it != freePages.end(); it++) {
+				delete[] (*it)->data;
+				delete *it;
+			}
+		}
+
+		SnapshotPage* SnapshotArena::acquirePage(void)
+		{
+			MutexGuard guard(pageLock);
+			SnapshotPage* page;
+			if (!freePages.empty()) {
+				page = freePages.back();
+				freePages.pop_back();
+			} else {
+				page = new SnapshotPage();
+				page->data = new byte[pageByteSize];
+			}
+			page->references = 1;
+			allocatedPages++;
+			return page;
+		}
+
+		void SnapshotArena::releasePage(SnapshotPage* page)
+		{
+			MutexGuard guard(pageLock);
+			if (--page->references == 0) {
+				freePages.push_back(page);
+				allocatedPages--;
+			}
+		}
+
+		SnapshotPage* SnapshotArena::getWritablePage(int bufferIndex, unsigned int page)
+		{
+			SnapshotPage* shared = blocks[bufferIndex][page];
+			if (shared->references == 1) {
+				return shared;
+			}
+
+			SnapshotPage* copy = acquirePage();
+			memcpy(copy->data, shared->data, pageByteSize);
+			releasePage(shared);
+			blocks[bufferIndex][page] = copy;
+			return copy;
+		}
+
+		void SnapshotArena::grow(void)
+		{
+			if (concurrent) {
+				for (unsigned int i = 0; i < NSL_SNAPSHOT_ARENA_WRITE_LOCKS; i++) {
+					writeLocks[i].lock();
+				}
+			}
+
+			// new slots are not used in any index yet, so one page is enough for all of them
+			SnapshotPage* page = acquirePage();
+			memset(page->data, 0, pageByteSize);
+			page->references = NSL_PACKET_BUFFER_SIZE_SERVER;
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				blocks[i].push_back(page);
+
+				// prepared diffs do not cover the new page
+				diffPrepared[i] = false;
+			}
+
+			if (concurrent) {
+				for (unsigned int i = 0; i < NSL_SNAPSHOT_ARENA_WRITE_LOCKS; i++) {
+					writeLocks[i].unlock();
+				}
+			}
+		}
+
+		unsigned int SnapshotArena::allocateSlot(int bufferIndex)
+		{
+			unsigned int slot;
+			if (!freeSlots.empty()) {
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			} else {
+				if (usedSlots == getCapacity()) {
+					grow();
+				}
+				slot = usedSlots++;
+			}
+
+			Mutex* lock = getWriteLock(slot);
+			if (lock != NULL) {
+				lock->lock();
+			}
+			for (unsigned int i = 0; i < objectClass->getAttributeCount(); i++) {
+				AttributeDefinition* attribute = objectClass->getAttributeDefinition(i);
+				if (attribute != NULL) {
+					memset(getWritableAttribute(bufferIndex, slot, i), 0, attribute->size);
+				}
+			}
+			if (lock != NULL) {
+				lock->unlock();
+			}
+			return slot;
+		}
+
+		void SnapshotArena::releaseSlot(unsigned int slot)
+		{
+			freeSlots.push_back(slot);
+		}
+
+		byte* SnapshotArena::getData(int bufferIndex, unsigned int slot)
+		{
+			return blocks[bufferIndex][slot / pageSlots]->data + (slot % pageSlots) * objectByteSize;
+		}
+
+		byte* SnapshotArena::getAttribute(SnapshotBlock& block, unsigned int slot, unsigned int attrId)
+		{
+			byte* data = block[slot / pageSlots]->data;
+			slot %= pageSlots;
+			if (columnar) {
+				return data + pageSlots * objectClass->getDataOffset(attrId) + slot * objectClass->getAttributeDefinition(attrId)->size;
+			} else {
+				return data + slot * objectByteSize + objectClass->getDataOffset(attrId);
+			}
+		}
+
+		byte* SnapshotArena::getWritableAttribute(int bufferIndex, unsigned int slot, unsigned int attrId)
+		{
+			getWritablePage(bufferIndex, slot / pageSlots);
+			return getAttribute(blocks[bufferIndex], slot, attrId);
+		}
+
+		void SnapshotArena::copyIndex(int destinationIndex, int sourceIndex)
+		{
+			SnapshotBlock& destination = blocks[destinationIndex];
+			SnapshotBlock& source = blocks[sourceIndex];
+			for (unsigned int i = 0; i < source.size(); i++) {
+				source[i]->references++;
+				releasePage(destination[i]);
+				destination[i] = source[i];
+			}
+		}
+
+		void SnapshotArena::clearIndex(int bufferIndex)
+		{
+			// unused slots can be cleared as well, so whole pages are done at once
+			for (unsigned int i = 0; i < blocks[bufferIndex].size(); i++) {
+				memset(getWritablePage(bufferIndex, i)->data, 0, pageByteSize);
+			}
+		}
+
+		void SnapshotArena::prepareDiff(int ackIndex, int currentIndex)
+		{
+			SnapshotBlock& result = diffBlocks[ackIndex];
+			while (result.size() < blocks[ackIndex].size()) {
+				result.push_back(acquirePage());
+			}
+
+			// both layouts are XORed page by page, pages shared by both indexes did not change at all
+			unsigned int pageCount = (usedSlots + pageSlots - 1) / pageSlots;
+			for (unsigned int i = 0; i < pageCount; i++) {
+				SnapshotPage* ackPage = blocks[ackIndex][i];
+				SnapshotPage* currentPage = blocks[currentIndex][i];
+				if (ackPage == currentPage) {
+					memset(result[i]->data, 0, pageByteSize);
+				} else {
+					xorDelta(result[i]->data, ackPage->data, currentPage->data, pageByteSize);
+				}
+			}
+			diffPrepared[ackIndex] = true;
+		}
+
+		void SnapshotArena::invalidateDiffs(void)
+		{
+			for (unsigned int i = 0; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+				diffPrepared[i] = false;
+			}
+		}
+	};
+};
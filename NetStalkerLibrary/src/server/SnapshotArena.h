@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+namespace nsl {
+	class ObjectClassDefinition;
+};
+
+#include "../configuration.h"
+#include "../Thread.h"
+#include <vector>
+
+namespace nsl {
+	namespace server {
+
+		/// Data of a fixed number of slots, shared by all history indexes which did not change them
+		struct SnapshotPage
+		{
+			byte* data;
+			unsigned int references;	// number of blocks using the page
+		};
+
+		/// Data of all slots in one history index, page after page
+		typedef std::vector<SnapshotPage*> SnapshotBlock;
+
+		/// Storage of history data of all objects of one class.
+		/// Every history index has one block of pages, in which every object owns a slot on the same position.
+		/// Page is laid out by objects (row after row), or by attributes for columnar classes
+		/// (attribute of all slots in the page, then next attribute of all slots, ...).
+		/// Copying an index only shares its pages, page is copied when it is written in a block, which shares it (copy on write),
+		/// so memory grows with the amount of changed data and not with the history length.
+		/// Slots of destroyed objects and released pages are reused, so the heap is touched only when the capacity runs out.
+		class SnapshotArena
+		{
+		private:
+			ObjectClassDefinition* objectClass;
+			unsigned int objectByteSize;
+			bool columnar;
+			unsigned int pageSlots;		// slot count of every page
+			unsigned int pageByteSize;
+			unsigned int usedSlots;		// slots [0, usedSlots) were ever allocated
+			SnapshotBlock blocks[NSL_PACKET_BUFFER_SIZE_SERVER];
+			SnapshotBlock diffBlocks[NSL_PACKET_BUFFER_SIZE_SERVER];	// XOR of given index with current index, allocated on first use
+			bool diffPrepared[NSL_PACKET_BUFFER_SIZE_SERVER];
+			std::vector<unsigned int> freeSlots;
+			std::vector<SnapshotPage*> freePages;
+			unsigned int allocatedPages;	// pages used by blocks or diffs
+			Mutex pageLock;					// diffs take and return pages on the network thread while the game thread writes blocks
+			bool concurrent;				// are slots written from more threads at once?
+			Mutex writeLocks[NSL_SNAPSHOT_ARENA_WRITE_LOCKS];	// writers of pages with given number modulo lock count
+
+			/// add one zeroed page shared by all indexes
+			/// in concurrent mode, all write locks are held meanwhile, because blocks are reallocated
+			void grow(void);
+
+			/// get page with one reference, its data are undefined
+			SnapshotPage* acquirePage(void);
+
+			/// remove one reference, page without references is kept for reuse
+			void releasePage(SnapshotPage* page);
+
+			/// make page of given index private to it, so it can be written
+			SnapshotPage* getWritablePage(int bufferIndex, unsigned int page);
+		public:
+			SnapshotArena(ObjectClassDefinition* objectClass, unsigned int pageSlots = NSL_SNAPSHOT_ARENA_PAGE_SLOTS);
+			~SnapshotArena(void);
+
+			/// get slot for new object, data of the slot are set to zero in given index
+			unsigned int allocateSlot(int bufferIndex);
+
+			/// Let more threads write slots at once, each of them must hold the write lock of the slot while it accesses the slot
+			void setConcurrent(bool concurrent) {this->concurrent = concurrent;}
+
+			/// get lock, which must be held while the slot is accessed in concurrent mode, NULL if the arena is not concurrent
+			Mutex* getWriteLock(unsigned int slot) {return concurrent ? &writeLocks[(slot / pageSlots) % NSL_SNAPSHOT_ARENA_WRITE_LOCKS] : NULL;}
+
+			/// will the next allocateSlot add a page to all indexes?
+			bool isFull(void) {return freeSlots.empty() && usedSlots == getCapacity();}
+
+			/// return slot of destroyed object back to the arena
+			void releaseSlot(unsigned int slot);
+
+			/// get object data of given slot and history index for reading, they may be shared with other indexes
+			/// valid only for classes which are not columnar
+			byte* getData(int bufferIndex, unsigned int slot);
+
+			/// get block of given history index
+			SnapshotBlock& getBlock(int bufferIndex) {return blocks[bufferIndex];}
+
+			/// get attribute data of given slot and history index for reading, they may be shared with other indexes
+			byte* getAttribute(int bufferIndex, unsigned int slot, unsigned int attrId) {return getAttribute(blocks[bufferIndex], slot, attrId);}
+
+			/// get attribute data of given slot in any block of this arena
+			byte* getAttribute(SnapshotBlock& block, unsigned int slot, unsigned int attrId);
+
+			/// get attribute data of given slot and history index for writing, only that index is changed
+			/// pointers returned by getData and getAttribute for this index before this call may become invalid
+			byte* getWritableAttribute(int bufferIndex, unsigned int slot, unsigned int attrId);
+
+			/// make destination index share all pages of source index
+			void copyIndex(int destinationIndex, int sourceIndex);
+
+			/// set data of all slots in given history index to zero
+			void clearIndex(int bufferIndex);
+
+			/// compute XOR of data in ackIndex and currentIndex for all slots at once
+			/// result has the same layout as other blocks and is available by getPreparedDiff until invalidateDiffs is called
+			void prepareDiff(int ackIndex, int currentIndex);
+
+			/// get block prepared by prepareDiff, or NULL if there is none
+			SnapshotBlock* getPreparedDiff(int ackIndex) {return diffPrepared[ackIndex] ? &diffBlocks[ackIndex] : NULL;}
+
+			/// forget all prepared diffs
+			void invalidateDiffs(void);
+
+			bool isColumnar(void) {return columnar;}
+			unsigned int getCapacity(void) {return blocks[0].size() * pageSlots;}
+			unsigned int getObjectByteSize(void) {return objectByteSize;}
+
+			/// number of pages used by history and prepared diffs, the rest is waiting for reuse
+			unsigned int getAllocatedPageCount(void) {return allocatedPages;}
+		};
+	};
+};
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#include "SpatialGrid.h"
+#include "NetworkObject.h"
+#include "ObjectManager.h"
+#include "SnapshotArena.h"
+#include "../ObjectClassDefinition.h"
+#include <math.h>
+
+// cell of objects without position, grid cell keys never have the highest bit set
+#define NSL_SPATIAL_GRID_UNPOSITIONED_CELL 0xFFFFFFFFFFFFFFFFULL
+
+// grid coordinates are stored by 21 bits in cell key, further positions fall into border cells
+#define NSL_SPATIAL_GRID_COORDINATE_BITS 21
+#define NSL_SPATIAL_GRID_COORDINATE_LIMIT (1LL << (NSL_SPATIAL_GRID_COORDINATE_BITS - 1))
+
+namespace nsl {
+	namespace server {
+
+		SpatialGrid::SpatialGrid(double cellSize) : cellSize(cellSize)
+		{
+			concurrent = false;
+		}
+
+		SpatialGrid::~SpatialGrid(void)
+		{
+		}
+
+		unsigned long long SpatialGrid::getCellKey(long long x, long long y, long long z)
+		{
+			unsigned long long mask = (1ULL << NSL_SPATIAL_GRID_COORDINATE_BITS) - 1;
+			return (((unsigned long long)x & mask) << (2 * NSL_SPATIAL_GRID_COORDINATE_BITS))
+				| (((unsigned long long)y & mask) << NSL_SPATIAL_GRID_COORDINATE_BITS)
+				| ((unsigned long long)z & mask);
+		}
+
+		long long SpatialGrid::getCellCoordinate(double coordinate)
+		{
+			double cell = floor(coordinate / cellSize);
+
+			// objects far away share border cells, distance is checked anyway
+			if (cell < -NSL_SPATIAL_GRID_COORDINATE_LIMIT) {
+				return -NSL_SPATIAL_GRID_COORDINATE_LIMIT;
+			} else if (cell > NSL_SPATIAL_GRID_COORDINATE_LIMIT - 1) {
+				return NSL_SPATIAL_GRID_COORDINATE_LIMIT - 1;
+			}
+			return (long long)cell;
+		}
+
+		bool SpatialGrid::getPosition(NetworkObject* object, int bufferIndex, double* position)
+		{
+			ObjectClassDefinition* objectClass = object->getObjectClass();
+			unsigned int dimensions = objectClass->getPositionDimensions();
+			if (dimensions == 0) {
+				return false;
+			}
+
+			position[2] = 0;
+			for (unsigned int i = 0; i < dimensions; i++) {
+				byte* data = object->getArena()->getAttribute(bufferIndex, object->getSlot(), objectClass->getPositionAttribute(i));
+				position[i] = objectClass->readCoordinate(i, data);
+			}
+			return true;
+		}
+
+		void SpatialGrid::addToCell(NetworkObject* object, unsigned long long cell)
+		{
+			std::vector<NetworkObject*>& cellObjects = cells[cell];
+			SpatialGridEntry& entry = object->getSpatialGridEntry();
+			entry.cell = cell;
+			entry.cellPosition = cellObjects.size();
+			entry.placed = true;
+			cellObjects.push_back(object);
+		}
+
+		void SpatialGrid::removeFromCell(NetworkObject* object)
+		{
+			SpatialGridEntry& entry = object->getSpatialGridEntry();
+			std::map<unsigned long long, std::vector<NetworkObject*> >::iterator it = cells.find(entry.cell);
+			std::vector<NetworkObject*>& cellObjects = it->second;
+
+			// move the last object of the cell to the freed position
+			NetworkObject* last = cellObjects.back();
+			cellObjects[entry.cellPosition] = last;
+			last->getSpatialGridEntry().cellPosition = entry.cellPosition;
+			cellObjects.pop_back();
+			if (cellObjects.empty()) {
+				cells.erase(it);
+			}
+			entry.placed = false;
+		}
+
+		void SpatialGrid::setCellSize(double cellSize)
+		{
+			if (cellSize <= 0) {
+				throw Exception(NSL_EXCEPTION_USAGE_ERROR, "NSL: scope cell size must be positive");
+			}
+			this->cellSize = cellSize;
+
+			for (std::map<unsigned long long, std::vector<NetworkObject*> >::iterator it = cells.begin(); it != cells.end(); it++) {
+				for (std::vector<NetworkObject*>::iterator it2 = it->second.begin(); it2 != it->second.end(); it2++) {
+					(*it2)->getSpatialGridEntry().placed = false;
+					markMoved(*it2);
+				}
+			}
+			cells.clear();
+		}
+
+		void SpatialGrid::markMoved(NetworkObject* object)
+		{
+			SpatialGridEntry& entry = object->getSpatialGridEntry();
+			if (!entry.moved) {
+				entry.moved = true;
+				if (concurrent) {
+					concurrentMovedObjects.push(object->getId());
+				} else {
+					movedObjects.push_back(object->getId());
+				}
+			}
+		}
+
+		void SpatialGrid::remove(NetworkObject* object)
+		{
+			if (object->getSpatialGridEntry().placed) {
+				removeFromCell(object);
+			}
+		}
+
+		void SpatialGrid::update(ObjectManager* objectManager, int bufferIndex)
+		{
+			concurrentMovedObjects.popAll(movedObjects);
+
+			// objects are referenced by id, because they could have been deleted meanwhile
+			for (std::vector<unsigned int>::iterator it = movedObjects.begin(); it != movedObjects.end(); it++) {
+				NetworkObject* object = objectManager->findObjectById(*it);
+				if (object == NULL) {
+					continue;
+				}
+				object->getSpatialGridEntry().moved = false;
+				if (object->getDestroyIndex() != NSL_UNDEFINED_BUFFER_INDEX) {
+					continue;
+				}
+
+				double position[3];
+				unsigned long long cell;
+				if (getPosition(object, bufferIndex, position)) {
+					cell = getCellKey(getCellCoordinate(position[0]), getCellCoordinate(position[1]), getCellCoordinate(position[2]));
+				} else {
+					cell = NSL_SPATIAL_GRID_UNPOSITIONED_CELL;
+				}
+
+				SpatialGridEntry& entry = object->getSpatialGridEntry();
+				if (entry.placed) {
+					if (entry.cell == cell) {
+						continue;
+					}
+					removeFromCell(object);
+				}
+				addToCell(object, cell);
+			}
+			movedObjects.clear();
+		}
+
+		void SpatialGrid::query(double* position, double radius, int bufferIndex, std::vector<NetworkObject*>& scope)
+		{
+			long long low[3];
+			long long high[3];
+			unsigned long long cellCount = 1;
+			for (unsigned int i = 0; i < 3; i++) {
+				low[i] = getCellCoordinate(position[i] - radius);
+				high[i] = getCellCoordinate(position[i] + radius);
+				cellCount *= (unsigned long long)(high[i] - low[i] + 1);
+			}
+
+			// visit cells overlapping the view, or all existing cells if there are less of them
+			std::vector<std::vector<NetworkObject*>*> candidates;
+			if (cellCount > cells.size()) {
+				for (std::map<unsigned long long, std::vector<NetworkObject*> >::iterator it = cells.begin(); it != cells.end(); it++) {
+					if (it->first != NSL_SPATIAL_GRID_UNPOSITIONED_CELL) {
+						candidates.push_back(&it->second);
+					}
+				}
+			} else {
+				for (long long x = low[0]; x <= high[0]; x++) {
+					for (long long y = low[1]; y <= high[1]; y++) {
+						for (long long z = low[2]; z <= high[2]; z++) {
+							std::map<unsigned long long, std::vector<NetworkObject*> >::iterator it = cells.find(getCellKey(x, y, z));
+							if (it != cells.end()) {
+								candidates.push_back(&it->second);
+							}
+						}
+					}
+				}
+			}
+
+			double radius2 = radius * radius;
+			for (std::vector<std::vector<NetworkObject*>*>::iterator it = candidates.begin(); it != candidates.end(); it++) {
+				for (std::vector<NetworkObject*>::iterator it2 = (*it)->begin(); it2 != (*it)->end(); it2++) {
+					double objectPosition[3];
+					getPosition(*it2, bufferIndex, objectPosition);
+					double distance2 = 0;
+					for (unsigned int i = 0; i < 3; i++) {
+						distance2 += (objectPosition[i] - position[i]) * (objectPosition[i] - position[i]);
+					}
+					if (distance2 <= radius2) {
+						scope.push_back(*it2);
+					}
+				}
+			}
+
+			std::map<unsigned long long, std::vector<NetworkObject*> >::iterator unpositioned = cells.find(NSL_SPATIAL_GRID_UNPOSITIONED_CELL);
+			if (unpositioned != cells.end()) {
+				scope.insert(scope.end(), unpositioned->second.begin(), unpositioned->second.end());
+			}
+		}
+	};
+};
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 Petr Smrcek
+ * This file is originally a part of the Net Stalker Library
+ * For conditions of distribution and use, see copyright notice in nsl.h
+ */
+
+#pragma once
+
+namespace nsl {
+	namespace server {
+		class NetworkObject;
+		class ObjectManager;
+	};
+};
+
+#include "../configuration.h"
+#include "../ConcurrentStack.h"
+#include <map>
+#include <vector>
+
+namespace nsl {
+	namespace server {
+
+		/// Placement of one object in the spatial grid, owned by the object
+		struct SpatialGridEntry
+		{
+			unsigned long long cell;
+			unsigned int cellPosition;	// position in cell object list
+			bool placed;				// is object in some cell?
+			bool moved;					// is object waiting for update of its cell?
+
+			SpatialGridEntry(void) : cell(0), cellPosition(0), placed(false), moved(false) {}
+		};
+
+		/// Uniform grid of objects by their position attributes, used to compute scope of peers with a view.
+		/// Objects are moved between cells only if their position was set since the last update,
+		/// objects of classes without position are kept in one special cell visible from everywhere.
+		class SpatialGrid
+		{
+		private:
+			double cellSize;
+			std::map<unsigned long long, std::vector<NetworkObject*> > cells;
+			std::vector<unsigned int> movedObjects;		// ids of objects which need update of their cell
+			ConcurrentStack<unsigned int> concurrentMovedObjects;	// ids of objects moved in concurrent mode, added to movedObjects by update
+			bool concurrent;
+
+			/// get key of cell containing given grid coordinates
+			unsigned long long getCellKey(long long x, long long y, long long z);
+
+			/// get grid coordinate of given position coordinate
+			long long getCellCoordinate(double coordinate);
+
+			void addToCell(NetworkObject* object, unsigned long long cell);
+			void removeFromCell(NetworkObject* object);
+		public:
+			SpatialGrid(double cellSize = NSL_SCOPE_GRID_CELL_SIZE);
+			~SpatialGrid(void);
+
+			/// read position of object at given index, return false if its class has no position
+			static bool getPosition(NetworkObject* object, int bufferIndex, double* position);
+
+			/// change cell size, all objects are placed again during next update
+			void setCellSize(double cellSize);
+
+			/// let markMoved be called from more threads at once (for distinct objects)
+			void setConcurrent(bool concurrent) {this->concurrent = concurrent;}
+
+			/// remember that object was created or its position changed
+			void markMoved(NetworkObject* object);
+
+			/// take object out of the grid, it will not be in any scope until it is moved again
+			void remove(NetworkObject* object);
+
+			/// move all marked objects to cells of their positions at given index
+			void update(ObjectManager* objectManager, int bufferIndex);
+
+			/// add all objects closer than radius to given position (by their data at given index) into scope
+			/// objects of classes without position are added always, scope is not ordered
+			void query(double* position, double radius, int bufferIndex, std::vector<NetworkObject*>& scope);
+		};
+	};
+};
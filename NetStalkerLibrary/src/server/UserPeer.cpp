@@ -27,4 +27,29 @@ namespace nsl {
 		// TODO: get peer address
 		return "";
 	}
+
+	void Peer::setView(double x, double y, double z, double radius)
+	{
+		peer->setView(x, y, z, radius);
+	}
+
+	void Peer::clearView(void)
+	{
+		peer->clearView();
+	}
+
+	void Peer::setByteBudget(unsigned int bytes)
+	{
+		peer->setByteBudget(bytes);
+	}
+
+	void Peer::setSendInterval(unsigned int flushes)
+	{
+		peer->setSendInterval(flushes);
+	}
+
+	unsigned int Peer::getSendInterval(void)
+	{
+		return peer->getSendInterval();
+	}
 };
\ No newline at end of file
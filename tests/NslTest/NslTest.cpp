@@ -11,8 +11,10 @@ int main(int argc, char** argv)
 { 
     testing::InitGoogleTest(&argc, argv); 
 
-	// run unit tests
-	testing::GTEST_FLAG(filter) = "*Unit*";
+	// run unit tests, unless other tests (f.e. *Benchmark*) are chosen by --gtest_filter
+	if (testing::GTEST_FLAG(filter) == "*") {
+		testing::GTEST_FLAG(filter) = "*Unit*";
+	}
 
     RUN_ALL_TESTS(); 
 
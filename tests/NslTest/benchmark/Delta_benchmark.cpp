@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/delta/delta.h"
+#include <iostream>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#define NSL_BENCHMARK_CYCLES() __rdtsc()
+#elif defined(__i386__) || defined(__x86_64__)
+	#include <x86intrin.h>
+	#define NSL_BENCHMARK_CYCLES() __rdtsc()
+#endif
+
+#ifdef NSL_BENCHMARK_CYCLES
+
+// Typical objects are 16 - 256 bytes, a class with many objects is delta-ed as one block
+TEST(Delta_Benchmark, bytesPerCycle) {
+	const unsigned int objectCount = 1024;
+	const unsigned int repeats = 200;
+	unsigned int objectSizes[] = {16, 32, 64, 128, 256};
+
+	std::cout << "XOR delta kernel: " << nsl::getDeltaKernelName() << std::endl;
+
+	for (unsigned int s = 0; s < sizeof(objectSizes) / sizeof(unsigned int); s++) {
+		unsigned int size = objectSizes[s];
+		nsl::byte* first = new nsl::byte[size * objectCount];
+		nsl::byte* second = new nsl::byte[size * objectCount];
+		nsl::byte* result = new nsl::byte[size * objectCount];
+		for (unsigned int i = 0; i < size * objectCount; i++) {
+			first[i] = (nsl::byte)i;
+			second[i] = (nsl::byte)(i >> 3);
+		}
+
+		// one call per object
+		unsigned long long start = NSL_BENCHMARK_CYCLES();
+		for (unsigned int r = 0; r < repeats; r++) {
+			for (unsigned int o = 0; o < objectCount; o++) {
+				nsl::xorDelta(result + o * size, first + o * size, second + o * size, size);
+			}
+		}
+		unsigned long long perObject = NSL_BENCHMARK_CYCLES() - start;
+
+		// one call per block of objects
+		start = NSL_BENCHMARK_CYCLES();
+		for (unsigned int r = 0; r < repeats; r++) {
+			nsl::xorDelta(result, first, second, size * objectCount);
+		}
+		unsigned long long perBlock = NSL_BENCHMARK_CYCLES() - start;
+
+		double bytes = (double)size * objectCount * repeats;
+		std::cout << size << " B objects: "
+			<< bytes / perObject << " B/cycle per object, "
+			<< bytes / perBlock << " B/cycle per block" << std::endl;
+
+		EXPECT_EQ((nsl::byte)(first[size] ^ second[size]), result[size]);
+
+		delete[] first;
+		delete[] second;
+		delete[] result;
+	}
+}
+
+#endif
@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/client/Connection.h"
+#include "src/server/Connection.h"
+
+#ifdef NSL_COMPRESS
+TEST(ClientConnection_Unit, malformedCompressedUpdate) {
+	nsl::client::Connection connection(1);
+
+	// literal run longer than the data makes every buffer too small, it must not grow forever
+	nsl::byte data[16];
+	memset(data, 0xFF, 16);
+	nsl::BitStreamReader reader(data, 16, false);
+	EXPECT_TRUE(connection.decompressStream(&reader) == NULL);
+}
+#endif
+
+TEST(ClientConnection_Unit, resentHandshake) {
+	nsl::server::Connection server(1);
+	server.open("30731");
+	nsl::client::Connection client(1);
+	nsl::server::PeerConnection* peer;
+	nsl::BitStreamReader* data;
+
+	// reply to the first request is late, so the client resends it and gets the same cookie twice
+	client.open("127.0.0.1", "30731", "30732", 0);
+	EXPECT_EQ(nsl::client::CONNECTING, client.update(NSL_TIMEOUT_CLIENT_CONNECTION_REQUEST + 0.1));
+	EXPECT_EQ(nsl::server::EMPTY, server.update(peer, data, 0.6));
+	EXPECT_EQ(nsl::client::HANDSHAKING, client.update(0.7));
+
+	// duplicate reply waits in front of the accepted handshake
+	ASSERT_EQ(nsl::server::PEER_CONNECT, server.update(peer, data, 0.8));
+	delete data;
+	nsl::server::Packet* packet = server.createPacket(peer);
+	packet->getStream()->write<nsl::uint32>(7);
+	packet->send();
+	delete packet;
+	EXPECT_EQ(nsl::client::CONNECTED, client.update(0.9));
+	data = client.receive();
+	ASSERT_TRUE(data != NULL);
+	EXPECT_EQ(7, data->read<nsl::uint32>());
+
+	// reply to a request resent even later is ignored as well
+	nsl::Socket socket;
+	socket.open("30733");
+	nsl::Address address;
+	socket.getAddressFromStrings(address, "127.0.0.1", "30732");
+	nsl::byte replyData[15];
+	nsl::BitStreamWriter reply(replyData, 15);
+	reply.write<nsl::uint16>(1);
+	reply.write<nsl::uint32>(peer->connectionId);
+	reply.write<nsl::uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
+	reply.write<nsl::uint64>(0);
+	socket.send(address, replyData, 15);
+	EXPECT_TRUE(client.receive() == NULL);
+	EXPECT_EQ(nsl::client::CONNECTED, client.update(1.0));
+
+	client.close();
+	server.close();
+}
@@ -129,3 +129,36 @@ TEST(ClientHistoryBuffer_Unit, averageTickDuration) {
 	EXPECT_EQ(2.25, hb.getAverageTimeInterval(4));
 
 }
+
+TEST(ClientHistoryBuffer_Unit, rebase) {
+	nsl::client::HistoryBuffer hb;
+	int firstIndexToClear;
+	int lastIndexToClear;
+
+	EXPECT_EQ(true, hb.pushSeq(1, 1, 1, firstIndexToClear, lastIndexToClear, 1.0));
+	for (int seq = 2; seq <= 5; seq++) {
+		EXPECT_EQ(true, hb.pushSeq(seq, 1, seq, firstIndexToClear, lastIndexToClear, 1.0));
+	}
+	EXPECT_EQ(true, hb.updateApplicationIndex(3.0));
+	EXPECT_EQ(2, hb.getApplicationIndex());
+
+	// seq too far ahead follows the application index, its data are based on the kept ack
+	nsl::seqNumber seq = NSL_PACKET_BUFFER_SIZE + 20;
+	EXPECT_EQ(true, hb.pushSeq(seq, 1, 100, firstIndexToClear, lastIndexToClear, 1.0));
+	EXPECT_EQ(3, hb.getLastSeqIndex());
+	EXPECT_EQ(0, hb.getPushedAckIndex());
+	EXPECT_EQ(3, firstIndexToClear);
+	EXPECT_EQ(NSL_PACKET_BUFFER_SIZE - 1, lastIndexToClear);
+	EXPECT_EQ(2, hb.getPreviousValidIndex(3));
+	EXPECT_EQ(4, hb.getTime(3));
+
+	// updates based on the kept ack go on, older seqs are not accepted anymore
+	EXPECT_EQ(true, hb.pushSeq(seq + 1, 1, 101, firstIndexToClear, lastIndexToClear, 1.0));
+	EXPECT_EQ(0, hb.getPushedAckIndex());
+	EXPECT_EQ(false, hb.pushSeq(4, 1, 4, firstIndexToClear, lastIndexToClear, 1.0));
+
+	// acknowledged new seq releases the kept ack
+	EXPECT_EQ(true, hb.pushSeq(seq + 2, seq, 102, firstIndexToClear, lastIndexToClear, 1.0));
+	EXPECT_EQ(3, hb.getLastAckIndex());
+	EXPECT_EQ(false, hb.pushSeq(seq + 3, 1, 103, firstIndexToClear, lastIndexToClear, 1.0));
+}
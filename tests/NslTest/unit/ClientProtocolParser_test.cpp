@@ -83,4 +83,75 @@ TEST(ClientProtocolParser_Unit, parseNewObjects) {
 
 	EXPECT_TRUE(NULL != o1);
 	EXPECT_TRUE(NULL != o2);
-}
\ No newline at end of file
+}
+TEST(ClientProtocolParser_Unit, parseChangedAttributes) {
+	
+	nsl::client::HistoryBuffer historyBuffer;
+	nsl::client::ObjectManager objectManager(&historyBuffer);
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint8>(0);
+	oc.defineAttribute<nsl::uint32>(1);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	nsl::client::CustomMessageBuffer customMessageBuffer;
+	customMessageBuffer.addSeq();
+	nsl::client::ProtocolParser parser(&historyBuffer, &objectManager, &customMessageBuffer);
+
+	// first packet creates two objects
+	nsl::BitStreamWriter writer;
+	writer.write<nsl::Attribute<nsl::seqNumber> >(2);
+	writer.write<nsl::Attribute<nsl::seqNumber> >(2);
+	writer.write<nsl::double64>(25.0);
+	writer.write<nsl::Attribute<nsl::seqNumber> >(customMessageBuffer.getCurrentSeqIndex());
+	nsl::ObjectFlags flags;
+	flags.action = NSL_OBJECT_FLAG_ACTION_CREATE;
+	flags.creationCustomMessage = NSL_OBJECT_FLAG_CM_EMPTY;
+	for(unsigned int i = 1; i <= 2; i++) {
+		writer << flags;
+		writer.write<nsl::uint16>(0);
+		writer.write<nsl::uint32>(i);
+		writer.write<nsl::uint8>(35);
+		writer.write<nsl::uint32>(110);
+	}
+	nsl::ObjectFlags endFlags;
+	endFlags.action = NSL_OBJECT_FLAG_ACTION_END_OF_SECTION;
+	writer << endFlags;
+
+	unsigned int byteSize;
+	nsl::byte* data = writer.toBytes(byteSize);
+	nsl::BitStreamReader reader(data, byteSize);
+	parser.proccessUpdatePacket(&reader, 20.0);
+
+	// second packet changes the second attribute of the first object in packet, the other one is unchanged
+	nsl::BitStreamWriter writer2;
+	writer2.write<nsl::Attribute<nsl::seqNumber> >(3);
+	writer2.write<nsl::Attribute<nsl::seqNumber> >(2);
+	writer2.write<nsl::double64>(26.0);
+	writer2.write<nsl::Attribute<nsl::seqNumber> >(customMessageBuffer.getCurrentSeqIndex());
+	nsl::ObjectFlags diffFlags;
+	diffFlags.action = NSL_OBJECT_FLAG_ACTION_DIFF;
+	writer2 << diffFlags;
+	writer2.writeByte(2);
+	writer2.write<nsl::uint32>(110 ^ 7);
+	nsl::ObjectFlags noChangeFlags;
+	noChangeFlags.action = NSL_OBJECT_FLAG_ACTION_NO_CHANGE;
+	writer2 << noChangeFlags;
+	writer2 << endFlags;
+
+	nsl::client::NetworkObject* first = *objectManager.objectsInPacketBegin(historyBuffer.getLastSeqIndex());
+	nsl::client::NetworkObject* second = objectManager.findObjectById(first->getId() == 1 ? 2 : 1);
+
+	nsl::byte* data2 = writer2.toBytes(byteSize);
+	nsl::BitStreamReader reader2(data2, byteSize);
+	parser.proccessUpdatePacket(&reader2, 21.0);
+
+	int seqIndex = historyBuffer.getLastSeqIndex();
+	nsl::byte* firstData = first->getDataBySeqIndex(seqIndex);
+	nsl::byte* secondData = second->getDataBySeqIndex(seqIndex);
+	ASSERT_TRUE(NULL != firstData);
+	ASSERT_TRUE(NULL != secondData);
+	EXPECT_EQ(35, firstData[ocd.getDataOffset(0)]);
+	EXPECT_EQ(7, *(unsigned int*)(firstData + ocd.getDataOffset(1)));
+	EXPECT_EQ(35, secondData[ocd.getDataOffset(0)]);
+	EXPECT_EQ(110, *(unsigned int*)(secondData + ocd.getDataOffset(1)));
+}
@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/ConcurrentStack.h"
+#include "src/ThreadPool.h"
+#include <vector>
+
+#define PUSHES_PER_JOB 1000
+
+static void pushJob(void* context, unsigned int jobIndex)
+{
+	nsl::ConcurrentStack<unsigned int>* stack = (nsl::ConcurrentStack<unsigned int>*)context;
+	for (unsigned int i = 0; i < PUSHES_PER_JOB; i++) {
+		stack->push(jobIndex * PUSHES_PER_JOB + i);
+	}
+}
+
+TEST(ConcurrentStack_Unit, popInOrderOfPushing) {
+	nsl::ConcurrentStack<unsigned int> stack;
+	EXPECT_TRUE(stack.isEmpty());
+
+	stack.push(1);
+	stack.push(2);
+	std::vector<unsigned int> values(1, 0);
+	stack.popAll(values);
+	ASSERT_EQ(3, values.size());
+	EXPECT_EQ(0, values[0]);
+	EXPECT_EQ(1, values[1]);
+	EXPECT_EQ(2, values[2]);
+	EXPECT_TRUE(stack.isEmpty());
+}
+
+TEST(ConcurrentStack_Unit, pushFromMoreThreads) {
+	nsl::ConcurrentStack<unsigned int> stack;
+	nsl::ThreadPool pool(3);
+	pool.execute(&pushJob, &stack, 8);
+
+	std::vector<unsigned int> values;
+	stack.popAll(values);
+	ASSERT_EQ(8 * PUSHES_PER_JOB, values.size());
+
+	// every value is there once, values of one job keep their order
+	std::vector<int> next(8, 0);
+	for (unsigned int i = 0; i < values.size(); i++) {
+		unsigned int job = values[i] / PUSHES_PER_JOB;
+		ASSERT_LT(job, 8);
+		EXPECT_EQ(next[job], values[i] % PUSHES_PER_JOB);
+		next[job]++;
+	}
+}
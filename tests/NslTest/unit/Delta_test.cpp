@@ -0,0 +1,41 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/delta/delta.h"
+
+TEST(Delta_Unit, xorDelta) {
+	// sizes around vector widths and unaligned starts
+	nsl::byte first[102];
+	nsl::byte second[102];
+	nsl::byte result[102];
+	for (unsigned int i = 0; i < 102; i++) {
+		first[i] = (nsl::byte)(i * 7);
+		second[i] = (nsl::byte)(i * 13 + 5);
+	}
+
+	unsigned int sizes[] = {0, 1, 3, 4, 15, 16, 17, 31, 32, 33, 64, 100};
+	for (unsigned int s = 0; s < sizeof(sizes) / sizeof(unsigned int); s++) {
+		memset(result, 0, 102);
+		nsl::xorDelta(result + 1, first + 1, second, sizes[s]);
+		for (unsigned int i = 0; i < sizes[s]; i++) {
+			ASSERT_EQ((nsl::byte)(first[i+1] ^ second[i]), result[i+1]);
+		}
+		EXPECT_EQ(0, result[0]);
+		EXPECT_EQ(0, result[sizes[s] + 1]);
+	}
+}
+
+TEST(Delta_Unit, xorDeltaInPlace) {
+	nsl::byte data[70];
+	nsl::byte original[70];
+	nsl::byte delta[70];
+	for (unsigned int i = 0; i < 70; i++) {
+		data[i] = original[i] = (nsl::byte)(i * 3);
+		delta[i] = (nsl::byte)(255 - i);
+	}
+
+	// applying the same delta twice gives the original data
+	nsl::xorDeltaInPlace(data, delta, 70);
+	EXPECT_EQ((nsl::byte)(original[5] ^ delta[5]), data[5]);
+	nsl::xorDeltaInPlace(data, delta, 70);
+	EXPECT_EQ(0, memcmp(data, original, 70));
+}
@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/client/FragmentBuffer.h"
+
+TEST(FragmentBuffer_Unit, reassemble) {
+	nsl::client::FragmentBuffer buffer;
+	nsl::byte packet[10];
+	for (unsigned int i = 0; i < 10; i++) {
+		packet[i] = (nsl::byte)i;
+	}
+
+	// 10 bytes in 3 fragments of 4, 4 and 2 bytes, arriving out of order and duplicated
+	EXPECT_FALSE(buffer.addFragment(1, 2, 3, 10, packet + 8, 2));
+	EXPECT_FALSE(buffer.addFragment(1, 0, 3, 10, packet, 4));
+	EXPECT_FALSE(buffer.addFragment(1, 0, 3, 10, packet, 4));
+	EXPECT_TRUE(buffer.addFragment(1, 1, 3, 10, packet + 4, 4));
+	ASSERT_EQ(10, buffer.getPacketSize());
+	EXPECT_EQ(0, memcmp(packet, buffer.getPacket(), 10));
+
+	// late duplicate of finished packet is ignored
+	EXPECT_FALSE(buffer.addFragment(1, 1, 3, 10, packet + 4, 4));
+
+	// fragment with wrong size is ignored
+	EXPECT_FALSE(buffer.addFragment(2, 0, 2, 10, packet, 4));
+
+	EXPECT_EQ(1, buffer.getStats().packetCount);
+	EXPECT_EQ(1, buffer.getStats().fragmentedPacketCount);
+	EXPECT_EQ(3, buffer.getStats().fragmentCount);
+	EXPECT_EQ(0, buffer.getStats().droppedPacketCount);
+}
+
+TEST(FragmentBuffer_Unit, dropIncomplete) {
+	nsl::client::FragmentBuffer buffer;
+	nsl::byte packet[10];
+	memset(packet, 1, 10);
+
+	EXPECT_FALSE(buffer.addFragment(5, 0, 2, 10, packet, 5));
+
+	// newer packet drops the unfinished one, fragments of the older one are ignored then
+	EXPECT_FALSE(buffer.addFragment(6, 1, 2, 10, packet + 5, 5));
+	EXPECT_EQ(1, buffer.getStats().droppedPacketCount);
+	EXPECT_FALSE(buffer.addFragment(5, 1, 2, 10, packet + 5, 5));
+	EXPECT_TRUE(buffer.addFragment(6, 0, 2, 10, packet, 5));
+
+	EXPECT_EQ(1, buffer.getStats().droppedPacketCount);
+
+	// ids wrap around
+	nsl::client::FragmentBuffer wrapped;
+	EXPECT_FALSE(wrapped.addFragment(65535, 0, 2, 10, packet, 5));
+	EXPECT_FALSE(wrapped.addFragment(0, 0, 2, 10, packet, 5));
+	EXPECT_FALSE(wrapped.addFragment(65535, 1, 2, 10, packet + 5, 5));
+	EXPECT_TRUE(wrapped.addFragment(0, 1, 2, 10, packet + 5, 5));
+	EXPECT_EQ(1, wrapped.getStats().droppedPacketCount);
+}
+
+TEST(FragmentBuffer_Unit, maximalSize) {
+	nsl::client::FragmentBuffer buffer;
+	nsl::byte packet[256];
+	memset(packet, 1, 256);
+
+	// reassembled packet is copied behind connection header of received packet, so it must fit there
+	unsigned int size = NSL_MAX_UDP_PACKET_SIZE - 6;
+	unsigned int fragmentSize = (size + 254) / 255;
+	EXPECT_FALSE(buffer.addFragment(1, 254, 255, size, packet, size - 254 * fragmentSize));
+	EXPECT_EQ(1, buffer.getStats().fragmentCount);
+
+	size++;
+	fragmentSize = (size + 254) / 255;
+	EXPECT_FALSE(buffer.addFragment(2, 254, 255, size, packet, size - 254 * fragmentSize));
+	EXPECT_EQ(1, buffer.getStats().fragmentCount);
+}
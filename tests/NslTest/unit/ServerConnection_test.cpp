@@ -0,0 +1,187 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/Connection.h"
+#include <set>
+
+// client side of the handshake written by hand, so the server can be sent copies and forged packets
+class HandshakeClient
+{
+public:
+	nsl::Socket socket;
+	nsl::Address server;
+	nsl::byte buffer[NSL_MAX_UDP_PACKET_SIZE];
+
+	HandshakeClient(const char* port, const char* serverPort) {
+		socket.open(port);
+		socket.getAddressFromStrings(server, "127.0.0.1", serverPort);
+	}
+
+	void sendRequest(unsigned int nonce) {
+		nsl::byte data[10];
+		nsl::BitStreamWriter stream(data, 10);
+		stream.write<nsl::uint16>(1);
+		stream.write<nsl::uint32>(0);
+		stream.write<nsl::uint32>(nonce);
+		socket.send(server, data, 10);
+	}
+
+	void sendHandshake(unsigned int cookie, unsigned int nonce) {
+		nsl::byte data[11];
+		nsl::BitStreamWriter stream(data, 11);
+		stream.write<nsl::uint16>(1);
+		stream.write<nsl::uint32>(cookie);
+		stream.write<nsl::uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
+		stream.write<nsl::uint32>(nonce);
+		socket.send(server, data, 11);
+	}
+
+	/// size of the received reply, 0 if there is none
+	unsigned int receive(unsigned int& id, nsl::byte& flag) {
+		nsl::Address sender;
+		unsigned int size = socket.receive(sender, buffer, NSL_MAX_UDP_PACKET_SIZE);
+		if (size >= 7) {
+			nsl::BitStreamReader stream(buffer, size, false);
+			stream.read<nsl::uint16>();
+			id = stream.read<nsl::uint32>();
+			flag = stream.readByte();
+		}
+		return size;
+	}
+
+	unsigned int readUint32(unsigned int offset) {
+		nsl::BitStreamReader stream(buffer + offset, 4, false);
+		return stream.read<nsl::uint32>();
+	}
+
+	/// request a cookie and return it
+	unsigned int requestCookie(nsl::server::Connection& connection, unsigned int nonce, double time) {
+		nsl::server::PeerConnection* peer;
+		nsl::BitStreamReader* data;
+		sendRequest(nonce);
+		EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, time));
+		unsigned int cookie;
+		nsl::byte flag;
+		EXPECT_EQ(11, receive(cookie, flag));
+		EXPECT_EQ(NSL_CONNECTION_FLAG_HANDSHAKE, flag);
+		EXPECT_EQ(nonce, readUint32(7));
+		return cookie;
+	}
+};
+
+TEST(ServerConnection_Unit, cookie) {
+	nsl::server::Connection connection(1);
+	connection.open("30741");
+	HandshakeClient client("30742", "30741");
+	nsl::server::PeerConnection* peer;
+	nsl::BitStreamReader* data;
+	unsigned int id;
+	nsl::byte flag;
+
+	// cookie is bound to the nonce of the request
+	unsigned int cookie = client.requestCookie(connection, 5, 1);
+	EXPECT_NE(cookie, client.requestCookie(connection, 6, 1));
+	client.sendHandshake(cookie, 6);
+	EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, 1));
+	EXPECT_EQ(7, client.receive(id, flag));
+	EXPECT_EQ(cookie, id);
+	EXPECT_EQ(NSL_CONNECTION_FLAG_DISCONNECT, flag);
+
+	// and it expires after two time buckets
+	client.sendHandshake(cookie, 5);
+	EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, 1 + 2 * NSL_TIMEOUT_SERVER_HANDSHAKE));
+	EXPECT_EQ(7, client.receive(id, flag));
+	EXPECT_EQ(NSL_CONNECTION_FLAG_DISCONNECT, flag);
+
+	// valid cookie from the previous bucket creates the peer, its id is allocated by the server
+	cookie = client.requestCookie(connection, 7, 1);
+	client.sendHandshake(cookie, 7);
+	ASSERT_EQ(nsl::server::PEER_CONNECT, connection.update(peer, data, 1 + NSL_TIMEOUT_SERVER_HANDSHAKE));
+	delete data;
+	EXPECT_NE(0, peer->connectionId);
+	EXPECT_EQ(19, client.receive(id, flag));
+	EXPECT_EQ(cookie, id);
+	EXPECT_EQ(NSL_CONNECTION_FLAG_HANDSHAKE, flag);
+	EXPECT_EQ(peer->connectionId, client.readUint32(7));
+
+	connection.close();
+	delete peer;
+}
+
+TEST(ServerConnection_Unit, replayedHandshake) {
+	nsl::server::Connection connection(1);
+	connection.open("30743");
+	HandshakeClient client("30744", "30743");
+	nsl::server::PeerConnection* peer;
+	nsl::BitStreamReader* data;
+	unsigned int id;
+	nsl::byte flag;
+
+	unsigned int cookie = client.requestCookie(connection, 5, 1);
+	client.sendHandshake(cookie, 5);
+	ASSERT_EQ(nsl::server::PEER_CONNECT, connection.update(peer, data, 1));
+	delete data;
+	nsl::server::PeerConnection* connected = peer;
+	EXPECT_EQ(19, client.receive(id, flag));
+
+	// resent handshake gets the same reply, no other peer is created
+	client.sendHandshake(cookie, 5);
+	EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, 2));
+	EXPECT_EQ(19, client.receive(id, flag));
+	EXPECT_EQ(connected->connectionId, client.readUint32(7));
+
+	// copy of the handshake, which comes after the disconnect, does not create the session again
+	connection.disconnect(connected);
+	EXPECT_EQ(7, client.receive(id, flag));
+	client.sendHandshake(cookie, 5);
+	EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, 3));
+	EXPECT_EQ(7, client.receive(id, flag));
+	EXPECT_EQ(NSL_CONNECTION_FLAG_DISCONNECT, flag);
+
+	connection.close();
+	delete connected;
+}
+
+TEST(ServerConnection_Unit, uniqueConnectionIds) {
+	nsl::server::Connection connection(1);
+	connection.open("30745");
+	HandshakeClient client("30746", "30745");
+	nsl::server::PeerConnection* peer;
+	nsl::BitStreamReader* data;
+	unsigned int id;
+	nsl::byte flag;
+
+	unsigned int cookie = client.requestCookie(connection, 5, 1);
+	client.sendHandshake(cookie, 5);
+	ASSERT_EQ(nsl::server::PEER_CONNECT, connection.update(peer, data, 1));
+	delete data;
+	nsl::server::PeerConnection* suspended = peer;
+	client.receive(id, flag);
+
+	// client times out and its session is suspended
+	EXPECT_EQ(nsl::server::EMPTY, connection.update(peer, data, 2 + NSL_TIMEOUT_SERVER_CONNECTED_KILL));
+	EXPECT_TRUE(connection.proccessTimeouts(2 + NSL_TIMEOUT_SERVER_CONNECTED_KILL) == NULL);
+	ASSERT_TRUE(suspended->suspended);
+	client.receive(id, flag);
+
+	// new connections from the same address in the same time bucket get new ids
+	std::set<unsigned int> ids;
+	ids.insert(suspended->connectionId);
+	std::vector<nsl::server::PeerConnection*> peers;
+	for (unsigned int nonce = 6; nonce < 106; nonce++) {
+		cookie = client.requestCookie(connection, nonce, 8);
+		client.sendHandshake(cookie, nonce);
+		ASSERT_EQ(nsl::server::PEER_CONNECT, connection.update(peer, data, 8));
+		delete data;
+		peers.push_back(peer);
+		EXPECT_EQ(19, client.receive(id, flag));
+		EXPECT_EQ(peer->connectionId, client.readUint32(7));
+		EXPECT_NE(0, peer->connectionId);
+		EXPECT_TRUE(ids.insert(peer->connectionId).second);
+	}
+
+	connection.close();
+	for (unsigned int i = 0; i < peers.size(); i++) {
+		delete peers[i];
+	}
+	delete suspended;
+}
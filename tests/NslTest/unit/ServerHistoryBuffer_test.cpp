@@ -0,0 +1,44 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/HistoryBuffer.h"
+#include "src/server/ObjectManager.h"
+#include "src/server/Peer.h"
+#include <map>
+
+TEST(ServerHistoryBuffer_Unit, reservedIndex) {
+	nsl::server::HistoryBuffer historyBuffer;
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	nsl::server::ObjectManager objectManager;
+
+	// buffer is not full, every written index is in bounds
+	historyBuffer.addSeq(0.0, &objectManager, &peers);
+	historyBuffer.addSeq(1.0, &objectManager, &peers);
+	EXPECT_EQ(0, historyBuffer.getOldestIndex());
+	EXPECT_TRUE(historyBuffer.isIndexInBounds(0));
+	EXPECT_TRUE(historyBuffer.isIndexInBounds(1));
+	EXPECT_FALSE(historyBuffer.isIndexInBounds(NSL_UNDEFINED_BUFFER_INDEX));
+
+	for (int i = 2; i < NSL_PACKET_BUFFER_SIZE_SERVER + 3; i++) {
+		historyBuffer.addSeq(i, &objectManager, &peers);
+	}
+	int currentIndex = historyBuffer.getCurrentSeqIndex();
+	int oldestIndex = (currentIndex + 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
+	nsl::seqNumber oldestSeq = historyBuffer.indexToSeq(oldestIndex);
+	EXPECT_EQ(oldestIndex, historyBuffer.getOldestIndex());
+	EXPECT_TRUE(historyBuffer.isSeqInBounds(oldestSeq));
+	EXPECT_TRUE(historyBuffer.isIndexInBounds(oldestIndex));
+
+	// copy used by the network thread does not touch the index cleared by the next seq
+	nsl::server::HistoryBuffer published = historyBuffer;
+	published.setReservedIndexCount(1);
+	EXPECT_EQ((oldestIndex + 1) % NSL_PACKET_BUFFER_SIZE_SERVER, published.getOldestIndex());
+	EXPECT_FALSE(published.isSeqInBounds(oldestSeq));
+	EXPECT_TRUE(published.isSeqInBounds(oldestSeq + 1));
+	EXPECT_FALSE(published.isIndexInBounds(oldestIndex));
+	EXPECT_TRUE(published.isIndexInBounds(currentIndex));
+
+	// original goes on, the copy keeps its view
+	historyBuffer.addSeq(100.0, &objectManager, &peers);
+	EXPECT_EQ(oldestIndex, historyBuffer.getCurrentSeqIndex());
+	EXPECT_EQ(currentIndex, published.getCurrentSeqIndex());
+}
@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/ObjectManager.h"
+#include "src/server/HistoryBuffer.h"
+#include "src/server/NetworkObject.h"
+#include "src/server/Peer.h"
+#include "src/server/SnapshotArena.h"
+#include "src/ObjectClassDefinition.h"
+#include <vector>
+#include <map>
+
+TEST(ServerObjectManager_Unit, reclaimExpiredObjects) {
+
+	nsl::server::HistoryBuffer historyBuffer;
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(0.0, &objectManager, &peers);
+
+	std::vector<unsigned int> ids;
+	for (unsigned int i = 0; i < 3 * NSL_RECLAIM_OBJECTS_PER_TICK; i++) {
+		nsl::server::NetworkObject* o = objectManager.createObject(0, &historyBuffer);
+		ids.push_back(o->getId());
+	}
+	nsl::server::NetworkObject* kept = objectManager.createObject(0, &historyBuffer);
+
+	historyBuffer.addSeq(1.0, &objectManager, &peers);
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		objectManager.findObjectById(ids[i])->destroy();
+	}
+
+	// objects are found until their data leave history
+	for (unsigned int i = 2; i <= NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+		historyBuffer.addSeq(i, &objectManager, &peers);
+	}
+	EXPECT_TRUE(objectManager.findObjectById(ids[0]) != NULL);
+	EXPECT_EQ(NSL_UNDEFINED_BUFFER_INDEX, kept->getCreationIndex());
+
+	// then they are forgotten at once, but deleted in parts
+	historyBuffer.addSeq(NSL_PACKET_BUFFER_SIZE_SERVER + 1, &objectManager, &peers);
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		EXPECT_TRUE(objectManager.findObjectById(ids[i]) == NULL);
+	}
+	EXPECT_EQ(kept, objectManager.findObjectById(kept->getId()));
+	EXPECT_EQ(1, objectManager.objectsEnd() - objectManager.objectsBegin());
+	EXPECT_EQ(2 * NSL_RECLAIM_OBJECTS_PER_TICK, objectManager.getExpiredObjectCount());
+
+	historyBuffer.addSeq(NSL_PACKET_BUFFER_SIZE_SERVER + 2, &objectManager, &peers);
+	historyBuffer.addSeq(NSL_PACKET_BUFFER_SIZE_SERVER + 3, &objectManager, &peers);
+	EXPECT_EQ(0, objectManager.getExpiredObjectCount());
+}
+
+TEST(ServerObjectManager_Unit, attributeGroups) {
+
+	nsl::server::HistoryBuffer historyBuffer;
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	oc.defineAttribute<nsl::uint32>(1);
+	oc.defineAttributeGroup(1, 4, 3.0);
+	oc.setAttributeGroup(1, 1);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(0.0, &objectManager, &peers);
+
+	// initial values are written at once
+	nsl::server::NetworkObject* o = objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 1;
+	o->set(1, 4, (nsl::byte*)&value);
+	nsl::server::SnapshotArena* arena = o->getArena();
+	EXPECT_EQ(1, *(unsigned int*)arena->getAttribute(historyBuffer.getCurrentSeqIndex(), o->getSlot(), 1));
+
+	// changes of the slow group reach history only in its ticks, the last value wins
+	unsigned int sent = value;
+	int dueTicks = 0;
+	for (unsigned int tick = 1; tick <= 8; tick++) {
+		historyBuffer.addSeq(tick, &objectManager, &peers);
+		int index = historyBuffer.getCurrentSeqIndex();
+		int previousIndex = (index + NSL_PACKET_BUFFER_SIZE_SERVER - 1) % NSL_PACKET_BUFFER_SIZE_SERVER;
+		value = tick * 10;
+		o->set(1, 4, (nsl::byte*)&value);
+		value++;
+		o->set(1, 4, (nsl::byte*)&value);
+		o->set(0, 4, (nsl::byte*)&value);
+
+		bool due = (tick + o->getId()) % 4 == 0;
+		if (due) {
+			sent = value;
+			dueTicks++;
+		}
+		EXPECT_EQ(value, *(unsigned int*)arena->getAttribute(index, o->getSlot(), 0));
+		EXPECT_EQ(sent, *(unsigned int*)arena->getAttribute(index, o->getSlot(), 1));
+		EXPECT_EQ(due, o->isAttributeChangedSince(1, previousIndex));
+		EXPECT_DOUBLE_EQ(due ? 3.0 : 1.0, o->getChangePriority(previousIndex));
+	}
+	EXPECT_EQ(2, dueTicks);
+
+	// value waiting for the group is written without being set again
+	historyBuffer.addSeq(9.0, &objectManager, &peers);
+	value = 99;
+	o->set(1, 4, (nsl::byte*)&value);
+	for (unsigned int tick = 10; tick <= 13; tick++) {
+		historyBuffer.addSeq(tick, &objectManager, &peers);
+		unsigned int stored = *(unsigned int*)arena->getAttribute(historyBuffer.getCurrentSeqIndex(), o->getSlot(), 1);
+		EXPECT_EQ((tick + o->getId()) % 4 == 0 ? 99 : sent, stored);
+		sent = stored;
+	}
+	EXPECT_EQ(99, sent);
+}
+
+TEST(ServerObjectManager_Unit, heldChanges) {
+
+	nsl::server::HistoryBuffer historyBuffer;
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(0.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* changed = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* destroyed = objectManager.createObject(0, &historyBuffer);
+	historyBuffer.addSeq(1.0, &objectManager, &peers);
+	long tick = historyBuffer.getCurrentTick();
+
+	// update of this index is being encoded, changes made meanwhile are not seen by it
+	objectManager.setHoldingChanges(true);
+	historyBuffer.addSeq(2.0, &objectManager, &peers);
+	unsigned int value = 1;
+	changed->set(0, sizeof(value), (nsl::byte*)&value);
+	changed->setPriority(5);
+	destroyed->destroy();
+	EXPECT_FALSE(changed->isChangedSinceTick(tick));
+	EXPECT_EQ(1, changed->getPublishedPriority());
+	EXPECT_EQ(NSL_UNDEFINED_BUFFER_INDEX, destroyed->getPublishedDestroyIndex());
+
+	// the destroyed object is not deleted before its destruction is published
+	for (unsigned int i = 3; i <= NSL_PACKET_BUFFER_SIZE_SERVER + 2; i++) {
+		historyBuffer.addSeq(i, &objectManager, &peers);
+	}
+	EXPECT_TRUE(objectManager.findObjectById(destroyed->getId()) == NULL);
+	EXPECT_EQ(1, objectManager.getExpiredObjectCount());
+
+	objectManager.publishChanges();
+	EXPECT_TRUE(changed->isChangedSinceTick(tick));
+	EXPECT_EQ(5, changed->getPublishedPriority());
+	EXPECT_NE(NSL_UNDEFINED_BUFFER_INDEX, destroyed->getPublishedDestroyIndex());
+
+	// changes are seen at once, when they are not held back
+	objectManager.setHoldingChanges(false);
+	value = 2;
+	changed->set(0, sizeof(value), (nsl::byte*)&value);
+	EXPECT_TRUE(changed->isChangedSinceTick(historyBuffer.getCurrentTick() - 1));
+	historyBuffer.addSeq(NSL_PACKET_BUFFER_SIZE_SERVER + 3, &objectManager, &peers);
+	EXPECT_EQ(0, objectManager.getExpiredObjectCount());
+}
@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/Connection.h"
+#include "src/server/Peer.h"
+#include <vector>
+
+static bool flush(nsl::server::Peer& peer, int bufferIndex, int ackIndex)
+{
+	if (!peer.isUpdateDue(ackIndex)) {
+		return false;
+	}
+	peer.setUpdateSent(bufferIndex);
+	return true;
+}
+
+TEST(ServerPeer_Unit, fixedSendInterval) {
+	nsl::Address addr;
+	nsl::server::Peer peer(new nsl::server::PeerConnection(1, addr));
+	EXPECT_TRUE(flush(peer, 0, NSL_UNDEFINED_BUFFER_INDEX));
+
+	peer.setSendInterval(3);
+	EXPECT_EQ(3, peer.getSendInterval());
+	EXPECT_FALSE(flush(peer, 1, NSL_UNDEFINED_BUFFER_INDEX));
+	EXPECT_FALSE(flush(peer, 2, 0));
+	EXPECT_TRUE(flush(peer, 3, 0));
+	EXPECT_FALSE(flush(peer, 4, 0));
+	EXPECT_FALSE(flush(peer, 5, 3));
+	EXPECT_TRUE(flush(peer, 6, 3));
+
+	// fixed interval does not react to missing acks
+	for (int i = 7; i < 40; i++) {
+		flush(peer, i, 3);
+	}
+	EXPECT_EQ(3, peer.getSendInterval());
+}
+
+/// Simulate flushes of a peer, whose acks come the given number of flushes after the update is sent
+/// Negative round trip means that no ack comes at all
+static void flushOverLink(nsl::server::Peer& peer, int& flushIndex, int flushCount, int roundTrip, std::vector<int>& sentFlushes)
+{
+	for (int last = flushIndex + flushCount; flushIndex < last; flushIndex++) {
+		int ackIndex = NSL_UNDEFINED_BUFFER_INDEX;
+		for (int i = sentFlushes.size() - 1; roundTrip >= 0 && i >= 0; i--) {
+			if (sentFlushes[i] + roundTrip <= flushIndex) {
+				ackIndex = sentFlushes[i] % NSL_PACKET_BUFFER_SIZE_SERVER;
+				break;
+			}
+		}
+		if (flush(peer, flushIndex % NSL_PACKET_BUFFER_SIZE_SERVER, ackIndex)) {
+			sentFlushes.push_back(flushIndex);
+		}
+	}
+}
+
+TEST(ServerPeer_Unit, automaticSendInterval) {
+	nsl::Address addr;
+	nsl::server::Peer peer(new nsl::server::PeerConnection(1, addr));
+	peer.setSendInterval(0);
+	EXPECT_EQ(1, peer.getSendInterval());
+
+	// short round trip does not throttle
+	int flushIndex = 0;
+	std::vector<int> sentFlushes;
+	flushOverLink(peer, flushIndex, 20, 2, sentFlushes);
+	EXPECT_EQ(1, peer.getSendInterval());
+
+	// acks stop coming, interval doubles once per round trip
+	flushOverLink(peer, flushIndex, 4 + NSL_PEER_MAX_QUEUE_DELAY, -1, sentFlushes);
+	EXPECT_EQ(2, peer.getSendInterval());
+	flushOverLink(peer, flushIndex, 6, -1, sentFlushes);
+	EXPECT_EQ(2, peer.getSendInterval());
+
+	// queue grows, acks come later than the shortest round trip allows
+	flushOverLink(peer, flushIndex, 10, 4 + 2 * NSL_PEER_MAX_QUEUE_DELAY, sentFlushes);
+	EXPECT_EQ(4, peer.getSendInterval());
+
+	// link keeps up again, interval returns to one
+	flushOverLink(peer, flushIndex, 40, 2, sentFlushes);
+	EXPECT_EQ(1, peer.getSendInterval());
+}
+
+TEST(ServerPeer_Unit, automaticSendIntervalLongRoundTrip) {
+	nsl::Address addr;
+	nsl::server::Peer peer(new nsl::server::PeerConnection(1, addr));
+	peer.setSendInterval(0);
+
+	// many updates are in flight, but no ack is late, so the peer is not throttled
+	int flushIndex = 0;
+	std::vector<int> sentFlushes;
+	flushOverLink(peer, flushIndex, 3 * NSL_PACKET_BUFFER_SIZE_SERVER, 6 * NSL_PEER_MAX_QUEUE_DELAY, sentFlushes);
+	EXPECT_EQ(1, peer.getSendInterval());
+	EXPECT_EQ(3 * NSL_PACKET_BUFFER_SIZE_SERVER, peer.getSentUpdateCount());
+}
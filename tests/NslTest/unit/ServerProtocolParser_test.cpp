@@ -6,6 +6,7 @@
 #include "src/server/HistoryBuffer.h"
 #include "src/server/ObjectManager.h"
 #include "src/server/NetworkObject.h"
+#include "src/server/SnapshotArena.h"
 #include "src/ObjectClassDefinition.h"
 #include <iostream>
 #include <string>
@@ -25,7 +26,7 @@ TEST(ServerProtocolParser_Unit, createHeader) {
 	historyBuffer.addSeq(25.0, &objectManager, &peers);
 
 	nsl::BitStreamWriter writer;
-	std::set<nsl::server::NetworkObject*> scope;
+	std::vector<nsl::server::NetworkObject*> scope;
 	parser.writeUpdateToPeer(&writer, &peer, scope, historyBuffer.getCurrentSeqIndex());
 
 	unsigned int size;
@@ -55,13 +56,12 @@ TEST(ServerProtocolParser_Unit, addNewObjects) {
 	oc.defineAttribute<nsl::uint8>(0);
 	oc.defineAttribute<nsl::uint32>(1);
 	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
 	historyBuffer.addSeq(25.0, &objectManager, &peers);
 
-	std::set<nsl::server::NetworkObject*> scope;
-	nsl::server::NetworkObject o(&ocd, &historyBuffer, 1);
-	nsl::server::NetworkObject o2(&ocd, &historyBuffer, 2);
-	scope.insert(&o);
-	scope.insert(&o2);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(objectManager.createObject(0, &historyBuffer));
+	scope.push_back(objectManager.createObject(0, &historyBuffer));
 
 	nsl::BitStreamWriter writer;
 	parser.writeUpdateToPeer(&writer, &peer, scope, historyBuffer.getCurrentSeqIndex());
@@ -82,15 +82,846 @@ TEST(ServerProtocolParser_Unit, addNewObjects) {
 	EXPECT_EQ(flag.scopeCreate, NSL_OBJECT_FLAG_SC_BIRTH);
 	EXPECT_EQ(0, reader.read<nsl::uint16>());
 
-	unsigned int expectedId = 3 - reader.read<nsl::uint32>();
+	EXPECT_EQ(0, reader.read<nsl::uint32>());
 	reader.skipBits(40);
 	reader >> flag;
 	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_CREATE);
 	EXPECT_EQ(flag.scopeCreate, NSL_OBJECT_FLAG_SC_BIRTH);
 	EXPECT_EQ(0, reader.read<nsl::uint16>());
-	EXPECT_EQ(expectedId, reader.read<nsl::uint32>());
+	EXPECT_EQ(1, reader.read<nsl::uint32>());
 	reader.skipBits(40);
 	reader >> flag;
 	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
 	ASSERT_EQ(0, reader.getRemainingByteSize());
-}
\ No newline at end of file
+}
+
+TEST(ServerProtocolParser_Unit, sharedCreationRecords) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::PeerConnection* pc2 = new nsl::server::PeerConnection(2, addr);
+	nsl::server::Peer peer(pc);
+	nsl::server::Peer peer2(pc2);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(2, &peer2));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject& o = *objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 7;
+	o.set(0, sizeof(value), (nsl::byte*)&value);
+
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(&o);
+	nsl::BitStreamWriter writer;
+	parser.writeUpdateToPeer(&writer, &peer, scope, historyBuffer.getCurrentSeqIndex());
+
+	// second peer gets the same record, even if the data changed meanwhile
+	value = 8;
+	o.set(0, sizeof(value), (nsl::byte*)&value);
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer2, scope, historyBuffer.getCurrentSeqIndex());
+
+	unsigned int size, size2;
+	nsl::byte* data = writer.toBytes(size);
+	nsl::byte* data2 = writer2.toBytes(size2);
+	ASSERT_EQ(size, size2);
+	EXPECT_EQ(0, memcmp(data, data2, size));
+
+	// after invalidation, new data are encoded
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer3;
+	parser.writeUpdateToPeer(&writer3, &peer2, scope, historyBuffer.getCurrentSeqIndex());
+
+	unsigned int size3;
+	nsl::byte* data3 = writer3.toBytes(size3);
+	nsl::BitStreamReader reader(data3, size3, true);
+	reader.skipBits(14*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_CREATE);
+	EXPECT_EQ(0, reader.read<nsl::uint16>());
+	EXPECT_EQ(0, reader.read<nsl::uint32>());
+	EXPECT_EQ(8, reader.read<nsl::uint32>());
+
+	delete[] data;
+	delete[] data2;
+}
+
+TEST(ServerProtocolParser_Unit, changedAttributesOnly) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint8>(0);
+	oc.defineAttribute<nsl::uint32>(1);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* changed = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* unchanged = objectManager.createObject(0, &historyBuffer);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(changed);
+	scope.push_back(unchanged);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// next tick changes only the second attribute of one object
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	parser.invalidateCache();
+	unsigned int value = 9;
+	changed->set(1, sizeof(value), (nsl::byte*)&value);
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex);
+
+	// header, flags + mask + uint32 of changed object, flags of unchanged one, end of section
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	ASSERT_EQ(14 + 6 + 1 + 1, size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+
+	std::vector<nsl::server::NetworkObject*>* ackScope = peer.getScope(ackIndex);
+	for (std::vector<nsl::server::NetworkObject*>::iterator it = ackScope->begin(); it != ackScope->end(); it++) {
+		nsl::ObjectFlags flag;
+		reader >> flag;
+		if (*it == changed) {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+			EXPECT_EQ(2, reader.readByte());
+			EXPECT_EQ(9, reader.read<nsl::uint32>());
+		} else {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+		}
+	}
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+	ASSERT_EQ(0, reader.getRemainingByteSize());
+}
+
+TEST(ServerProtocolParser_Unit, scopeChanges) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint8>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* objects[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		objects[i] = objectManager.createObject(0, &historyBuffer);
+	}
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(objects[0]);
+	scope.push_back(objects[1]);
+	scope.push_back(objects[2]);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// the second object leaves the scope, the fourth one enters it
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	parser.invalidateCache();
+	scope.clear();
+	scope.push_back(objects[0]);
+	scope.push_back(objects[2]);
+	scope.push_back(objects[3]);
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DELETE);
+	EXPECT_EQ(flag.scopeDestroy, NSL_OBJECT_FLAG_SD_HIDE);
+	EXPECT_EQ(0, reader.readByte());
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_CREATE);
+	EXPECT_EQ(flag.scopeCreate, NSL_OBJECT_FLAG_SC_SHOW);
+	EXPECT_EQ(0, reader.read<nsl::uint16>());
+	EXPECT_EQ(objects[3]->getId(), reader.read<nsl::uint32>());
+	reader.skipBits(8);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+
+	// peer scope of current tick is the new scope
+	std::vector<nsl::server::NetworkObject*>* seqScope = peer.getScope(historyBuffer.getCurrentSeqIndex());
+	ASSERT_EQ(3, seqScope->size());
+	EXPECT_EQ(objects[3], (*seqScope)[2]);
+}
+
+TEST(ServerProtocolParser_Unit, byteBudget) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* objects[4];
+	std::vector<nsl::server::NetworkObject*> scope;
+	for (unsigned int i = 0; i < 3; i++) {
+		objects[i] = objectManager.createObject(0, &historyBuffer);
+		scope.push_back(objects[i]);
+	}
+	nsl::BitStreamWriter writer;
+	int firstIndex = historyBuffer.getCurrentSeqIndex();
+	nsl::seqNumber firstSeq = historyBuffer.indexToSeq(firstIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, firstIndex);
+
+	// all objects change, but only one diff fits into budget (header, end of section, 3 flags, mask + uint32)
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	parser.invalidateCache();
+	unsigned int value = 7;
+	for (unsigned int i = 0; i < 3; i++) {
+		objects[i]->set(0, sizeof(value), (nsl::byte*)&value);
+	}
+	objects[2]->setPriority(3);
+	objects[3] = objectManager.createObject(0, &historyBuffer);
+	scope.push_back(objects[3]);
+	peer.setByteBudget(14 + 1 + 3 + 5);
+	peer.publish();
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, firstIndex);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	ASSERT_EQ(14 + 1 + 3 + 5, size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+	EXPECT_EQ(1, reader.readByte());
+	EXPECT_EQ(7, reader.read<nsl::uint32>());
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+
+	// object which did not fit is not created yet, skipped objects keep their base
+	int secondIndex = historyBuffer.getCurrentSeqIndex();
+	std::vector<nsl::server::NetworkObject*>* seqScope = peer.getScope(secondIndex);
+	std::vector<nsl::seqNumber>* seqBases = peer.getScopeBases(secondIndex);
+	ASSERT_EQ(3, seqScope->size());
+	EXPECT_EQ(objects[2], (*seqScope)[2]);
+	EXPECT_EQ(firstSeq, (*seqBases)[0]);
+	EXPECT_EQ(firstSeq, (*seqBases)[1]);
+	EXPECT_EQ(historyBuffer.indexToSeq(secondIndex), (*seqBases)[2]);
+
+	// without budget, skipped objects are sent against the data client has
+	historyBuffer.addSeq(27.0, &objectManager, &peers);
+	parser.invalidateCache();
+	peer.setByteBudget(0);
+	peer.publish();
+	nsl::BitStreamWriter writer3;
+	parser.writeUpdateToPeer(&writer3, &peer, scope, secondIndex);
+
+	data = writer3.toBytes(size);
+	nsl::BitStreamReader reader2(data, size, true);
+	reader2.skipBits(14*8);
+	for (unsigned int i = 0; i < 2; i++) {
+		reader2 >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+		EXPECT_EQ(1, reader2.readByte());
+		EXPECT_EQ(7, reader2.read<nsl::uint32>());
+	}
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_CREATE);
+	EXPECT_EQ(0, reader2.read<nsl::uint16>());
+	EXPECT_EQ(objects[3]->getId(), reader2.read<nsl::uint32>());
+	reader2.skipBits(4*8);
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+}
+
+TEST(ServerProtocolParser_Unit, keyframeForOldAck) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* object = objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 3;
+	object->set(0, sizeof(value), (nsl::byte*)&value);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(object);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	peer.setUpdateSent(ackIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// unchanged object is not sent while the ack is recent enough, age is counted in updates sent to the peer
+	for (unsigned int i = 1; i < NSL_KEYFRAME_ACK_AGE; i++) {
+		historyBuffer.addSeq(25.0 + i, &objectManager, &peers);
+		peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	}
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+
+	// then absolute values of changed object are sent instead
+	historyBuffer.addSeq(25.0 + NSL_KEYFRAME_ACK_AGE, &objectManager, &peers);
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.invalidateCache();
+	value = 5;
+	object->set(0, sizeof(value), (nsl::byte*)&value);
+	nsl::BitStreamWriter writer3;
+	parser.writeUpdateToPeer(&writer3, &peer, scope, ackIndex);
+
+	data = writer3.toBytes(size);
+	nsl::BitStreamReader reader2(data, size, true);
+	reader2.skipBits(14*8);
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SNAPSHOT);
+	EXPECT_EQ(5, reader2.read<nsl::uint32>());
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+}
+
+TEST(ServerProtocolParser_Unit, cleanObjects) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* still = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* moving = objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 7;
+	still->set(0, sizeof(value), (nsl::byte*)&value);
+
+	// clean object keeps its data in every index, although it is copied only after its change
+	for (unsigned int i = 1; i < 2 * NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+		historyBuffer.addSeq(25.0 + i, &objectManager, &peers);
+		moving->set(0, sizeof(i), (nsl::byte*)&i);
+		if (i % 3 == 0) {
+			// setting the same value does not make object dirty
+			still->set(0, sizeof(value), (nsl::byte*)&value);
+		}
+		int currentIndex = historyBuffer.getCurrentSeqIndex();
+		EXPECT_EQ(7, *(unsigned int*)still->getArena()->getAttribute(currentIndex, still->getSlot(), 0));
+		EXPECT_EQ(i, *(unsigned int*)moving->getArena()->getAttribute(currentIndex, moving->getSlot(), 0));
+		EXPECT_FALSE(still->isChangedSince((currentIndex + NSL_PACKET_BUFFER_SIZE_SERVER - 1) % NSL_PACKET_BUFFER_SIZE_SERVER));
+		EXPECT_TRUE(moving->isChangedSince((currentIndex + NSL_PACKET_BUFFER_SIZE_SERVER - 1) % NSL_PACKET_BUFFER_SIZE_SERVER));
+	}
+
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(still);
+	scope.push_back(moving);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	peer.setFirstUpdateIndex(ackIndex);
+	peer.setUpdateSent(ackIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// clean object is not sent even in keyframe
+	for (unsigned int i = 0; i < NSL_KEYFRAME_ACK_AGE; i++) {
+		historyBuffer.addSeq(100.0 + i, &objectManager, &peers);
+		peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	}
+	parser.invalidateCache();
+	value = 8;
+	moving->set(0, sizeof(value), (nsl::byte*)&value);
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+	std::vector<nsl::server::NetworkObject*>* ackScope = peer.getScope(ackIndex);
+	for (std::vector<nsl::server::NetworkObject*>::iterator it = ackScope->begin(); it != ackScope->end(); it++) {
+		nsl::ObjectFlags flag;
+		reader >> flag;
+		if (*it == moving) {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SNAPSHOT);
+			EXPECT_EQ(8, reader.read<nsl::uint32>());
+		} else {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+		}
+	}
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+}
+
+TEST(ServerProtocolParser_Unit, relevanceSkip) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* near = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* far = objectManager.createObject(0, &historyBuffer);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(near);
+	scope.push_back(far);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	nsl::seqNumber ackSeq = historyBuffer.indexToSeq(ackIndex);
+	peer.setUpdateSent(ackIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// both objects change, only the near one is due
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.invalidateCache();
+	unsigned int value = 4;
+	near->set(0, sizeof(value), (nsl::byte*)&value);
+	far->set(0, sizeof(value), (nsl::byte*)&value);
+	std::vector<char> due;
+	due.push_back(true);
+	due.push_back(false);
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex, &due);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.skipBits(14*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+	EXPECT_EQ(1, reader.readByte());
+	EXPECT_EQ(4, reader.read<nsl::uint32>());
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SKIP);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+
+	// skipped object keeps its base
+	std::vector<nsl::seqNumber>* seqBases = peer.getScopeBases(historyBuffer.getCurrentSeqIndex());
+	ASSERT_EQ(2, seqBases->size());
+	EXPECT_EQ(ackSeq + 1, (*seqBases)[0]);
+	EXPECT_EQ(ackSeq, (*seqBases)[1]);
+
+	// object which was not sent for too long is due anyway
+	for (unsigned int i = 1; i < NSL_PEER_BUDGET_MAX_SKIPPED_UPDATES; i++) {
+		historyBuffer.addSeq(26.0 + i, &objectManager, &peers);
+		peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	}
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer3;
+	parser.writeUpdateToPeer(&writer3, &peer, scope, ackIndex, &due);
+
+	data = writer3.toBytes(size);
+	nsl::BitStreamReader reader2(data, size, true);
+	reader2.skipBits(14*8);
+	for (unsigned int i = 0; i < 2; i++) {
+		reader2 >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+		reader2.skipBits(5*8);
+	}
+	reader2 >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+}
+
+TEST(ServerProtocolParser_Unit, throttledPeerDiffs) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	peer.setSendInterval(NSL_PEER_MAX_SEND_INTERVAL);
+	peer.publish();
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* near = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* far = objectManager.createObject(0, &historyBuffer);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(near);
+	scope.push_back(far);
+	std::vector<char> due;
+	due.push_back(true);
+	due.push_back(false);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	peer.setUpdateSent(ackIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// every update of the peer acknowledges the previous one, objects change in every tick
+	for (unsigned int update = 0; update < 2; update++) {
+		for (unsigned int i = 1; i <= NSL_PEER_MAX_SEND_INTERVAL; i++) {
+			historyBuffer.addSeq(25.0 + update * NSL_PEER_MAX_SEND_INTERVAL + i, &objectManager, &peers);
+			unsigned int value = update * NSL_PEER_MAX_SEND_INTERVAL + i;
+			near->set(0, sizeof(value), (nsl::byte*)&value);
+			far->set(0, sizeof(value), (nsl::byte*)&value);
+		}
+		parser.invalidateCache();
+		peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+		nsl::BitStreamWriter writer2;
+		parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex, &due);
+		ackIndex = historyBuffer.getCurrentSeqIndex();
+
+		// ack is one update old, so changes are sent as diffs, not keyframe
+		// object not due is skipped, until its data would not last in history until the next ack
+		unsigned int size;
+		nsl::byte* data = writer2.toBytes(size);
+		nsl::BitStreamReader reader(data, size, true);
+		reader.skipBits(14*8);
+		nsl::ObjectFlags flag;
+		reader >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+		reader.skipBits(5*8);
+		reader >> flag;
+		if (update == 0) {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SKIP);
+		} else {
+			EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+			reader.skipBits(5*8);
+		}
+		reader >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+	}
+}
+
+TEST(ServerProtocolParser_Unit, throttledPeerUpdatePeriod) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	peer.setSendInterval(4);
+	peer.publish();
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* near = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* far = objectManager.createObject(0, &historyBuffer);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(near);
+	scope.push_back(far);
+	std::vector<char> due;
+	due.push_back(true);
+	due.push_back(false);
+	nsl::BitStreamWriter writer;
+	int ackIndex = historyBuffer.getCurrentSeqIndex();
+	peer.setUpdateSent(ackIndex);
+	parser.writeUpdateToPeer(&writer, &peer, scope, ackIndex);
+
+	// object with the longest update period is not forced due during its period, although it spans more than half of history
+	for (unsigned int update = 0; update < NSL_MAX_UPDATE_PERIOD - 1; update++) {
+		for (unsigned int i = 1; i <= 4; i++) {
+			historyBuffer.addSeq(25.0 + update * 4 + i, &objectManager, &peers);
+			unsigned int value = update * 4 + i;
+			near->set(0, sizeof(value), (nsl::byte*)&value);
+			far->set(0, sizeof(value), (nsl::byte*)&value);
+		}
+		parser.invalidateCache();
+		peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+		nsl::BitStreamWriter writer2;
+		parser.writeUpdateToPeer(&writer2, &peer, scope, ackIndex, &due);
+		ackIndex = historyBuffer.getCurrentSeqIndex();
+
+		unsigned int size;
+		nsl::byte* data = writer2.toBytes(size);
+		nsl::BitStreamReader reader(data, size, true);
+		reader.skipBits(14*8);
+		nsl::ObjectFlags flag;
+		reader >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+		reader.skipBits(5*8);
+		reader >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SKIP);
+		reader >> flag;
+		EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+	}
+}
+
+TEST(ServerProtocolParser_Unit, progressiveJoin) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::float32>(0);
+	oc.defineAttribute<nsl::float32>(1);
+	oc.setPositionAttributes(0, 1);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	// objects with higher ids are nearer to the view
+	std::vector<nsl::server::NetworkObject*> scope;
+	for (unsigned int i = 0; i < 1000; i++) {
+		nsl::server::NetworkObject* o = objectManager.createObject(0, &historyBuffer);
+		float x = (float)i;
+		o->set(0, sizeof(x), (nsl::byte*)&x);
+		scope.push_back(o);
+	}
+	peer.setView(1000, 0, 0, 100);
+	peer.publish();
+
+	// the first update creates only the nearest objects
+	nsl::BitStreamWriter writer;
+	parser.writeUpdateToPeer(&writer, &peer, scope, NSL_UNDEFINED_BUFFER_INDEX);
+	int firstIndex = historyBuffer.getCurrentSeqIndex();
+	std::vector<nsl::server::NetworkObject*>* created = peer.getScope(firstIndex);
+	unsigned int firstCount = created->size();
+	ASSERT_GT(firstCount, 0);
+	EXPECT_LT(firstCount, 1000);
+	EXPECT_LE(writer.getByteSize(), NSL_PEER_CREATION_BYTES + 15);
+	EXPECT_EQ(scope[1000 - firstCount], created->front());
+	EXPECT_EQ(scope.back(), created->back());
+
+	// the next ones follow, when the first part is acknowledged
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, firstIndex);
+	created = peer.getScope(historyBuffer.getCurrentSeqIndex());
+	EXPECT_EQ(2 * firstCount, created->size());
+	EXPECT_EQ(scope[1000 - 2 * firstCount], created->front());
+}
+
+TEST(ServerProtocolParser_Unit, resumeAfterAckLeftHistory) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	// peer is declared after objects, so it releases its retained scope first
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* changed = objectManager.createObject(0, &historyBuffer);
+	nsl::server::NetworkObject* clean = objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 1;
+	changed->set(0, sizeof(value), (nsl::byte*)&value);
+	clean->set(0, sizeof(value), (nsl::byte*)&value);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(changed);
+	scope.push_back(clean);
+	nsl::BitStreamWriter writer;
+	nsl::seqNumber ackSeq = historyBuffer.indexToSeq(historyBuffer.getCurrentSeqIndex());
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.writeUpdateToPeer(&writer, &peer, scope, NSL_UNDEFINED_BUFFER_INDEX);
+	peer.setLastAck(ackSeq);
+
+	// peer is silent (or disconnected) until its ack leaves the history, one object changes meanwhile
+	for (unsigned int i = 1; i <= NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+		historyBuffer.addSeq(25.0 + i, &objectManager, &peers);
+		if (i == 1) {
+			value = 2;
+			changed->set(0, sizeof(value), (nsl::byte*)&value);
+		}
+	}
+	ASSERT_FALSE(historyBuffer.isSeqInBounds(ackSeq));
+	EXPECT_TRUE(changed->isPinned());
+	EXPECT_TRUE(clean->isPinned());
+
+	// resumed peer gets an update against its retained ack, objects are not created again
+	// data of the ack are not in history anymore, so the changed object is diffed against data retained by the peer
+	peer.publish();
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer2;
+	parser.writeUpdateToPeer(&writer2, &peer, scope, NSL_UNDEFINED_BUFFER_INDEX);
+
+	unsigned int size;
+	nsl::byte* data = writer2.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	EXPECT_EQ(historyBuffer.indexToSeq(historyBuffer.getCurrentSeqIndex()), reader.read<nsl::Attribute<nsl::seqNumber> >());
+	EXPECT_EQ(ackSeq, reader.read<nsl::Attribute<nsl::seqNumber> >());
+	reader.skipBits(10*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_DIFF);
+	EXPECT_EQ(1, reader.read<nsl::uint8>());
+	EXPECT_EQ(1 ^ 2, reader.read<nsl::uint32>());
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_NO_CHANGE);
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+
+	// both objects are in the new scope with the current seq as base
+	std::vector<nsl::server::NetworkObject*>* seqScope = peer.getScope(historyBuffer.getCurrentSeqIndex());
+	ASSERT_EQ(2, seqScope->size());
+	EXPECT_EQ(historyBuffer.indexToSeq(historyBuffer.getCurrentSeqIndex()), (*peer.getScopeBases(historyBuffer.getCurrentSeqIndex()))[0]);
+}
+
+TEST(ServerProtocolParser_Unit, resumeWithOlderBase) {
+	
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ProtocolParser parser(&historyBuffer);
+
+	nsl::server::ObjectManager objectManager;
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+	nsl::Address addr;
+	nsl::server::PeerConnection* pc = new nsl::server::PeerConnection(1, addr);
+	nsl::server::Peer peer(pc);
+	std::map<unsigned int, nsl::server::Peer*> peers;
+	peers.insert(std::pair<unsigned int, nsl::server::Peer*>(1, &peer));
+	historyBuffer.addSeq(25.0, &objectManager, &peers);
+
+	nsl::server::NetworkObject* object = objectManager.createObject(0, &historyBuffer);
+	unsigned int value = 1;
+	object->set(0, sizeof(value), (nsl::byte*)&value);
+	std::vector<nsl::server::NetworkObject*> scope;
+	scope.push_back(object);
+	nsl::BitStreamWriter writer;
+	nsl::seqNumber firstSeq = historyBuffer.indexToSeq(historyBuffer.getCurrentSeqIndex());
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.writeUpdateToPeer(&writer, &peer, scope, NSL_UNDEFINED_BUFFER_INDEX);
+	peer.setLastAck(firstSeq);
+
+	// the object is skipped in the next update, so its base stays older than the ack
+	historyBuffer.addSeq(26.0, &objectManager, &peers);
+	value = 2;
+	object->set(0, sizeof(value), (nsl::byte*)&value);
+	std::vector<char> due(1, false);
+	nsl::BitStreamWriter writer2;
+	nsl::seqNumber ackSeq = historyBuffer.indexToSeq(historyBuffer.getCurrentSeqIndex());
+	peer.publish();
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.invalidateCache();
+	parser.writeUpdateToPeer(&writer2, &peer, scope, historyBuffer.seqToIndex(firstSeq), &due);
+	ASSERT_EQ(firstSeq, (*peer.getScopeBases(historyBuffer.getCurrentSeqIndex()))[0]);
+	peer.setLastAck(ackSeq);
+
+	for (unsigned int i = 1; i <= NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+		historyBuffer.addSeq(26.0 + i, &objectManager, &peers);
+	}
+	ASSERT_FALSE(historyBuffer.isSeqInBounds(ackSeq));
+
+	// data the client has were not retained, so the object is sent in full
+	peer.publish();
+	peer.setUpdateSent(historyBuffer.getCurrentSeqIndex());
+	parser.invalidateCache();
+	nsl::BitStreamWriter writer3;
+	parser.writeUpdateToPeer(&writer3, &peer, scope, NSL_UNDEFINED_BUFFER_INDEX);
+
+	unsigned int size;
+	nsl::byte* data = writer3.toBytes(size);
+	nsl::BitStreamReader reader(data, size, true);
+	reader.read<nsl::Attribute<nsl::seqNumber> >();
+	EXPECT_EQ(ackSeq, reader.read<nsl::Attribute<nsl::seqNumber> >());
+	reader.skipBits(10*8);
+	nsl::ObjectFlags flag;
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_SNAPSHOT);
+	EXPECT_EQ(2, reader.read<nsl::uint32>());
+	reader >> flag;
+	EXPECT_EQ(flag.action, NSL_OBJECT_FLAG_ACTION_END_OF_SECTION);
+}
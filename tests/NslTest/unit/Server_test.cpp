@@ -0,0 +1,445 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/Socket.h"
+#include "src/Thread.h"
+#include "src/compression/compression.h"
+#include "include/nslServer.h"
+#include "include/nslClient.h"
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+// client written by hand, so updates sent by the server can be checked byte by byte
+class RawPeer
+{
+public:
+	nsl::Socket socket;
+	nsl::Address server;
+	nsl::byte buffer[NSL_MAX_UDP_PACKET_SIZE];
+	nsl::byte update[NSL_MAX_UDP_PACKET_SIZE * 4];
+	unsigned int id;
+
+	RawPeer(const char* port, const char* serverPort) {
+		socket.open(port);
+		socket.getAddressFromStrings(server, "127.0.0.1", serverPort);
+		id = 0;
+	}
+
+	/// go through the whole handshake, return false if the server did not accept the peer
+	bool connect(nsl::Server& s, double time) {
+		static unsigned int nonce = 1;
+		nonce++;
+		nsl::byte data[11];
+		nsl::BitStreamWriter request(data, 10);
+		request.write<nsl::uint16>(1);
+		request.write<nsl::uint32>(0);
+		request.write<nsl::uint32>(nonce);
+		socket.send(server, data, 10);
+		s.updateNetwork(time);
+		if (receive() != 11) {
+			return false;
+		}
+		unsigned int cookie = readUint32(2);
+
+		nsl::BitStreamWriter handshake(data, 11);
+		handshake.write<nsl::uint16>(1);
+		handshake.write<nsl::uint32>(cookie);
+		handshake.write<nsl::uint8>(NSL_CONNECTION_FLAG_HANDSHAKE);
+		handshake.write<nsl::uint32>(nonce);
+		socket.send(server, data, 11);
+		s.updateNetwork(time);
+		if (receive() != 19) {
+			return false;
+		}
+		id = readUint32(7);
+		return true;
+	}
+
+	/// size of the received packet, 0 if there is none
+	unsigned int receive(void) {
+		nsl::Address sender;
+		return socket.receive(sender, buffer, NSL_MAX_UDP_PACKET_SIZE);
+	}
+
+	unsigned int readUint32(unsigned int offset) {
+		nsl::BitStreamReader stream(buffer + offset, 4, false);
+		return stream.read<nsl::uint32>();
+	}
+
+	/// receive the next update and decompress it, return its size or 0 if there is none
+	unsigned int receiveUpdate(void) {
+		unsigned int size = receive();
+		if (size <= 7 || buffer[6] != NSL_CONNECTION_FLAG_COMPRESSED_UPDATE) {
+			return 0;
+		}
+		return nsl::decompress(buffer + 7, update, size - 7, sizeof(update));
+	}
+
+	/// seq of the last received update
+	nsl::seqNumber getUpdateSeq(void) {
+		nsl::BitStreamReader stream(update, 2, false);
+		return stream.read<nsl::Attribute<nsl::seqNumber> >();
+	}
+
+	/// acknowledge the update with given seq, without any custom messages
+	void ack(nsl::seqNumber seq) {
+		nsl::byte data[11];
+		nsl::BitStreamWriter stream(data, 11);
+		stream.write<nsl::uint16>(1);
+		stream.write<nsl::uint32>(id);
+		stream.write<nsl::uint8>(NSL_CONNECTION_FLAG_UPDATE);
+		stream.write<nsl::Attribute<nsl::seqNumber> >(seq);
+		stream.write<nsl::Attribute<nsl::seqNumber> >(0);
+		socket.send(server, data, 11);
+	}
+
+	/// end the connection and throw away the server reply
+	void disconnect(nsl::Server& s, double time) {
+		nsl::byte data[7];
+		nsl::BitStreamWriter stream(data, 7);
+		stream.write<nsl::uint16>(1);
+		stream.write<nsl::uint32>(id);
+		stream.write<nsl::uint8>(NSL_CONNECTION_FLAG_DISCONNECT);
+		socket.send(server, data, 7);
+		s.updateNetwork(time);
+		while (receive() != 0) {}
+	}
+};
+
+// executor holding jobs back until it is released, so a flush can be caught while it is in progress
+class GateExecutor : public nsl::Executor
+{
+public:
+	nsl::Mutex lock;
+	nsl::Condition changed;
+	bool started;
+	bool released;
+
+	GateExecutor(void) : started(false), released(false) {}
+
+	virtual void execute(jobFunction job, void* context, unsigned int jobCount) {
+		lock.lock();
+		started = true;
+		changed.notifyAll();
+		while (!released) {
+			changed.wait(lock);
+		}
+		lock.unlock();
+		for (unsigned int i = 0; i < jobCount; i++) {
+			job(context, i);
+		}
+	}
+
+	void waitUntilStarted(void) {
+		nsl::MutexGuard guard(lock);
+		while (!started) {
+			changed.wait(lock);
+		}
+	}
+
+	void release(void) {
+		nsl::MutexGuard guard(lock);
+		released = true;
+		changed.notifyAll();
+	}
+
+	/// release the gate from another thread a moment later, while the caller is blocked by the flush
+	static void releaseLater(void* gate) {
+		double start = nsl::getTime();
+		while (nsl::getTime() - start < 0.05) {}
+		((GateExecutor*)gate)->release();
+	}
+};
+
+// enough peers for the executor to be used (see NSL_FLUSH_PEERS_PER_JOB)
+#define FLUSH_TEST_PEERS (NSL_FLUSH_PEERS_PER_JOB + 1)
+
+// sockets are not reused by tests, so every server gets its own ports
+static void connectPeers(nsl::Server& server, const char* serverPort, std::vector<RawPeer*>& peers, unsigned int firstPort, double time)
+{
+	for (unsigned int i = 0; i < FLUSH_TEST_PEERS; i++) {
+		char port[8];
+		sprintf(port, "%u", firstPort + i);
+		peers.push_back(new RawPeer(port, serverPort));
+		ASSERT_TRUE(peers.back()->connect(server, time));
+	}
+}
+
+static void deletePeers(std::vector<RawPeer*>& peers)
+{
+	for (unsigned int i = 0; i < peers.size(); i++) {
+		delete peers[i];
+	}
+}
+
+TEST(Server_Unit, asyncFlush) {
+
+	GateExecutor gate;
+	nsl::Server server(1);
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	server.registerObjectClass(oc);
+	server.open("30751");
+	server.setFlushExecutor(&gate);
+	std::vector<RawPeer*> peers;
+	connectPeers(server, "30751", peers, 30752, 1.0);
+	server.createObject(0)->set<nsl::uint32>(0, 7);
+
+	// the flush is not finished until its updates are sent
+	nsl::FlushHandle flush = server.flushNetworkAsync();
+	gate.waitUntilStarted();
+	EXPECT_FALSE(server.isFlushFinished(flush));
+	EXPECT_EQ(0u, peers[0]->receiveUpdate());
+	gate.release();
+	server.waitForFlush(flush);
+	EXPECT_TRUE(server.isFlushFinished(flush));
+	for (unsigned int i = 0; i < peers.size(); i++) {
+		EXPECT_LT(0u, peers[i]->receiveUpdate());
+	}
+
+	// finished flush can be waited for again
+	server.waitForFlush(flush);
+	EXPECT_TRUE(server.isFlushFinished(flush));
+
+	server.close();
+	deletePeers(peers);
+}
+
+TEST(Server_Unit, asyncFlushWhilePending) {
+
+	GateExecutor gate;
+	nsl::Server server(1);
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	server.registerObjectClass(oc);
+	server.open("30757");
+	server.setFlushExecutor(&gate);
+	std::vector<RawPeer*> peers;
+	connectPeers(server, "30757", peers, 30758, 1.0);
+	nsl::ServerObject* object = server.createObject(0);
+	object->set<nsl::uint32>(0, 7);
+
+	nsl::FlushHandle first = server.flushNetworkAsync();
+	gate.waitUntilStarted();
+	server.updateNetwork(1.1);
+	object->set<nsl::uint32>(0, 8);
+
+	// the second flush waits until the first one is sent
+	nsl::Thread releaser;
+	releaser.start(&GateExecutor::releaseLater, &gate);
+	nsl::FlushHandle second = server.flushNetworkAsync();
+	EXPECT_NE(first, second);
+	EXPECT_TRUE(server.isFlushFinished(first));
+	server.waitForFlush(second);
+	EXPECT_TRUE(server.isFlushFinished(second));
+	releaser.join();
+
+	// every peer gets both updates in order
+	for (unsigned int i = 0; i < peers.size(); i++) {
+		ASSERT_LT(0u, peers[i]->receiveUpdate());
+		nsl::seqNumber seq = peers[i]->getUpdateSeq();
+		ASSERT_LT(0u, peers[i]->receiveUpdate());
+		EXPECT_EQ((seq + 1) % NSL_SEQ_MODULO, peers[i]->getUpdateSeq());
+	}
+
+	server.close();
+	deletePeers(peers);
+}
+
+TEST(Server_Unit, closeDuringAsyncFlush) {
+
+	GateExecutor gate;
+	nsl::Server server(1);
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	server.registerObjectClass(oc);
+	server.open("30763");
+	server.setFlushExecutor(&gate);
+	std::vector<RawPeer*> peers;
+	connectPeers(server, "30763", peers, 30764, 1.0);
+	server.createObject(0)->set<nsl::uint32>(0, 7);
+
+	nsl::FlushHandle flush = server.flushNetworkAsync();
+	gate.waitUntilStarted();
+
+	// closing waits for the network thread, updates of the flush are still sent
+	nsl::Thread releaser;
+	releaser.start(&GateExecutor::releaseLater, &gate);
+	server.close();
+	releaser.join();
+	EXPECT_TRUE(server.isFlushFinished(flush));
+	server.waitForFlush(flush);
+	for (unsigned int i = 0; i < peers.size(); i++) {
+		EXPECT_LT(0u, peers[i]->receiveUpdate());
+	}
+
+	deletePeers(peers);
+}
+
+// client remembering its objects, so they can be compared with the server
+class ObjectClient : public nsl::Client
+{
+public:
+	std::map<unsigned int, nsl::ClientObject*> objects;
+
+	ObjectClient(void) : nsl::Client(1) {}
+	void onCreate(nsl::ClientObject* object, bool objectBirth, nsl::BitStreamReader* creationMetaData) {objects[object->getId()] = object;}
+	void onDestroy(nsl::ClientObject* object, bool objectDeath) {objects.erase(object->getId());}
+};
+
+// objects of one mutating thread, each of them is set to its id plus the tick
+struct MutatingThread
+{
+	nsl::Server* server;
+	std::vector<nsl::ServerObject*> objects;
+	unsigned int tick;
+
+	static void run(void* context) {
+		MutatingThread* thread = (MutatingThread*)context;
+		for (unsigned int i = 0; i < 5; i++) {
+			thread->objects.push_back(thread->server->createObject(0));
+		}
+		unsigned int kept = 0;
+		for (unsigned int i = 0; i < thread->objects.size(); i++) {
+			nsl::ServerObject* object = thread->objects[i];
+			if ((object->getId() + thread->tick) % 7 == 0) {
+				object->destroy();
+				continue;
+			}
+			object->set<nsl::uint32>(0, object->getId() + thread->tick);
+			thread->objects[kept++] = object;
+		}
+		thread->objects.resize(kept);
+	}
+};
+
+TEST(Server_Unit, concurrentMutation) {
+
+	nsl::Server server(1);
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	server.registerObjectClass(oc);
+	server.open("30769");
+	server.setConcurrentMutation(true);
+	ObjectClient client;
+	client.registerObjectClass(oc);
+	client.open("127.0.0.1", "30769", "30770");
+
+	// objects are created, set and destroyed by more threads at once in every tick
+	MutatingThread threads[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		threads[i].server = &server;
+	}
+	double time = 1.0;
+	unsigned int lastTick = 0;
+	for (unsigned int tick = 1; tick <= 30; tick++) {
+		time += 0.05;
+		server.updateNetwork(time);
+		if (tick <= 20) {
+			nsl::Thread running[4];
+			for (unsigned int i = 0; i < 4; i++) {
+				threads[i].tick = tick;
+				running[i].start(&MutatingThread::run, &threads[i]);
+			}
+			for (unsigned int i = 0; i < 4; i++) {
+				running[i].join();
+			}
+			lastTick = tick;
+		}
+		server.flushNetwork();
+		client.updateNetwork(time);
+		client.flushNetwork();
+	}
+
+	// the client ends with the objects and values left by the threads
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < 4; i++) {
+		count += threads[i].objects.size();
+		for (unsigned int j = 0; j < threads[i].objects.size(); j++) {
+			nsl::ServerObject* object = threads[i].objects[j];
+			std::map<unsigned int, nsl::ClientObject*>::iterator it = client.objects.find(object->getId());
+			ASSERT_TRUE(it != client.objects.end());
+			EXPECT_EQ(object->getId() + lastTick, it->second->get<nsl::uint32>(0));
+		}
+	}
+	EXPECT_LT(50u, count);
+	EXPECT_EQ(count, client.objects.size());
+
+	client.close();
+	server.close();
+}
+
+// every server gets the same objects, so their updates can be compared
+static void mutateObjects(nsl::Server& server, std::vector<nsl::ServerObject*>& objects, unsigned int tick)
+{
+	for (unsigned int i = 0; i < 3; i++) {
+		objects.push_back(server.createObject(0));
+	}
+	if (tick % 4 == 0) {
+		objects.front()->destroy();
+		objects.erase(objects.begin());
+	}
+	for (unsigned int i = tick % 3; i < objects.size(); i += 3) {
+		objects[i]->set<nsl::uint32>(0, i * tick);
+	}
+}
+
+TEST(Server_Unit, parallelFlushMatchesSerial) {
+
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::Server serial(1);
+	serial.registerObjectClass(oc);
+	serial.open("30771");
+	nsl::Server parallel(1);
+	parallel.registerObjectClass(oc);
+	parallel.open("30777");
+	parallel.setFlushThreadCount(4);
+
+	double time = 1.0;
+	std::vector<RawPeer*> serialPeers;
+	std::vector<RawPeer*> parallelPeers;
+	connectPeers(serial, "30771", serialPeers, 30772, time);
+	connectPeers(parallel, "30777", parallelPeers, 30778, time);
+
+#if NSL_KEYFRAME_INTERVAL > 0
+	// keyframes are spread by connection ids, so paired peers reconnect until they get them in the same updates
+	// every network update adds a seq, the serial server is updated as many times to stay at the same seq
+	for (unsigned int i = 0; i < parallelPeers.size(); i++) {
+		while (parallelPeers[i]->id % NSL_KEYFRAME_INTERVAL != serialPeers[i]->id % NSL_KEYFRAME_INTERVAL) {
+			parallelPeers[i]->disconnect(parallel, time);
+			ASSERT_TRUE(parallelPeers[i]->connect(parallel, time));
+			for (unsigned int j = 0; j < 3; j++) {
+				serial.updateNetwork(time);
+			}
+		}
+	}
+#endif
+
+	// every peer of the parallel flush gets the very same bytes as its pair from the serial one
+	std::vector<nsl::ServerObject*> serialObjects;
+	std::vector<nsl::ServerObject*> parallelObjects;
+	for (unsigned int tick = 1; tick <= 30; tick++) {
+		time += 0.05;
+		serial.updateNetwork(time);
+		parallel.updateNetwork(time);
+		mutateObjects(serial, serialObjects, tick);
+		mutateObjects(parallel, parallelObjects, tick);
+		serial.flushNetwork();
+		parallel.flushNetwork();
+		for (unsigned int i = 0; i < serialPeers.size(); i++) {
+			unsigned int size = serialPeers[i]->receiveUpdate();
+			ASSERT_LT(0u, size);
+			ASSERT_EQ(size, parallelPeers[i]->receiveUpdate());
+			EXPECT_EQ(0, memcmp(serialPeers[i]->update, parallelPeers[i]->update, size));
+			serialPeers[i]->ack(serialPeers[i]->getUpdateSeq());
+			parallelPeers[i]->ack(parallelPeers[i]->getUpdateSeq());
+		}
+	}
+
+	serial.close();
+	parallel.close();
+	deletePeers(serialPeers);
+	deletePeers(parallelPeers);
+}
@@ -0,0 +1,23 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/SipHash.h"
+
+TEST(SipHash_Unit, referenceVectors) {
+	nsl::byte key[NSL_SIPHASH_KEY_SIZE];
+	nsl::byte data[64];
+	for (int i = 0; i < NSL_SIPHASH_KEY_SIZE; i++) {
+		key[i] = (nsl::byte)i;
+	}
+	for (int i = 0; i < 64; i++) {
+		data[i] = (nsl::byte)i;
+	}
+
+	// vectors from the SipHash paper and its reference implementation
+	EXPECT_EQ(0x726fdb47dd0e0e31ULL, nsl::sipHash(key, data, 0));
+	EXPECT_EQ(0xa129ca6149be45e5ULL, nsl::sipHash(key, data, 15));
+	EXPECT_EQ(0x958a324ceb064572ULL, nsl::sipHash(key, data, 63));
+
+	// another key gives another hash
+	key[0] = 1;
+	EXPECT_NE(0xa129ca6149be45e5ULL, nsl::sipHash(key, data, 15));
+}
@@ -0,0 +1,91 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/SlotMap.h"
+
+TEST(SlotMap_Unit, generations) {
+	nsl::SlotMap<int*> map;
+	int values[3];
+
+	unsigned int first = map.getNextId();
+	map.insert(first, &values[0]);
+	unsigned int second = map.getNextId();
+	map.insert(second, &values[1]);
+	EXPECT_NE(first, second);
+	EXPECT_EQ(&values[0], map.find(first));
+	EXPECT_EQ(&values[1], map.find(second));
+
+	// the last value is moved to the freed position
+	map.eraseAt(0);
+	EXPECT_EQ(1, map.getSize());
+	EXPECT_EQ(&values[1], map.getValue(0));
+	EXPECT_TRUE(NULL == map.find(first));
+	EXPECT_EQ(&values[1], map.find(second));
+
+	// slot is reused with a new generation, stale id is not found
+	unsigned int third = map.getNextId();
+	map.insert(third, &values[2]);
+	EXPECT_EQ(nsl::getSlotMapIndex(first), nsl::getSlotMapIndex(third));
+	EXPECT_NE(first, third);
+	EXPECT_TRUE(NULL == map.find(first));
+	EXPECT_EQ(&values[2], map.find(third));
+	EXPECT_EQ(&values[2], map.getBySlot(nsl::getSlotMapIndex(third)));
+}
+
+TEST(SlotMap_Unit, insertNewerGeneration) {
+	nsl::SlotMap<int*> map;
+	int values[2];
+
+	// ids from server, older value keeps its place in dense storage
+	unsigned int older = 5;
+	unsigned int newer = 5 + (1 << NSL_SLOT_MAP_INDEX_BITS);
+	map.insert(older, &values[0]);
+	map.insert(newer, &values[1]);
+	EXPECT_EQ(2, map.getSize());
+	EXPECT_TRUE(NULL == map.find(older));
+	EXPECT_EQ(&values[1], map.find(newer));
+	EXPECT_TRUE(NULL == map.getBySlot(0));
+
+	// removing the older value does not free the slot of the newer one
+	map.eraseAt(0);
+	EXPECT_EQ(&values[1], map.find(newer));
+	EXPECT_EQ(&values[1], map.getValue(0));
+}
+
+TEST(SlotMap_Unit, eraseById) {
+	nsl::SlotMap<int*> map;
+	int values[2];
+
+	unsigned int first = map.getNextId();
+	map.insert(first, &values[0]);
+	unsigned int second = map.getNextId();
+	map.insert(second, &values[1]);
+
+	map.erase(first);
+	EXPECT_EQ(1, map.getSize());
+	EXPECT_TRUE(NULL == map.find(first));
+	EXPECT_EQ(&values[1], map.find(second));
+
+	// stale id does not remove anything
+	map.erase(first);
+	EXPECT_EQ(1, map.getSize());
+}
+
+TEST(SlotMap_Unit, generationWrapAround) {
+	nsl::SlotMap<int*> map;
+	int value;
+
+	// every reuse of the slot gives a new id, until the generation overflows back to the first one
+	unsigned int first = map.getNextId();
+	unsigned int generations = 1u << (32 - NSL_SLOT_MAP_INDEX_BITS);
+	unsigned int id = first;
+	for (unsigned int i = 1; i < generations; i++) {
+		map.insert(id, &value);
+		map.eraseAt(0);
+		id = map.getNextId();
+		ASSERT_NE(first, id);
+		ASSERT_EQ(nsl::getSlotMapIndex(first), nsl::getSlotMapIndex(id));
+	}
+	map.insert(id, &value);
+	map.eraseAt(0);
+	EXPECT_EQ(first, map.getNextId());
+}
@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/SnapshotArena.h"
+#include "src/ObjectClassDefinition.h"
+
+TEST(SnapshotArena_Unit, slotReuse) {
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	nsl::server::SnapshotArena arena(&ocd, 2);
+
+	unsigned int first = arena.allocateSlot(0);
+	unsigned int second = arena.allocateSlot(0);
+	EXPECT_NE(first, second);
+
+	arena.releaseSlot(first);
+	EXPECT_EQ(first, arena.allocateSlot(0));
+	EXPECT_EQ(2, arena.getCapacity());
+}
+
+TEST(SnapshotArena_Unit, growKeepsData) {
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	nsl::server::SnapshotArena arena(&ocd, 1);
+
+	unsigned int first = arena.allocateSlot(3);
+	arena.getWritableAttribute(3, first, 0)[0] = 42;
+	arena.getWritableAttribute(3, first, 0)[3] = 24;
+
+	unsigned int second = arena.allocateSlot(3);
+	EXPECT_EQ(2, arena.getCapacity());
+	EXPECT_EQ(42, arena.getData(3, first)[0]);
+	EXPECT_EQ(24, arena.getData(3, first)[3]);
+	EXPECT_EQ(0, arena.getData(3, second)[0]);
+}
+
+TEST(SnapshotArena_Unit, copyAndClearIndex) {
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint16>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	nsl::server::SnapshotArena arena(&ocd, 4);
+
+	unsigned int first = arena.allocateSlot(0);
+	unsigned int second = arena.allocateSlot(0);
+	arena.getWritableAttribute(0, first, 0)[1] = 5;
+	arena.getWritableAttribute(0, second, 0)[0] = 6;
+
+	arena.copyIndex(1, 0);
+	EXPECT_EQ(5, arena.getData(1, first)[1]);
+	EXPECT_EQ(6, arena.getData(1, second)[0]);
+
+	arena.clearIndex(0);
+	EXPECT_EQ(0, arena.getData(0, first)[1]);
+	EXPECT_EQ(0, arena.getData(0, second)[0]);
+	EXPECT_EQ(5, arena.getData(1, first)[1]);
+}
+
+TEST(SnapshotArena_Unit, columnarLayout) {
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint8>(0);
+	oc.defineAttribute<nsl::uint32>(1);
+	oc.setColumnar(true);
+	nsl::ObjectClassDefinition ocd(oc);
+	nsl::server::SnapshotArena arena(&ocd, 2);
+
+	unsigned int first = arena.allocateSlot(0);
+	unsigned int second = arena.allocateSlot(0);
+
+	// attribute of all slots is contiguous
+	EXPECT_EQ(arena.getAttribute(0, first, 0) + 1, arena.getAttribute(0, second, 0));
+	EXPECT_EQ(arena.getAttribute(0, first, 1) + 4, arena.getAttribute(0, second, 1));
+
+	*arena.getWritableAttribute(0, first, 0) = 1;
+	*arena.getWritableAttribute(0, second, 1) = 2;
+	arena.copyIndex(1, 0);
+	*arena.getWritableAttribute(1, second, 1) = 3;
+
+	// growing adds a page, data stay with their slots
+	arena.allocateSlot(1);
+	EXPECT_EQ(4, arena.getCapacity());
+	EXPECT_EQ(1, *arena.getAttribute(1, first, 0));
+	EXPECT_EQ(3, *arena.getAttribute(1, second, 1));
+
+	arena.prepareDiff(0, 1);
+	nsl::server::SnapshotBlock* diff = arena.getPreparedDiff(0);
+	ASSERT_TRUE(diff != NULL);
+	EXPECT_EQ(0, *arena.getAttribute(*diff, first, 0));
+	EXPECT_EQ(2 ^ 3, *arena.getAttribute(*diff, second, 1));
+
+	arena.invalidateDiffs();
+	EXPECT_TRUE(arena.getPreparedDiff(0) == NULL);
+}
+
+TEST(SnapshotArena_Unit, copyOnWrite) {
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::uint32>(0);
+	nsl::ObjectClassDefinition ocd(oc);
+	nsl::server::SnapshotArena arena(&ocd, 2);
+
+	// new page is shared by all indexes, only the index with allocated slots gets its copy
+	unsigned int first = arena.allocateSlot(0);
+	unsigned int second = arena.allocateSlot(0);
+	unsigned int third = arena.allocateSlot(0);
+	EXPECT_EQ(4, arena.getAllocatedPageCount());
+
+	// copied index shares pages until it is written
+	*(unsigned int*)arena.getWritableAttribute(0, first, 0) = 7;
+	for (int i = 1; i < NSL_PACKET_BUFFER_SIZE_SERVER; i++) {
+		arena.copyIndex(i, i - 1);
+	}
+	EXPECT_EQ(2, arena.getAllocatedPageCount());
+	EXPECT_EQ(arena.getData(0, first), arena.getData(NSL_PACKET_BUFFER_SIZE_SERVER - 1, first));
+
+	// written page is copied, other indexes keep old data, other page stays shared
+	*(unsigned int*)arena.getWritableAttribute(5, second, 0) = 8;
+	EXPECT_EQ(3, arena.getAllocatedPageCount());
+	EXPECT_EQ(8, *(unsigned int*)arena.getData(5, second));
+	EXPECT_EQ(7, *(unsigned int*)arena.getData(5, first));
+	EXPECT_EQ(0, *(unsigned int*)arena.getData(4, second));
+	EXPECT_EQ(arena.getData(4, third), arena.getData(5, third));
+
+	// recycled index releases its copy
+	arena.copyIndex(5, 4);
+	EXPECT_EQ(2, arena.getAllocatedPageCount());
+	EXPECT_EQ(0, *(unsigned int*)arena.getData(5, second));
+}
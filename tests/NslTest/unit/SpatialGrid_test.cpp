@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/server/SpatialGrid.h"
+#include "src/server/ObjectManager.h"
+#include "src/server/HistoryBuffer.h"
+#include "src/server/NetworkObject.h"
+#include "src/server/Peer.h"
+#include "src/ObjectClassDefinition.h"
+#include <map>
+#include <algorithm>
+
+static nsl::server::NetworkObject* createAt(nsl::server::ObjectManager& objectManager, nsl::server::HistoryBuffer& historyBuffer, float x, float y)
+{
+	nsl::server::NetworkObject* o = objectManager.createObject(0, &historyBuffer);
+	o->set(0, sizeof(float), (nsl::byte*)&x);
+	o->set(1, sizeof(float), (nsl::byte*)&y);
+	return o;
+}
+
+TEST(SpatialGrid_Unit, scopeByView) {
+	nsl::server::HistoryBuffer historyBuffer;
+	nsl::server::ObjectManager objectManager;
+	std::map<unsigned int, nsl::server::Peer*> peers;
+
+	nsl::ObjectClass oc(0);
+	oc.defineAttribute<nsl::float32>(0);
+	oc.defineAttribute<nsl::float32>(1);
+	oc.setPositionAttributes(0, 1);
+	nsl::ObjectClassDefinition ocd(oc);
+	objectManager.registerObjectClass(&ocd);
+
+	nsl::ObjectClass global(1);
+	global.defineAttribute<nsl::uint8>(0);
+	nsl::ObjectClassDefinition globalDefinition(global);
+	objectManager.registerObjectClass(&globalDefinition);
+
+	historyBuffer.addSeq(1.0, &objectManager, &peers);
+	objectManager.getSpatialGrid()->setCellSize(10);
+	nsl::server::NetworkObject* near = createAt(objectManager, historyBuffer, 3, 4);
+	nsl::server::NetworkObject* corner = createAt(objectManager, historyBuffer, 8, 6);
+	nsl::server::NetworkObject* far = createAt(objectManager, historyBuffer, 100, -100);
+	nsl::server::NetworkObject* everywhere = objectManager.createObject(1, &historyBuffer);
+	int index = historyBuffer.getCurrentSeqIndex();
+	objectManager.updateSpatialGrid(index);
+
+	// corner is in a cell overlapping the view, but it is too far
+	double view[] = {0, 0, 0};
+	std::vector<nsl::server::NetworkObject*> scope;
+	objectManager.getSpatialGrid()->query(view, 5, index, scope);
+	EXPECT_EQ(2, scope.size());
+	EXPECT_EQ(1, std::count(scope.begin(), scope.end(), near));
+	EXPECT_EQ(1, std::count(scope.begin(), scope.end(), everywhere));
+
+	// moving objects changes their cells
+	float x = 99;
+	near->set(0, sizeof(float), (nsl::byte*)&x);
+	x = 2;
+	far->set(0, sizeof(float), (nsl::byte*)&x);
+	float y = 1;
+	far->set(1, sizeof(float), (nsl::byte*)&y);
+	objectManager.updateSpatialGrid(index);
+	scope.clear();
+	objectManager.getSpatialGrid()->query(view, 5, index, scope);
+	EXPECT_EQ(2, scope.size());
+	EXPECT_EQ(1, std::count(scope.begin(), scope.end(), far));
+	EXPECT_EQ(1, std::count(scope.begin(), scope.end(), everywhere));
+
+	// destroyed objects leave the grid immediately
+	far->destroy();
+	scope.clear();
+	objectManager.getSpatialGrid()->query(view, 50, index, scope);
+	EXPECT_EQ(2, scope.size());
+	EXPECT_EQ(1, std::count(scope.begin(), scope.end(), corner));
+	EXPECT_EQ(0, std::count(scope.begin(), scope.end(), far));
+
+	// view bigger than the whole grid
+	scope.clear();
+	objectManager.getSpatialGrid()->query(view, 1000, index, scope);
+	EXPECT_EQ(3, scope.size());
+}
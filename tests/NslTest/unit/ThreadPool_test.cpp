@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/ThreadPool.h"
+#include <vector>
+
+static void markJob(void* context, unsigned int jobIndex)
+{
+	std::vector<int>* marks = (std::vector<int>*)context;
+	(*marks)[jobIndex]++;
+}
+
+TEST(ThreadPool_Unit, runsEveryJobOnce) {
+	nsl::ThreadPool pool(3);
+	EXPECT_EQ(3, pool.getThreadCount());
+
+	std::vector<int> marks(100, 0);
+	pool.execute(&markJob, &marks, 100);
+	for (unsigned int i = 0; i < marks.size(); i++) {
+		EXPECT_EQ(1, marks[i]);
+	}
+
+	// pool is reusable
+	pool.execute(&markJob, &marks, 50);
+	for (unsigned int i = 0; i < marks.size(); i++) {
+		EXPECT_EQ(i < 50 ? 2 : 1, marks[i]);
+	}
+}
+
+TEST(ThreadPool_Unit, noWorkerThreads) {
+	nsl::ThreadPool pool(0);
+
+	std::vector<int> marks(10, 0);
+	pool.execute(&markJob, &marks, 10);
+	for (unsigned int i = 0; i < marks.size(); i++) {
+		EXPECT_EQ(1, marks[i]);
+	}
+
+	pool.execute(&markJob, &marks, 0);
+	EXPECT_EQ(1, marks[0]);
+}
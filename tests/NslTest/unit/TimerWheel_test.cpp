@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "src/configuration.h"
+#include "src/TimerWheel.h"
+#include <vector>
+
+TEST(TimerWheel_Unit, expireAfterDeadline) {
+	nsl::TimerWheel wheel(0.01);
+	int first = 1, second = 2, far = 3;
+	nsl::Timer firstTimer(&first), secondTimer(&second), farTimer(&far);
+
+	wheel.schedule(&firstTimer, 0.5);
+	wheel.schedule(&secondTimer, 2.0);
+	wheel.schedule(&farTimer, 200000.0);
+	EXPECT_TRUE(firstTimer.isScheduled());
+
+	wheel.advance(0.49);
+	EXPECT_TRUE(wheel.popExpired() == NULL);
+	wheel.advance(0.52);
+	nsl::Timer* timer = wheel.popExpired();
+	ASSERT_TRUE(timer != NULL);
+	EXPECT_EQ(&first, timer->owner);
+	EXPECT_FALSE(firstTimer.isScheduled());
+	EXPECT_TRUE(wheel.popExpired() == NULL);
+
+	// rescheduled timer moves, cancelled timer never expires
+	wheel.schedule(&secondTimer, 3.0);
+	wheel.schedule(&firstTimer, 2.5);
+	wheel.cancel(&firstTimer);
+	wheel.advance(2.99);
+	EXPECT_TRUE(wheel.popExpired() == NULL);
+	wheel.advance(3.02);
+	EXPECT_EQ(&secondTimer, wheel.popExpired());
+	EXPECT_TRUE(wheel.popExpired() == NULL);
+
+	// timer beyond the range of the wheel waits for its deadline
+	wheel.advance(190000.0);
+	EXPECT_TRUE(wheel.popExpired() == NULL);
+	wheel.advance(200000.02);
+	EXPECT_EQ(&farTimer, wheel.popExpired());
+}
+
+TEST(TimerWheel_Unit, manyTimers) {
+	nsl::TimerWheel wheel(0.01);
+	std::vector<nsl::Timer> timers(10000);
+	std::vector<bool> fired(timers.size(), false);
+	for (unsigned int i = 0; i < timers.size(); i++) {
+		timers[i].owner = (void*)(size_t)i;
+		wheel.schedule(&timers[i], 1.0 + i * 0.013);
+	}
+
+	// every timer expires in the first step after its deadline
+	unsigned int firedCount = 0;
+	for (double time = 0.05; time < 140.0; time += 0.05) {
+		wheel.advance(time);
+		nsl::Timer* timer;
+		while (NULL != (timer = wheel.popExpired())) {
+			unsigned int i = (unsigned int)(size_t)timer->owner;
+			EXPECT_LT(timer->deadline, time);
+			EXPECT_GE(timer->deadline + 0.06, time);
+			EXPECT_FALSE(fired[i]);
+			fired[i] = true;
+			firedCount++;
+		}
+	}
+	EXPECT_EQ(timers.size(), firedCount);
+}